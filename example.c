@@ -6,10 +6,61 @@
 
 #include "mailparse.h"
 
+int write_body(const char *data, size_t len, void *arg)
+{
+	fwrite(data, 1, len, (FILE *)arg);
+	return 0;
+}
+
+int print_header(const char *name, const char *value, size_t value_len, void *arg)
+{
+	(void)arg;
+
+	printf("header %s: [%d]%s\n", name, (int)value_len, value);
+	return 0;
+}
+
+int print_text_part(const char *mime_type, const char *charset, const char *data, size_t len, void *arg)
+{
+	(void)arg;
+
+	if (len == 0) {
+		printf("\n-- end of %s part (%s)\n", mime_type, charset);
+	} else {
+		fwrite(data, 1, len, stdout);
+	}
+	return 0;
+}
+
+int print_attachment(const char *mime_type, const char *filename, void *arg)
+{
+	(void)arg;
+
+	printf("attachment %s: %s\n", mime_type, filename);
+	return 0;
+}
+
+void print_batch_result(size_t index, int ret, struct parsed_message_info_s *info, void *arg)
+{
+	char **paths = (char **)arg;
+
+	if (ret > 0) {
+		printf("%s: parse email fail\n", paths[index]);
+	} else {
+		printf("%s: subject [%d]%s, body [%d]\n", paths[index], info->header_subject.len,
+			info->header_subject.pdata != NULL ? info->header_subject.pdata : "", info->body.len);
+	}
+}
+
 void usage(char *prog)
 {
 	printf("%s [option]\n", prog);
+	printf("%s -t threads [-H] file...\n", prog);
 	printf("-f:		email file\n");
+	printf("-H:		parse headers only\n");
+	printf("-s:		stream the body to stdout while parsing\n");
+	printf("-e:		print parse events\n");
+	printf("-t:		parse the files on this number of threads (0: one per cpu)\n");
 	printf("-h:		help\n");
 	exit(0);
 }
@@ -17,30 +68,80 @@ void usage(char *prog)
 int main (int argc, char **argv)
 {
 	char eml_file[1024] = {0};
+	int headers_only = 0;
+	int stream_body = 0;
+	int events = 0;
+	int threads = -1;
 
 	// ----------------
 	int ch;
-	const char *args = "f:h";
+	const char *args = "f:Hset:h";
 	while ((ch = getopt(argc, argv, args)) != -1) {
 		switch (ch) {
 			case 'f':
 				snprintf(eml_file, sizeof(eml_file), "%s", optarg);
 				break;
+			case 'H':
+				headers_only = 1;
+				break;
+			case 's':
+				stream_body = 1;
+				break;
+			case 'e':
+				events = 1;
+				break;
+			case 't':
+				threads = atoi(optarg);
+				break;
 			case 'h':
 			default:
 				usage(argv[0]);
 				break;	
 		}
 	}
+	if (threads >= 0) {
+		if (optind >= argc) {
+			usage(argv[0]);
+		}
+
+		parse_mail_batch_with_callback(argv + optind, argc - optind,
+			headers_only ? MAILPARSE_HEADERS : MAILPARSE_ALL, threads, print_batch_result, argv + optind);
+		return 0;
+	}
 	if (*eml_file == '\0') {
 		usage(argv[0]);
 	}
 
 
 	int ret = 0;
+
+	if (events) {
+		struct mailparse_callbacks_s callbacks;
+
+		init_parse_callbacks(&callbacks);
+		callbacks.on_header = print_header;
+		if (!headers_only) {
+			callbacks.on_text_part = print_text_part;
+			callbacks.on_attachment_begin = print_attachment;
+		}
+
+		ret = parse_mail_events_for_file(eml_file, &callbacks);
+		if (ret == MAILPARSE_ERROR) {
+			fprintf(stderr, "parse email fail\n");
+		}
+		return 0;
+	}
+
 	struct parsed_message_info_s parsed_mail_info;
 
 	init_parse(&parsed_mail_info);
+	if (headers_only) {
+		parsed_mail_info.parse_mask = MAILPARSE_HEADERS;
+	}
+	if (stream_body) {
+		parsed_mail_info.body_sink = write_body;
+		parsed_mail_info.body_sink_arg = stdout;
+	}
 
 	ret = parse_mail_for_file(eml_file, &parsed_mail_info);
 	if (ret > 0) {
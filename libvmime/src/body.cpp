@@ -30,19 +30,22 @@
 #include "vmime/text.hpp"
 
 #include "vmime/utility/random.hpp"
+#include "vmime/utility/bufferScanner.hpp"
 
 #include "vmime/parserHelpers.hpp"
 
 #include "vmime/emptyContentHandler.hpp"
 #include "vmime/stringContentHandler.hpp"
 
+#include <algorithm>
+
 
 namespace vmime
 {
 
 
 body::body()
-	: m_contents(create <emptyContentHandler>()), m_part(NULL), m_header(NULL)
+	: m_contents(create <emptyContentHandler>()), m_part(NULL), m_header(NULL), m_lazyCount(0), m_lazyParsing(false)
 {
 }
 
@@ -126,8 +129,16 @@ void body::parse(const string& buffer, const string::size_type position,
 	{
 		const string boundarySep("--" + boundary);
 
+		// Locate all the boundary strings in a single pass over the buffer
+		std::vector <string::size_type> boundaries;
+		utility::bufferScanner::findAll(buffer, boundarySep,
+			position, std::min(end, buffer.length()) + boundarySep.length() - 1, boundaries);
+
+		std::vector <string::size_type>::const_iterator nextBoundary = boundaries.begin();
+
 		string::size_type partStart = position;
-		string::size_type pos = buffer.find(boundarySep, position);
+		string::size_type pos = findNextBoundary(buffer, boundarySep,
+			boundaries, nextBoundary, position, end);
 
 		bool lastPart = false;
 
@@ -171,17 +182,11 @@ void body::parse(const string& buffer, const string::size_type position,
 			}
 
 			if (index > 0)
-			{
-				ref <bodyPart> part = vmime::create <bodyPart>();
-
-				part->parse(buffer, partStart, partEnd, NULL);
-				part->m_parent = m_part;
-
-				m_parts.push_back(part);
-			}
+				addParsedPart(buffer, partStart, partEnd);
 
 			partStart = pos;
-			pos = buffer.find(boundarySep, partStart);
+			pos = findNextBoundary(buffer, boundarySep,
+				boundaries, nextBoundary, partStart, end);
 		}
 
 		m_contents = vmime::create <emptyContentHandler>();
@@ -189,20 +194,7 @@ void body::parse(const string& buffer, const string::size_type position,
 		// Last part was not found: recover from missing boundary
 		if (!lastPart && pos == string::npos)
 		{
-			ref <bodyPart> part = vmime::create <bodyPart>();
-
-			try
-			{
-				part->parse(buffer, partStart, end);
-			}
-			catch (std::exception&)
-			{
-				throw;
-			}
-
-			part->m_parent = m_part;
-
-			m_parts.push_back(part);
+			addParsedPart(buffer, partStart, end);
 		}
 		// Treat remaining text as epilog
 		else if (partStart < end)
@@ -242,6 +234,116 @@ void body::parse(const string& buffer, const string::size_type position,
 }
 
 
+// static
+string::size_type body::findNextBoundary(const string& buffer, const string& boundarySep,
+	const std::vector <string::size_type>& boundaries,
+	std::vector <string::size_type>::const_iterator& it,
+	const string::size_type from, const string::size_type end)
+{
+	while (it != boundaries.end() && *it < from)
+		++it;
+
+	if (it != boundaries.end())
+		return *it;
+
+	// No more boundary before the end position: we still need to know
+	// whether there is one after it (see missing boundary recovery)
+	return buffer.find(boundarySep, std::max(from, end));
+}
+
+
+void body::addParsedPart(const string& buffer, const string::size_type partStart,
+	const string::size_type partEnd)
+{
+	if (m_lazyParsing)
+	{
+		if (m_lazyBuffer == NULL)
+			m_lazyBuffer = shareBuffer(buffer);
+
+		m_lazyBounds.resize(m_parts.size());
+		m_lazyBounds.push_back(std::make_pair(partStart, partEnd));
+
+		m_parts.push_back(NULL);
+		++m_lazyCount;
+	}
+	else
+	{
+		ref <bodyPart> part = vmime::create <bodyPart>();
+
+		part->m_body->m_lazyParsing = m_lazyParsing;
+		part->parse(buffer, partStart, partEnd, NULL);
+		part->m_parent = m_part;
+
+		m_parts.push_back(part);
+	}
+}
+
+
+void body::parsePartAt(const int pos)
+{
+	if (m_parts[pos] != NULL)
+		return;
+
+	ref <bodyPart> part = vmime::create <bodyPart>();
+
+	// Set the parent first, so that the body of the part can share
+	// the buffer (see shareBuffer())
+	part->m_parent = m_part;
+	part->m_body->m_lazyParsing = m_lazyParsing;
+	part->parse(m_lazyBuffer->getData(), m_lazyBounds[pos].first, m_lazyBounds[pos].second, NULL);
+
+	m_parts[pos] = part;
+
+	// Release the buffer once all the parts have been parsed
+	if (--m_lazyCount == 0)
+	{
+		m_lazyBuffer = NULL;
+		m_lazyBounds.clear();
+	}
+}
+
+
+ref <const body::sharedBuffer> body::shareBuffer(const string& buffer) const
+{
+	// If this body belongs to a part which is being parsed lazily,
+	// the buffer is the one of the enclosing body
+	ref <const bodyPart> part = m_part.acquire();
+	ref <const bodyPart> parent = (part != NULL ? part->getParentPart() : NULL);
+
+	if (parent != NULL)
+	{
+		ref <const sharedBuffer> parentBuffer = parent->getBody()->m_lazyBuffer;
+
+		if (parentBuffer != NULL && &parentBuffer->getData() == &buffer)
+			return parentBuffer;
+	}
+
+	return vmime::create <sharedBuffer>(buffer);
+}
+
+
+void body::setLazyParsing(const bool lazy)
+{
+	m_lazyParsing = lazy;
+}
+
+
+bool body::isLazyParsing() const
+{
+	return (m_lazyParsing);
+}
+
+
+void body::parseAllParts()
+{
+	if (m_lazyBounds.empty())
+		return;
+
+	for (std::vector <ref <bodyPart> >::size_type i = 0 ; i < m_parts.size() ; ++i)
+		parsePartAt(static_cast <int>(i));
+}
+
+
 void body::generate(utility::outputStream& os, const string::size_type maxLineLength,
 	const string::size_type /* curLinePos */, string::size_type* newLinePos) const
 {
@@ -560,6 +662,7 @@ void body::copyFrom(const component& other)
 	m_epilogText = bdy.m_epilogText;
 
 	m_contents = bdy.m_contents;
+	m_lazyParsing = bdy.m_lazyParsing;
 
 	removeAllParts();
 
@@ -692,6 +795,8 @@ void body::initNewPart(ref <bodyPart> part)
 
 void body::appendPart(ref <bodyPart> part)
 {
+	parseAllParts();
+
 	initNewPart(part);
 
 	m_parts.push_back(part);
@@ -700,6 +805,8 @@ void body::appendPart(ref <bodyPart> part)
 
 void body::insertPartBefore(ref <bodyPart> beforePart, ref <bodyPart> part)
 {
+	parseAllParts();
+
 	initNewPart(part);
 
 	const std::vector <ref <bodyPart> >::iterator it = std::find
@@ -714,6 +821,8 @@ void body::insertPartBefore(ref <bodyPart> beforePart, ref <bodyPart> part)
 
 void body::insertPartBefore(const int pos, ref <bodyPart> part)
 {
+	parseAllParts();
+
 	initNewPart(part);
 
 	m_parts.insert(m_parts.begin() + pos, part);
@@ -722,6 +831,8 @@ void body::insertPartBefore(const int pos, ref <bodyPart> part)
 
 void body::insertPartAfter(ref <bodyPart> afterPart, ref <bodyPart> part)
 {
+	parseAllParts();
+
 	initNewPart(part);
 
 	const std::vector <ref <bodyPart> >::iterator it = std::find
@@ -736,6 +847,8 @@ void body::insertPartAfter(ref <bodyPart> afterPart, ref <bodyPart> part)
 
 void body::insertPartAfter(const int pos, ref <bodyPart> part)
 {
+	parseAllParts();
+
 	initNewPart(part);
 
 	m_parts.insert(m_parts.begin() + pos + 1, part);
@@ -744,6 +857,8 @@ void body::insertPartAfter(const int pos, ref <bodyPart> part)
 
 void body::removePart(ref <bodyPart> part)
 {
+	parseAllParts();
+
 	const std::vector <ref <bodyPart> >::iterator it = std::find
 		(m_parts.begin(), m_parts.end(), part);
 
@@ -756,6 +871,8 @@ void body::removePart(ref <bodyPart> part)
 
 void body::removePart(const int pos)
 {
+	parseAllParts();
+
 	m_parts.erase(m_parts.begin() + pos);
 }
 
@@ -763,6 +880,10 @@ void body::removePart(const int pos)
 void body::removeAllParts()
 {
 	m_parts.clear();
+
+	m_lazyBuffer = NULL;
+	m_lazyBounds.clear();
+	m_lazyCount = 0;
 }
 
 
@@ -780,18 +901,24 @@ bool body::isEmpty() const
 
 ref <bodyPart> body::getPartAt(const int pos)
 {
+	parsePartAt(pos);
+
 	return (m_parts[pos]);
 }
 
 
 const ref <const bodyPart> body::getPartAt(const int pos) const
 {
+	const_cast <body*>(this)->parsePartAt(pos);
+
 	return (m_parts[pos]);
 }
 
 
 const std::vector <ref <const bodyPart> > body::getPartList() const
 {
+	const_cast <body*>(this)->parseAllParts();
+
 	std::vector <ref <const bodyPart> > list;
 
 	list.reserve(m_parts.size());
@@ -808,12 +935,16 @@ const std::vector <ref <const bodyPart> > body::getPartList() const
 
 const std::vector <ref <bodyPart> > body::getPartList()
 {
+	parseAllParts();
+
 	return (m_parts);
 }
 
 
 const std::vector <ref <const component> > body::getChildComponents() const
 {
+	const_cast <body*>(this)->parseAllParts();
+
 	std::vector <ref <const component> > list;
 
 	copy_vector(m_parts, list);
@@ -24,6 +24,18 @@
 #include "vmime/charsetConverter.hpp"
 #include "vmime/exception.hpp"
 
+#include "vmime/utility/bufferScanner.hpp"
+#include "vmime/utility/stringUtils.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_WIN32)
+#	include <windows.h>
+#elif defined(VMIME_HAVE_PTHREAD)
+#	include <pthread.h>
+#endif
+
 
 extern "C"
 {
@@ -78,37 +90,572 @@ namespace vmime
 {
 
 
-charsetConverter::charsetConverter(const charset& source, const charset& dest)
-	: m_desc(NULL), m_source(source), m_dest(dest)
+namespace
 {
-	// Get an iconv descriptor
-	const iconv_t cd = iconv_open(dest.getName().c_str(), source.getName().c_str());
 
-	if (cd != reinterpret_cast <iconv_t>(-1))
+
+/** Shared pool of idle iconv descriptors, keyed by (source, dest)
+  * charset names. Opening a descriptor is far more expensive than
+  * resetting one, and the same few conversions are done over and over
+  * when decoding headers.
+  */
+
+class iconvDescriptorPool
+{
+public:
+
+	iconvDescriptorPool()
+	{
+#if defined(_WIN32)
+		InitializeCriticalSection(&m_mutex);
+#elif defined(VMIME_HAVE_PTHREAD)
+		pthread_mutex_init(&m_mutex, NULL);
+#endif
+	}
+
+	~iconvDescriptorPool()
+	{
+		for (std::vector <entry>::iterator it = m_idle.begin() ; it != m_idle.end() ; ++it)
+			iconv_close((*it).cd);
+
+#if defined(_WIN32)
+		DeleteCriticalSection(&m_mutex);
+#elif defined(VMIME_HAVE_PTHREAD)
+		pthread_mutex_destroy(&m_mutex);
+#endif
+	}
+
+	/** Take a descriptor from the pool, or open a new one if there
+	  * is no idle descriptor for this conversion.
+	  *
+	  * @return iconv descriptor, or (iconv_t) -1 on error
+	  */
+	iconv_t acquire(const string& key, const charset& source, const charset& dest)
+	{
+		lock();
+
+		for (std::vector <entry>::size_type i = m_idle.size() ; i != 0 ; --i)
+		{
+			if (m_idle[i - 1].key == key)
+			{
+				const iconv_t cd = m_idle[i - 1].cd;
+
+				m_idle.erase(m_idle.begin() + (i - 1));
+				unlock();
+
+				return cd;
+			}
+		}
+
+		unlock();
+
+		return iconv_open(dest.getName().c_str(), source.getName().c_str());
+	}
+
+	/** Reset a descriptor to its initial state and give it back
+	  * to the pool.
+	  */
+	void release(const string& key, iconv_t cd)
+	{
+		iconv(cd, NULL, NULL, NULL, NULL);
+
+		entry e;
+		e.key = key;
+		e.cd = cd;
+
+		lock();
+
+		if (m_idle.size() < MAX_IDLE_DESCRIPTORS)
+		{
+			m_idle.push_back(e);
+			cd = reinterpret_cast <iconv_t>(-1);
+		}
+
+		unlock();
+
+		if (cd != reinterpret_cast <iconv_t>(-1))
+			iconv_close(cd);
+	}
+
+	/** Return the key of the descriptors for the specified conversion.
+	  */
+	static const string makeKey(const charset& source, const charset& dest)
 	{
-		iconv_t* p = new iconv_t;
-		*p= cd;
+		string key;
+		key.reserve(source.getName().length() + 1 + dest.getName().length());
 
-		m_desc = p;
+		key += source.getName();
+		key += '\n';
+		key += dest.getName();
+
+		return key;
 	}
+
+private:
+
+	// Enough for the handful of charsets a program usually deals
+	// with, times the number of threads converting at once
+	enum { MAX_IDLE_DESCRIPTORS = 32 };
+
+	struct entry
+	{
+		string key;
+		iconv_t cd;
+	};
+
+	void lock()
+	{
+#if defined(_WIN32)
+		EnterCriticalSection(&m_mutex);
+#elif defined(VMIME_HAVE_PTHREAD)
+		pthread_mutex_lock(&m_mutex);
+#endif
+	}
+
+	void unlock()
+	{
+#if defined(_WIN32)
+		LeaveCriticalSection(&m_mutex);
+#elif defined(VMIME_HAVE_PTHREAD)
+		pthread_mutex_unlock(&m_mutex);
+#endif
+	}
+
+
+	std::vector <entry> m_idle;
+
+#if defined(_WIN32)
+	CRITICAL_SECTION m_mutex;
+#elif defined(VMIME_HAVE_PTHREAD)
+	pthread_mutex_t m_mutex;
+#endif
+};
+
+
+iconvDescriptorPool descriptorPool;
+
+
+// Descriptor cache of the current thread, if any
+#if defined(__GNUC__)
+__thread charsetConverter::cache* currentCache = NULL;
+#elif defined(_MSC_VER)
+__declspec(thread) charsetConverter::cache* currentCache = NULL;
+#else
+charsetConverter::cache* currentCache = NULL;  // no thread-local storage: not thread-safe
+#endif
+
+
+} // namespace
+
+
+charsetConverter::cache::cache()
+{
 }
 
 
-charsetConverter::~charsetConverter()
+charsetConverter::cache::~cache()
 {
-	if (m_desc != NULL)
+	for (std::vector <std::pair <string, void*> >::iterator it = m_descriptors.begin() ;
+	     it != m_descriptors.end() ; ++it)
 	{
-		// Close iconv handle
-		iconv_close(*static_cast <iconv_t*>(m_desc));
+		iconv_t* p = static_cast <iconv_t*>((*it).second);
 
-		delete static_cast <iconv_t*>(m_desc);
-		m_desc = NULL;
+		descriptorPool.release((*it).first, *p);
+		delete p;
 	}
 }
 
 
+void* charsetConverter::cache::take(const string& key)
+{
+	for (std::vector <std::pair <string, void*> >::size_type i = m_descriptors.size() ; i != 0 ; --i)
+	{
+		if (m_descriptors[i - 1].first == key)
+		{
+			void* desc = m_descriptors[i - 1].second;
+			m_descriptors.erase(m_descriptors.begin() + (i - 1));
+
+			return desc;
+		}
+	}
+
+	return NULL;
+}
+
+
+bool charsetConverter::cache::keep(const string& key, void* desc)
+{
+	// A message seldom uses more than a few charsets
+	if (m_descriptors.size() >= 8)
+		return false;
+
+	iconv(*static_cast <iconv_t*>(desc), NULL, NULL, NULL, NULL);
+
+	m_descriptors.push_back(std::make_pair(key, desc));
+
+	return true;
+}
+
+
+charsetConverter::cache::scope::scope(cache& c)
+	: m_previous(currentCache)
+{
+	currentCache = &c;
+}
+
+
+charsetConverter::cache::scope::~scope()
+{
+	currentCache = m_previous;
+}
+
+
+void* charsetConverter::cache::acquire(const charset& source, const charset& dest)
+{
+	const string key = iconvDescriptorPool::makeKey(source, dest);
+
+	if (currentCache != NULL)
+	{
+		void* desc = currentCache->take(key);
+
+		if (desc != NULL)
+			return desc;
+	}
+
+	const iconv_t cd = descriptorPool.acquire(key, source, dest);
+
+	if (cd == reinterpret_cast <iconv_t>(-1))
+		return NULL;
+
+	iconv_t* p = new iconv_t;
+	*p = cd;
+
+	return p;
+}
+
+
+void charsetConverter::cache::release(const charset& source, const charset& dest, void* desc)
+{
+	if (desc != NULL)
+	{
+		const string key = iconvDescriptorPool::makeKey(source, dest);
+
+		if (currentCache != NULL && currentCache->keep(key, desc))
+			return;
+
+		iconv_t* p = static_cast <iconv_t*>(desc);
+
+		descriptorPool.release(key, *p);
+		delete p;
+	}
+}
+
+
+namespace
+{
+
+
+// Conversions to UTF-8 which are done without iconv, for the most
+// common charsets. Invalid bytes are replaced by '?', exactly like
+// in the iconv-based conversion.
+enum fastPathType
+{
+	FAST_PATH_NONE,
+	FAST_PATH_UTF_8,         // validation only
+	FAST_PATH_US_ASCII,
+	FAST_PATH_ISO8859_1,
+	FAST_PATH_WINDOWS_1252
+};
+
+
+bool isCharsetName(const string& name, const char* const* names)
+{
+	for ( ; *names != NULL ; ++names)
+	{
+		const string::size_type length = std::strlen(*names);
+
+		if (name.length() == length &&
+		    utility::stringUtils::isStringEqualNoCase(name, *names, length))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+fastPathType selectFastPath(const charset& source, const charset& dest)
+{
+	static const char* const utf8Names[] = { "utf-8", "utf8", NULL };
+	static const char* const asciiNames[] = { "us-ascii", "ascii", NULL };
+	static const char* const latin1Names[] = { "iso-8859-1", "iso8859-1", "iso_8859-1", "latin1", NULL };
+	static const char* const windows1252Names[] = { "windows-1252", "cp1252", NULL };
+
+	if (!isCharsetName(dest.getName(), utf8Names))
+		return FAST_PATH_NONE;
+
+	const string& name = source.getName();
+
+	if (isCharsetName(name, utf8Names))
+		return FAST_PATH_UTF_8;
+	else if (isCharsetName(name, asciiNames))
+		return FAST_PATH_US_ASCII;
+	else if (isCharsetName(name, latin1Names))
+		return FAST_PATH_ISO8859_1;
+	else if (isCharsetName(name, windows1252Names))
+		return FAST_PATH_WINDOWS_1252;
+
+	return FAST_PATH_NONE;
+}
+
+
+// Unicode code points for windows-1252 bytes 0x80-0x9F (0 = undefined);
+// other bytes have the same value as in ISO-8859-1
+const unsigned short windows1252Table[32] =
+{
+	0x20ac, 0,      0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021,
+	0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0,      0x017d, 0,
+	0,      0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,
+	0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0,      0x017e, 0x0178
+};
+
+
+// Return the length of the UTF-8 sequence starting at 'p', or 0 if
+// it is not valid. 'incomplete' is set if the data ends in the middle
+// of a sequence which may still turn out to be valid.
+string::size_type validUTF8Sequence(const unsigned char* p, const string::size_type length, bool& incomplete)
+{
+	const unsigned char c = p[0];
+
+	string::size_type seqLength;
+	unsigned char min = 0x80, max = 0xbf;  // bounds for the second byte
+
+	incomplete = false;
+
+	if (c < 0x80)
+		return 1;
+	else if (c < 0xc2)     // continuation byte, or overlong sequence
+		return 0;
+	else if (c < 0xe0)
+		seqLength = 2;
+	else if (c < 0xf0)
+	{
+		seqLength = 3;
+
+		if (c == 0xe0)       // overlong
+			min = 0xa0;
+		else if (c == 0xed)  // surrogates
+			max = 0x9f;
+	}
+	else if (c < 0xf5)
+	{
+		seqLength = 4;
+
+		if (c == 0xf0)       // overlong
+			min = 0x90;
+		else if (c == 0xf4)  // > U+10FFFF
+			max = 0x8f;
+	}
+	else
+	{
+		return 0;
+	}
+
+	for (string::size_type i = 1 ; i < seqLength ; ++i)
+	{
+		if (i >= length)
+		{
+			incomplete = true;
+			return 0;
+		}
+
+		if (p[i] < min || p[i] > max)
+			return 0;
+
+		min = 0x80;
+		max = 0xbf;
+	}
+
+	return seqLength;
+}
+
+
+// Validate UTF-8 data: valid spans are written as-is
+string::size_type convertUTF8ToUTF8(const char* data, const string::size_type count,
+	const bool final, utility::outputStream& out)
+{
+	const unsigned char* udata = reinterpret_cast <const unsigned char*>(data);
+
+	string::size_type spanStart = 0;
+	string::size_type pos = 0;
+
+	while (pos < count)
+	{
+		pos += utility::bufferScanner::findNonASCII(data + pos, count - pos);
+
+		if (pos == count)
+			break;
+
+		bool incomplete;
+		const string::size_type seqLength = validUTF8Sequence(udata + pos, count - pos, incomplete);
+
+		if (seqLength != 0)
+		{
+			pos += seqLength;
+		}
+		else if (incomplete && !final)
+		{
+			// Wait for more data
+			out.write(data + spanStart, pos - spanStart);
+			return pos;
+		}
+		else
+		{
+			out.write(data + spanStart, pos - spanStart);
+			out.write("?", 1);
+
+			spanStart = ++pos;
+		}
+	}
+
+	out.write(data + spanStart, count - spanStart);
+
+	return count;
+}
+
+
+// Convert data in a single-byte, ASCII-compatible charset
+string::size_type convertSingleByteToUTF8(const fastPathType type, const char* data,
+	const string::size_type count, utility::outputStream& out)
+{
+	// Converted bytes and short ASCII runs are gathered here, so that
+	// the output stream is not called for every few bytes
+	char buffer[1024];
+	string::size_type bufferLength = 0;
+
+	string::size_type pos = 0;
+
+	while (pos < count)
+	{
+		const string::size_type asciiLength =
+			utility::bufferScanner::findNonASCII(data + pos, count - pos);
+
+		if (asciiLength != 0)
+		{
+			if (asciiLength <= 64 && bufferLength + asciiLength <= sizeof(buffer))
+			{
+				std::copy(data + pos, data + pos + asciiLength, buffer + bufferLength);
+				bufferLength += asciiLength;
+			}
+			else
+			{
+				out.write(buffer, bufferLength);
+				out.write(data + pos, asciiLength);
+
+				bufferLength = 0;
+			}
+
+			pos += asciiLength;
+			continue;
+		}
+
+		// Non-ASCII byte: at most 3 bytes in UTF-8
+		if (bufferLength + 3 > sizeof(buffer))
+		{
+			out.write(buffer, bufferLength);
+			bufferLength = 0;
+		}
+
+		const unsigned char c = static_cast <unsigned char>(data[pos++]);
+		unsigned int code = c;
+
+		if (type == FAST_PATH_US_ASCII)
+			code = 0;
+		else if (type == FAST_PATH_WINDOWS_1252 && c < 0xa0)
+			code = windows1252Table[c - 0x80];
+
+		if (code == 0)
+		{
+			buffer[bufferLength++] = '?';
+		}
+		else if (code < 0x800)
+		{
+			buffer[bufferLength++] = static_cast <char>(0xc0 | (code >> 6));
+			buffer[bufferLength++] = static_cast <char>(0x80 | (code & 0x3f));
+		}
+		else
+		{
+			buffer[bufferLength++] = static_cast <char>(0xe0 | (code >> 12));
+			buffer[bufferLength++] = static_cast <char>(0x80 | ((code >> 6) & 0x3f));
+			buffer[bufferLength++] = static_cast <char>(0x80 | (code & 0x3f));
+		}
+	}
+
+	out.write(buffer, bufferLength);
+
+	return count;
+}
+
+
+// Convert data to UTF-8 without iconv. Return the number of bytes
+// converted: unless 'final' is set, an incomplete sequence at the end
+// of the data is left unconverted.
+string::size_type convertToUTF8(const fastPathType type, const char* data,
+	const string::size_type count, const bool final, utility::outputStream& out)
+{
+	if (type == FAST_PATH_UTF_8)
+		return convertUTF8ToUTF8(data, count, final, out);
+	else
+		return convertSingleByteToUTF8(type, data, count, out);
+}
+
+
+} // namespace
+
+
+charsetConverter::charsetConverter(const charset& source, const charset& dest)
+	: m_fastPath(selectFastPath(source, dest)),
+	  m_desc(m_fastPath == FAST_PATH_NONE ? cache::acquire(source, dest) : NULL),
+	  m_source(source), m_dest(dest)
+{
+}
+
+
+charsetConverter::~charsetConverter()
+{
+	cache::release(m_source, m_dest, m_desc);
+	m_desc = NULL;
+}
+
+
 void charsetConverter::convert(utility::inputStream& in, utility::outputStream& out)
 {
+	if (m_fastPath != FAST_PATH_NONE)
+	{
+		char inBuffer[32768];
+		utility::stream::size_type inPos = 0;
+
+		while (true)
+		{
+			const utility::stream::size_type inLength =
+				in.read(inBuffer + inPos, sizeof(inBuffer) - inPos) + inPos;
+			const bool eof = in.eof();
+
+			const string::size_type converted = convertToUTF8
+				(static_cast <fastPathType>(m_fastPath), inBuffer, inLength, eof, out);
+
+			// Leave an incomplete sequence in the input buffer
+			std::copy(inBuffer + converted, inBuffer + inLength, inBuffer);
+			inPos = inLength - converted;
+
+			if (eof)
+				break;
+		}
+
+		return;
+	}
+
 	if (m_desc == NULL)
 		throw exceptions::charset_conv_error("Cannot initialize converter.");
 
@@ -198,32 +745,17 @@ namespace utility {
 
 charsetFilteredOutputStream::charsetFilteredOutputStream
 	(const charset& source, const charset& dest, outputStream& os)
-	: m_desc(NULL), m_sourceCharset(source), m_destCharset(dest),
-	  m_stream(os), m_unconvCount(0)
+	: m_fastPath(selectFastPath(source, dest)),
+	  m_desc(m_fastPath == FAST_PATH_NONE ? charsetConverter::cache::acquire(source, dest) : NULL),
+	  m_sourceCharset(source), m_destCharset(dest), m_stream(os), m_unconvCount(0)
 {
-	// Get an iconv descriptor
-	const iconv_t cd = iconv_open(dest.getName().c_str(), source.getName().c_str());
-
-	if (cd != reinterpret_cast <iconv_t>(-1))
-	{
-		iconv_t* p = new iconv_t;
-		*p= cd;
-
-		m_desc = p;
-	}
 }
 
 
 charsetFilteredOutputStream::~charsetFilteredOutputStream()
 {
-	if (m_desc != NULL)
-	{
-		// Close iconv handle
-		iconv_close(*static_cast <iconv_t*>(m_desc));
-
-		delete static_cast <iconv_t*>(m_desc);
-		m_desc = NULL;
-	}
+	charsetConverter::cache::release(m_sourceCharset, m_destCharset, m_desc);
+	m_desc = NULL;
 }
 
 
@@ -236,6 +768,40 @@ outputStream& charsetFilteredOutputStream::getNextOutputStream()
 void charsetFilteredOutputStream::write
 	(const value_type* const data, const size_type count)
 {
+	if (m_fastPath != FAST_PATH_NONE)
+	{
+		const fastPathType type = static_cast <fastPathType>(m_fastPath);
+
+		const value_type* curData = data;
+		size_type curDataLen = count;
+
+		// Complete the sequence left unconverted by the previous call
+		while (m_unconvCount != 0 && curDataLen != 0)
+		{
+			m_unconvBuffer[m_unconvCount++] = *curData++;
+			curDataLen--;
+
+			const size_type converted = convertToUTF8
+				(type, m_unconvBuffer, m_unconvCount, false, m_stream);
+
+			std::copy(m_unconvBuffer + converted,
+				m_unconvBuffer + m_unconvCount, m_unconvBuffer);
+
+			m_unconvCount -= converted;
+		}
+
+		if (curDataLen != 0)
+		{
+			const size_type converted = convertToUTF8
+				(type, curData, curDataLen, false, m_stream);
+
+			std::copy(curData + converted, curData + curDataLen, m_unconvBuffer);
+			m_unconvCount = curDataLen - converted;
+		}
+
+		return;
+	}
+
 	if (m_desc == NULL)
 		throw exceptions::charset_conv_error("Cannot initialize converter.");
 
@@ -354,6 +920,17 @@ void charsetFilteredOutputStream::write
 
 void charsetFilteredOutputStream::flush()
 {
+	if (m_fastPath != FAST_PATH_NONE)
+	{
+		convertToUTF8(static_cast <fastPathType>(m_fastPath),
+			m_unconvBuffer, m_unconvCount, true, m_stream);
+
+		m_unconvCount = 0;
+		m_stream.flush();
+
+		return;
+	}
+
 	if (m_desc == NULL)
 		throw exceptions::charset_conv_error("Cannot initialize converter.");
 
@@ -33,6 +33,15 @@ namespace vmime
 
 header::header()
 {
+	buildIndex();
+}
+
+
+header::header(const header& h)
+	: component()
+{
+	buildIndex();
+	copyFrom(h);
 }
 
 
@@ -64,18 +73,30 @@ field-body-contents =
 void header::parse(const string& buffer, const string::size_type position,
 	const string::size_type end, string::size_type* newPosition)
 {
-	string::size_type pos = position;
-
 	removeAllFields();
 
-	while (pos < end)
+	// Split the header block into fields in a single pass, then
+	// parse the value of each field
+	headerTokenizer tokenizer(buffer, position, end);
+
+	std::vector <headerTokenizer::token> tokens;
+	tokenizer.getAllTokens(tokens);
+
+	m_fields.reserve(tokens.size());
+
+	for (std::vector <headerTokenizer::token>::const_iterator it = tokens.begin() ;
+	     it != tokens.end() ; ++it)
 	{
-		ref <headerField> field = headerField::parseNext(buffer, pos, end, &pos);
-		if (field == NULL) break;
+		ref <headerField> field = headerField::parseToken(buffer, *it);
+		field->m_header = this;
 
 		m_fields.push_back(field);
 	}
 
+	buildIndex();
+
+	const string::size_type pos = tokenizer.getPosition();
+
 	setParsedBounds(position, pos);
 
 	if (newPosition)
@@ -108,9 +129,14 @@ ref <component> header::clone() const
 	for (std::vector <ref <headerField> >::const_iterator it = m_fields.begin() ;
 	     it != m_fields.end() ; ++it)
 	{
-		hdr->m_fields.push_back((*it)->clone().dynamicCast <headerField>());
+		ref <headerField> field = (*it)->clone().dynamicCast <headerField>();
+		field->m_header = hdr.get();
+
+		hdr->m_fields.push_back(field);
 	}
 
+	hdr->buildIndex();
+
 	return (hdr);
 }
 
@@ -129,10 +155,17 @@ void header::copyFrom(const component& other)
 		fields.push_back((*it)->clone().dynamicCast <headerField>());
 	}
 
-	m_fields.clear();
-	m_fields.resize(fields.size());
+	removeAllFields();
+
+	for (std::vector <ref <headerField> >::iterator it = fields.begin() ;
+	     it != fields.end() ; ++it)
+	{
+		(*it)->m_header = this;
+	}
 
-	std::copy(fields.begin(), fields.end(), m_fields.begin());
+	m_fields.swap(fields);
+
+	buildIndex();
 }
 
 
@@ -145,30 +178,24 @@ header& header::operator=(const header& other)
 
 bool header::hasField(const string& fieldName) const
 {
-	std::vector <ref <headerField> >::const_iterator pos =
-		std::find_if(m_fields.begin(), m_fields.end(),
-		             fieldHasName(utility::stringUtils::toLower(fieldName)));
-
-	return (pos != m_fields.end());
+	return (findFirstField(fieldName) != -1);
 }
 
 
 ref <headerField> header::findField(const string& fieldName) const
 {
 	// Find the first field that matches the specified name
-	std::vector <ref <headerField> >::const_iterator pos =
-		std::find_if(m_fields.begin(), m_fields.end(),
-		             fieldHasName(utility::stringUtils::toLower(fieldName)));
+	const int pos = findFirstField(fieldName);
 
 	// No field with this name can be found
-	if (pos == m_fields.end())
+	if (pos == -1)
 	{
 		throw exceptions::no_such_field();
 	}
 	// Else, return a reference to the existing field
 	else
 	{
-		return (*pos);
+		return (m_fields[pos]);
 	}
 }
 
@@ -176,10 +203,9 @@ ref <headerField> header::findField(const string& fieldName) const
 std::vector <ref <headerField> > header::findAllFields(const string& fieldName)
 {
 	std::vector <ref <headerField> > result;
-	std::back_insert_iterator <std::vector <ref <headerField> > > back(result);
 
-	std::remove_copy_if(m_fields.begin(), m_fields.end(), back,
-	                    fieldHasNotName(utility::stringUtils::toLower(fieldName)));
+	for (int pos = findFirstField(fieldName) ; pos != -1 ; pos = findNextField(fieldName, pos))
+		result.push_back(m_fields[pos]);
 
 	return result;
 }
@@ -187,17 +213,11 @@ std::vector <ref <headerField> > header::findAllFields(const string& fieldName)
 
 ref <headerField> header::getField(const string& fieldName)
 {
-	const string name = utility::stringUtils::toLower(fieldName);
-
 	// Find the first field that matches the specified name
-	std::vector <ref <headerField> >::const_iterator pos = m_fields.begin();
-	const std::vector <ref <headerField> >::const_iterator end = m_fields.end();
-
-	while (pos != end && utility::stringUtils::toLower((*pos)->getName()) != name)
-		++pos;
+	const int pos = findFirstField(fieldName);
 
 	// If no field with this name can be found, create a new one
-	if (pos == end)
+	if (pos == -1)
 	{
 		ref <headerField> field = headerFieldFactory::getInstance()->create(fieldName);
 
@@ -209,14 +229,19 @@ ref <headerField> header::getField(const string& fieldName)
 	// Else, return a reference to the existing field
 	else
 	{
-		return (*pos);
+		return (m_fields[pos]);
 	}
 }
 
 
 void header::appendField(ref <headerField> field)
 {
+	attachField(field);
+
 	m_fields.push_back(field);
+
+	if (!addToIndex(static_cast <int>(m_fields.size()) - 1))
+		buildIndex();
 }
 
 
@@ -228,13 +253,21 @@ void header::insertFieldBefore(ref <headerField> beforeField, ref <headerField>
 	if (it == m_fields.end())
 		throw exceptions::no_such_field();
 
+	attachField(field);
+
 	m_fields.insert(it, field);
+
+	buildIndex();
 }
 
 
 void header::insertFieldBefore(const int pos, ref <headerField> field)
 {
+	attachField(field);
+
 	m_fields.insert(m_fields.begin() + pos, field);
+
+	buildIndex();
 }
 
 
@@ -246,13 +279,21 @@ void header::insertFieldAfter(ref <headerField> afterField, ref <headerField> fi
 	if (it == m_fields.end())
 		throw exceptions::no_such_field();
 
+	attachField(field);
+
 	m_fields.insert(it + 1, field);
+
+	buildIndex();
 }
 
 
 void header::insertFieldAfter(const int pos, ref <headerField> field)
 {
+	attachField(field);
+
 	m_fields.insert(m_fields.begin() + pos + 1, field);
+
+	buildIndex();
 }
 
 
@@ -264,7 +305,11 @@ void header::removeField(ref <headerField> field)
 	if (it == m_fields.end())
 		throw exceptions::no_such_field();
 
+	detachField(*it);
+
 	m_fields.erase(it);
+
+	buildIndex();
 }
 
 
@@ -272,13 +317,25 @@ void header::removeField(const int pos)
 {
 	const std::vector <ref <headerField> >::iterator it = m_fields.begin() + pos;
 
+	detachField(*it);
+
 	m_fields.erase(it);
+
+	buildIndex();
 }
 
 
 void header::removeAllFields()
 {
+	for (std::vector <ref <headerField> >::const_iterator it = m_fields.begin() ;
+	     it != m_fields.end() ; ++it)
+	{
+		detachField(*it);
+	}
+
 	m_fields.clear();
+
+	buildIndex();
 }
 
 
@@ -351,25 +408,122 @@ const std::vector <ref <const component> > header::getChildComponents() const
 // Field search
 
 
-header::fieldHasName::fieldHasName(const string& name)
-	: m_name(name)
+void header::attachField(ref <headerField> field)
 {
+	// A field belongs to one header only, which is notified when
+	// the field is renamed
+	if (field->m_header != NULL)
+		throw exceptions::invalid_argument();
+
+	field->m_header = this;
 }
 
-bool header::fieldHasName::operator() (const ref <const headerField>& field)
+
+void header::detachField(ref <headerField> field)
 {
-	return utility::stringUtils::toLower(field->getName()) == m_name;
+	if (field->m_header == this)
+		field->m_header = NULL;
 }
 
 
-header::fieldHasNotName::fieldHasNotName(const string& name)
-	: m_name(name)
+std::vector <int>::size_type header::findIndexSlot(const vmime_uint32 hash) const
 {
+	// Return the slot for this hash, or the empty slot where it
+	// should be inserted
+	const std::vector <int>::size_type mask = m_indexTable.size() - 1;
+	std::vector <int>::size_type slot = hash & mask;
+
+	while (m_indexTable[slot] != -1 && m_indexHash[m_indexTable[slot]] != hash)
+		slot = (slot + 1) & mask;
+
+	return (slot);
+}
+
+
+void header::buildIndex()
+{
+	const int count = static_cast <int>(m_fields.size());
+
+	// Keep the table at most half full
+	std::vector <int>::size_type tableSize = 16;
+
+	while (tableSize < m_fields.size() * 2)
+		tableSize *= 2;
+
+	m_indexTable.assign(tableSize, -1);
+	m_indexHash.resize(m_fields.size());
+	m_indexNext.assign(m_fields.size(), -1);
+
+	// Insert fields in reverse order so that chains are in ascending order
+	for (int pos = count - 1 ; pos >= 0 ; --pos)
+	{
+		const vmime_uint32 hash = headerFieldFactory::hashFieldName(m_fields[pos]->m_name);
+
+		m_indexHash[pos] = hash;
+
+		const std::vector <int>::size_type slot = findIndexSlot(hash);
+
+		m_indexNext[pos] = m_indexTable[slot];
+		m_indexTable[slot] = pos;
+	}
+
 }
 
-bool header::fieldHasNotName::operator() (const ref <const headerField>& field)
+
+bool header::addToIndex(const int pos)
 {
-	return utility::stringUtils::toLower(field->getName()) != m_name;
+	if (m_fields.size() * 2 > m_indexTable.size())
+		return false;  // table needs to be resized
+
+	const vmime_uint32 hash = headerFieldFactory::hashFieldName(m_fields[pos]->m_name);
+
+	m_indexHash.push_back(hash);
+	m_indexNext.push_back(-1);
+
+	const std::vector <int>::size_type slot = findIndexSlot(hash);
+
+	if (m_indexTable[slot] == -1)
+	{
+		m_indexTable[slot] = pos;
+	}
+	else
+	{
+		int last = m_indexTable[slot];
+
+		while (m_indexNext[last] != -1)
+			last = m_indexNext[last];
+
+		m_indexNext[last] = pos;
+	}
+
+	return true;
+}
+
+
+int header::findFirstField(const string& fieldName) const
+{
+	const vmime_uint32 hash = headerFieldFactory::hashFieldName(fieldName);
+
+	// Different names may have the same hash value
+	for (int pos = m_indexTable[findIndexSlot(hash)] ; pos != -1 ; pos = m_indexNext[pos])
+	{
+		if (utility::stringUtils::isStringEqualNoCase(m_fields[pos]->m_name, fieldName))
+			return (pos);
+	}
+
+	return (-1);
+}
+
+
+int header::findNextField(const string& fieldName, const int pos) const
+{
+	for (int next = m_indexNext[pos] ; next != -1 ; next = m_indexNext[next])
+	{
+		if (utility::stringUtils::isStringEqualNoCase(m_fields[next]->m_name, fieldName))
+			return (next);
+	}
+
+	return (-1);
 }
 
 
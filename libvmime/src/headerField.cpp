@@ -23,6 +23,7 @@
 
 #include "vmime/headerField.hpp"
 #include "vmime/headerFieldFactory.hpp"
+#include "vmime/header.hpp"
 
 #include "vmime/parserHelpers.hpp"
 
@@ -32,13 +33,13 @@ namespace vmime
 
 
 headerField::headerField()
-	: m_name("X-Undefined")
+	: m_name("X-Undefined"), m_header(NULL)
 {
 }
 
 
 headerField::headerField(const string& fieldName)
-	: m_name(fieldName)
+	: m_name(fieldName), m_header(NULL)
 {
 }
 
@@ -76,189 +77,32 @@ headerField& headerField::operator=(const headerField& other)
 ref <headerField> headerField::parseNext(const string& buffer, const string::size_type position,
 	const string::size_type end, string::size_type* newPosition)
 {
-	string::size_type pos = position;
-
-	while (pos < end)
-	{
-		char_t c = buffer[pos];
-
-		// Check for end of headers (empty line): although RFC-822 recommends
-		// to use CRLF for header/body separator (see 4.1 SYNTAX), here, we
-		// also check for LF for compatibility with broken implementations...
-		if (c == '\n')
-		{
-			if (newPosition)
-				*newPosition = pos + 1;   // LF: illegal
-
-			return (NULL);
-		}
-		else if (c == '\r' && pos + 1 < end && buffer[pos + 1] == '\n')
-		{
-			if (newPosition)
-				*newPosition = pos + 2;   // CR+LF
-
-			return (NULL);
-		}
-
-		// This line may be a field description
-		if (!parserHelpers::isSpace(c))
-		{
-			const string::size_type nameStart = pos;  // remember the start position of the line
-
-			while (pos < end && (buffer[pos] != ':' && !parserHelpers::isSpace(buffer[pos])))
-				++pos;
-
-			const string::size_type nameEnd = pos;
-
-			while (pos < end && (buffer[pos] == ' ' || buffer[pos] == '\t'))
-				++pos;
-
-			if (buffer[pos] != ':')
-			{
-				// Humm...does not seem to be a valid header line.
-				// Skip this error and advance to the next line
-				pos = nameStart;
-
-				while (pos < end && buffer[pos] != '\n')
-					++pos;
-
-				if (pos < end && buffer[pos] == '\n')
-					++pos;
-			}
-			else
-			{
-				// Extract the field name
-				const string name(buffer.begin() + nameStart,
-				                  buffer.begin() + nameEnd);
-
-				// Skip ':' character
-				++pos;
-
-				// Skip spaces between ':' and the field contents
-				while (pos < end && (buffer[pos] == ' ' || buffer[pos] == '\t'))
-					++pos;
-
-				const string::size_type contentsStart = pos;
-				string::size_type contentsEnd = 0;
-
-				// Extract the field value
-				while (pos < end)
-				{
-					c = buffer[pos];
-
-					// Check for folded line
-					if (c == '\r' && pos + 2 < end && buffer[pos + 1] == '\n' &&
-						(buffer[pos + 2] == ' ' || buffer[pos + 2] == '\t'))
-					{
-						pos += 3;
-					}
-					// Check for end of contents
-					if (c == '\r' && pos + 1 < end && buffer[pos + 1] == '\n')
-					{
-						contentsEnd = pos;
-						pos += 2;
-						break;
-					}
-					else if (c == '\n')
-					{
-						contentsEnd = pos;
-						++pos;
-						break;
-					}
-
-					while (pos < end)
-					{
-						c = buffer[pos];
-
-						// Check for end of line
-						if (c == '\r' && pos + 1 < end && buffer[pos + 1] == '\n')
-						{
-							contentsEnd = pos;
-							pos += 2;
-							break;
-						}
-						else if (c == '\n')
-						{
-							contentsEnd = pos;
-							++pos;
-							break;
-						}
-
-						++pos;
-					}
-
-					// Handle the case of folded lines
-					if (buffer[pos] == ' ' || buffer[pos] == '\t')
-					{
-						// This is a folding white-space: we keep it as is and
-						// we continue with contents parsing...
-
-						// If the line contains only space characters, we assume it is
-						// the end of the headers. This is not strictly standard-compliant
-						// but, hey, we can't fail when parsing some malformed mails...
-						while (pos < end && (buffer[pos] == ' ' || buffer[pos] == '\t'))
-							++pos;
-
-						if ((pos < end && buffer[pos] == '\n') ||
-						    (pos + 1 < end && buffer[pos] == '\r' && buffer[pos + 1] == '\n'))
-						{
-							break;
-						}
-					}
-					else
-					{
-						// End of this field
-						break;
-					}
-				}
-
-				// Return a new field
-				ref <headerField> field = headerFieldFactory::getInstance()->create(name);
-
-				field->parse(buffer, contentsStart, contentsEnd, NULL);
-				field->setParsedBounds(nameStart, pos);
-
-				if (newPosition)
-					*newPosition = pos;
-
-				return (field);
-			}
-		}
-		else
-		{
-			// If the line contains only space characters, we assume it is
-			// the end of the headers.
-			while (pos < end && (buffer[pos] == ' ' || buffer[pos] == '\t'))
-				++pos;
-
-			if (pos < end && buffer[pos] == '\n')
-			{
-				if (newPosition)
-					*newPosition = pos + 1;   // LF: illegal
-
-				return NULL;
-			}
-			else if (pos + 1 < end && buffer[pos] == '\r' && buffer[pos + 1] == '\n')
-			{
-				if (newPosition)
-					*newPosition = pos + 2;   // CR+LF
-
-				return NULL;
-			}
-
-			// Skip this error and advance to the next line
-			while (pos < end && buffer[pos] != '\n')
-				++pos;
-
-			if (buffer[pos] == '\n')
-				++pos;
-		}
-	}
+	headerTokenizer tokenizer(buffer, position, end);
+	headerTokenizer::token tok;
+
+	const bool found = tokenizer.getNextToken(tok);
 
 	if (newPosition)
-		*newPosition = pos;
+		*newPosition = tokenizer.getPosition();
+
+	if (!found)
+		return (NULL);
 
-	return (NULL);
+	return (parseToken(buffer, tok));
+}
+
+
+// static
+ref <headerField> headerField::parseToken(const string& buffer, const headerTokenizer::token& tok)
+{
+	const string name(buffer.begin() + tok.nameStart, buffer.begin() + tok.nameEnd);
+
+	ref <headerField> field = headerFieldFactory::getInstance()->create(name);
+
+	field->parse(buffer, tok.valueStart, tok.valueEnd, NULL);
+	field->setParsedBounds(tok.nameStart, tok.end);
+
+	return (field);
 }
 
 
@@ -287,6 +131,9 @@ const string headerField::getName() const
 void headerField::setName(const string& name)
 {
 	m_name = name;
+
+	if (m_header != NULL)
+		m_header->buildIndex();
 }
 
 
@@ -44,6 +44,69 @@ namespace vmime
 
 headerFieldFactory::headerFieldFactory()
 {
+	// Build the perfect hash table for standard field names. The hash
+	// seed has been chosen so that these names do not collide; should
+	// a new name collide anyway, it will be stored in the maps.
+	static const string::value_type* const standardNames[] =
+	{
+		vmime::fields::RECEIVED,
+		vmime::fields::FROM,
+		vmime::fields::SENDER,
+		vmime::fields::REPLY_TO,
+		vmime::fields::TO,
+		vmime::fields::CC,
+		vmime::fields::BCC,
+		vmime::fields::DATE,
+		vmime::fields::SUBJECT,
+		vmime::fields::ORGANIZATION,
+		vmime::fields::USER_AGENT,
+		vmime::fields::DELIVERED_TO,
+		vmime::fields::RETURN_PATH,
+		vmime::fields::MIME_VERSION,
+		vmime::fields::MESSAGE_ID,
+		vmime::fields::CONTENT_TYPE,
+		vmime::fields::CONTENT_TRANSFER_ENCODING,
+		vmime::fields::CONTENT_DESCRIPTION,
+		vmime::fields::CONTENT_DISPOSITION,
+		vmime::fields::CONTENT_ID,
+		vmime::fields::CONTENT_LOCATION,
+		vmime::fields::IN_REPLY_TO,
+		vmime::fields::REFERENCES,
+		vmime::fields::X_MAILER,
+		vmime::fields::X_PRIORITY,
+		vmime::fields::ORIGINAL_MESSAGE_ID,
+		vmime::fields::DISPOSITION_NOTIFICATION_TO,
+		vmime::fields::DISPOSITION_NOTIFICATION_OPTIONS,
+		vmime::fields::DISPOSITION,
+		vmime::fields::FAILURE,
+		vmime::fields::ERROR,
+		vmime::fields::WARNING,
+		vmime::fields::ORIGINAL_RECIPIENT,
+		vmime::fields::FINAL_RECIPIENT,
+		vmime::fields::REPORTING_UA,
+		vmime::fields::MDN_GATEWAY
+	};
+
+	for (int i = 0 ; i < STANDARD_FIELD_TABLE_SIZE ; ++i)
+		m_standardFieldTable[i] = -1;
+
+	for (unsigned int i = 0 ; i < sizeof(standardNames) / sizeof(standardNames[0]) ; ++i)
+	{
+		const string name = utility::stringUtils::toLower(standardNames[i]);
+		const vmime_uint32 slot = hashFieldName(name) % STANDARD_FIELD_TABLE_SIZE;
+
+		if (m_standardFieldTable[slot] != -1)
+			continue;
+
+		standardField field;
+		field.name = name;
+		field.alloc = NULL;
+		field.valueAlloc = NULL;
+
+		m_standardFieldTable[slot] = static_cast <int>(m_standardFields.size());
+		m_standardFields.push_back(field);
+	}
+
 	// Register parameterized fields
 	registerField <contentTypeField>(vmime::fields::CONTENT_TYPE);
 	registerField <parameterizedHeaderField>(vmime::fields::CONTENT_TRANSFER_ENCODING);
@@ -97,19 +160,97 @@ headerFieldFactory* headerFieldFactory::getInstance()
 }
 
 
+// static
+vmime_uint32 headerFieldFactory::hashFieldName(const string& name)
+{
+	// FNV-1a; ASCII letters are folded to lowercase, so that names
+	// which only differ by case have the same hash value
+	vmime_uint32 hash = 27;
+
+	for (string::const_iterator it = name.begin() ; it != name.end() ; ++it)
+	{
+		vmime_uint32 c = static_cast <unsigned char>(*it);
+
+		if (c >= 'A' && c <= 'Z')
+			c |= 0x20;
+
+		hash ^= c;
+		hash *= 16777619;
+	}
+
+	return (hash);
+}
+
+
+int headerFieldFactory::findStandardField(const string& name) const
+{
+	const int index = m_standardFieldTable[hashFieldName(name) % STANDARD_FIELD_TABLE_SIZE];
+
+	if (index != -1)
+	{
+		const string& stdName = m_standardFields[index].name;
+
+		if (name.length() == stdName.length() &&
+		    utility::stringUtils::isStringEqualNoCase(name, stdName.data(), stdName.length()))
+		{
+			return (index);
+		}
+	}
+
+	return (-1);
+}
+
+
+void headerFieldFactory::findAllocFuncs
+	(const string& name, AllocFunc* alloc, ValueAllocFunc* valueAlloc) const
+{
+	const int index = findStandardField(name);
+
+	if (index != -1)
+	{
+		*alloc = m_standardFields[index].alloc;
+		*valueAlloc = m_standardFields[index].valueAlloc;
+	}
+	else if (m_nameMap.empty() && m_valueMap.empty())
+	{
+		// No custom field registered
+		*alloc = NULL;
+		*valueAlloc = NULL;
+	}
+	else
+	{
+		const string lcName = utility::stringUtils::toLower(name);
+
+		NameMap::const_iterator pos = m_nameMap.find(lcName);
+		*alloc = (pos != m_nameMap.end() ? (*pos).second : NULL);
+
+		ValueMap::const_iterator vpos = m_valueMap.find(lcName);
+		*valueAlloc = (vpos != m_valueMap.end() ? (*vpos).second : NULL);
+	}
+}
+
+
 ref <headerField> headerFieldFactory::create
 	(const string& name, const string& body)
 {
-	NameMap::const_iterator pos = m_nameMap.find(utility::stringUtils::toLower(name));
+	AllocFunc alloc;
+	ValueAllocFunc valueAlloc;
+
+	findAllocFuncs(name, &alloc, &valueAlloc);
+
 	ref <headerField> field = NULL;
 
-	if (pos != m_nameMap.end())
-		field = ((*pos).second)();
+	if (alloc != NULL)
+		field = alloc();
 	else
 		field = registerer <headerField, headerField>::creator();
 
-	field->setName(name);
-	field->setValue(createValue(name));
+	field->m_name = name;
+
+	if (valueAlloc != NULL)
+		field->setValue(valueAlloc());
+	else
+		field->setValue(registerer <headerFieldValue, text>::creator());
 
 	if (body != NULL_STRING)
 		field->parse(body);
@@ -120,13 +261,15 @@ ref <headerField> headerFieldFactory::create
 
 ref <headerFieldValue> headerFieldFactory::createValue(const string& fieldName)
 {
-	ValueMap::const_iterator pos = m_valueMap.find
-		(utility::stringUtils::toLower(fieldName));
+	AllocFunc alloc;
+	ValueAllocFunc valueAlloc;
+
+	findAllocFuncs(fieldName, &alloc, &valueAlloc);
 
 	ref <headerFieldValue> value = NULL;
 
-	if (pos != m_valueMap.end())
-		value = ((*pos).second)();
+	if (valueAlloc != NULL)
+		value = valueAlloc();
 	else
 		value = registerer <headerFieldValue, text>::creator();
 
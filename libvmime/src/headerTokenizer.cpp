@@ -0,0 +1,255 @@
+//
+// VMime library (http://www.vmime.org)
+// Copyright (C) 2002-2009 Vincent Richard <vincent@vincent-richard.net>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// Linking this library statically or dynamically with other modules is making
+// a combined work based on this library.  Thus, the terms and conditions of
+// the GNU General Public License cover the whole combination.
+//
+
+#include "vmime/headerTokenizer.hpp"
+#include "vmime/parserHelpers.hpp"
+
+#include "vmime/utility/bufferScanner.hpp"
+
+
+namespace vmime
+{
+
+
+headerTokenizer::headerTokenizer(const string& buffer,
+	const string::size_type position, const string::size_type end)
+	: m_buffer(buffer), m_end(end), m_pos(position),
+	  m_lineEndIndex(0), m_scannedEnd(position), m_scanLength(1024)
+{
+}
+
+
+string::size_type headerTokenizer::getPosition() const
+{
+	return (m_pos);
+}
+
+
+string::size_type headerTokenizer::findLineEnd(const string::size_type from)
+{
+	// Positions are usually requested in increasing order
+	if (m_lineEndIndex > 0 && m_lineEnds[m_lineEndIndex - 1] >= from)
+		m_lineEndIndex = 0;
+
+	for (;;)
+	{
+		while (m_lineEndIndex < m_lineEnds.size() && m_lineEnds[m_lineEndIndex] < from)
+			++m_lineEndIndex;
+
+		if (m_lineEndIndex < m_lineEnds.size())
+			return (m_lineEnds[m_lineEndIndex]);
+
+		if (m_scannedEnd >= m_end)
+			return (m_end);
+
+		// Locate the line ends in the next block of the buffer. As the
+		// end position may be the end of the whole message, do not
+		// scan further than needed: block size grows as we go
+		const string::size_type scanEnd =
+			(m_end - m_scannedEnd > m_scanLength) ? m_scannedEnd + m_scanLength : m_end;
+
+		utility::bufferScanner::findAll(m_buffer, "\n", m_scannedEnd, scanEnd, m_lineEnds);
+
+		m_scannedEnd = scanEnd;
+		m_scanLength *= 2;
+	}
+}
+
+
+bool headerTokenizer::getNextToken(token& tok)
+{
+	const string& buffer = m_buffer;
+	const string::size_type end = m_end;
+
+	string::size_type pos = m_pos;
+
+	while (pos < end)
+	{
+		char_t c = buffer[pos];
+
+		// Check for end of headers (empty line): although RFC-822 recommends
+		// to use CRLF for header/body separator (see 4.1 SYNTAX), here, we
+		// also check for LF for compatibility with broken implementations...
+		if (c == '\n')
+		{
+			m_pos = pos + 1;   // LF: illegal
+			return false;
+		}
+		else if (c == '\r' && pos + 1 < end && buffer[pos + 1] == '\n')
+		{
+			m_pos = pos + 2;   // CR+LF
+			return false;
+		}
+
+		// This line may be a field description
+		if (!parserHelpers::isSpace(c))
+		{
+			const string::size_type nameStart = pos;  // remember the start position of the line
+
+			while (pos < end && (buffer[pos] != ':' && !parserHelpers::isSpace(buffer[pos])))
+				++pos;
+
+			const string::size_type nameEnd = pos;
+
+			while (pos < end && (buffer[pos] == ' ' || buffer[pos] == '\t'))
+				++pos;
+
+			if (buffer[pos] != ':')
+			{
+				// Humm...does not seem to be a valid header line.
+				// Skip this error and advance to the next line
+				pos = findLineEnd(nameStart);
+
+				if (pos < end)
+					++pos;
+			}
+			else
+			{
+				// Skip ':' character
+				++pos;
+
+				// Skip spaces between ':' and the field contents
+				while (pos < end && (buffer[pos] == ' ' || buffer[pos] == '\t'))
+					++pos;
+
+				const string::size_type contentsStart = pos;
+				string::size_type contentsEnd = 0;
+
+				// Extract the field value
+				while (pos < end)
+				{
+					c = buffer[pos];
+
+					// Check for folded line
+					if (c == '\r' && pos + 2 < end && buffer[pos + 1] == '\n' &&
+						(buffer[pos + 2] == ' ' || buffer[pos + 2] == '\t'))
+					{
+						pos += 3;
+					}
+					// Check for end of contents
+					if (c == '\r' && pos + 1 < end && buffer[pos + 1] == '\n')
+					{
+						contentsEnd = pos;
+						pos += 2;
+						break;
+					}
+					else if (c == '\n')
+					{
+						contentsEnd = pos;
+						++pos;
+						break;
+					}
+
+					// Go to the end of the line
+					const string::size_type lineEnd = findLineEnd(pos);
+
+					if (lineEnd < end)
+					{
+						contentsEnd = (lineEnd > pos && buffer[lineEnd - 1] == '\r')
+							? lineEnd - 1 : lineEnd;
+
+						pos = lineEnd + 1;
+					}
+					else
+					{
+						pos = end;
+					}
+
+					// Handle the case of folded lines
+					if (buffer[pos] == ' ' || buffer[pos] == '\t')
+					{
+						// This is a folding white-space: we keep it as is and
+						// we continue with contents parsing...
+
+						// If the line contains only space characters, we assume it is
+						// the end of the headers. This is not strictly standard-compliant
+						// but, hey, we can't fail when parsing some malformed mails...
+						while (pos < end && (buffer[pos] == ' ' || buffer[pos] == '\t'))
+							++pos;
+
+						if ((pos < end && buffer[pos] == '\n') ||
+						    (pos + 1 < end && buffer[pos] == '\r' && buffer[pos + 1] == '\n'))
+						{
+							break;
+						}
+					}
+					else
+					{
+						// End of this field
+						break;
+					}
+				}
+
+				tok.nameStart = nameStart;
+				tok.nameEnd = nameEnd;
+				tok.valueStart = contentsStart;
+				tok.valueEnd = contentsEnd;
+				tok.end = pos;
+
+				m_pos = pos;
+
+				return true;
+			}
+		}
+		else
+		{
+			// If the line contains only space characters, we assume it is
+			// the end of the headers.
+			while (pos < end && (buffer[pos] == ' ' || buffer[pos] == '\t'))
+				++pos;
+
+			if (pos < end && buffer[pos] == '\n')
+			{
+				m_pos = pos + 1;   // LF: illegal
+				return false;
+			}
+			else if (pos + 1 < end && buffer[pos] == '\r' && buffer[pos + 1] == '\n')
+			{
+				m_pos = pos + 2;   // CR+LF
+				return false;
+			}
+
+			// Skip this error and advance to the next line
+			pos = findLineEnd(pos);
+
+			if (buffer[pos] == '\n')
+				++pos;
+		}
+	}
+
+	m_pos = pos;
+
+	return false;
+}
+
+
+void headerTokenizer::getAllTokens(std::vector <token>& tokens)
+{
+	token tok;
+
+	while (getNextToken(tok))
+		tokens.push_back(tok);
+}
+
+
+} // vmime
@@ -0,0 +1,344 @@
+//
+// VMime library (http://www.vmime.org)
+// Copyright (C) 2002-2009 Vincent Richard <vincent@vincent-richard.net>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// Linking this library statically or dynamically with other modules is making
+// a combined work based on this library.  Thus, the terms and conditions of
+// the GNU General Public License cover the whole combination.
+//
+
+#include "vmime/incrementalParser.hpp"
+
+#include "vmime/contentTypeField.hpp"
+#include "vmime/parserHelpers.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+
+namespace vmime
+{
+
+
+void incrementalParserListener::onHeader(ref <const header> /* hdr */, const int /* depth */)
+{
+}
+
+
+void incrementalParserListener::onPartBegin(const int /* depth */)
+{
+}
+
+
+void incrementalParserListener::onPartEnd(const int /* depth */)
+{
+}
+
+
+void incrementalParserListener::onBody(const char* /* data */,
+	const string::size_type /* length */, const int /* depth */)
+{
+}
+
+
+
+incrementalParser::incrementalParser(incrementalParserListener* listener, const bool keepData)
+	: m_listener(listener), m_keepData(keepData), m_state(STATE_HEADER), m_lineStart(0),
+	  m_scanPos(0), m_headerStart(0), m_inContents(false), m_finished(false)
+{
+}
+
+
+void incrementalParser::feed(const char* data, const string::size_type length)
+{
+	if (m_finished)
+		return;
+
+	m_data.append(data, length);
+
+	// Process each complete line
+	while (m_lineStart < m_data.length())
+	{
+		// The body of a single part message contains no boundary
+		if (m_state == STATE_BODY && m_levels.empty())
+		{
+			if (m_inContents)
+				reportContents(m_lineStart, m_data.length());
+
+			m_lineStart = m_data.length();
+			break;
+		}
+
+		// Do not scan again the beginning of a line received in
+		// several chunks
+		const string::size_type scanStart = std::max(m_lineStart, m_scanPos);
+
+		const void* eol = std::memchr(m_data.data() + scanStart, '\n', m_data.length() - scanStart);
+
+		if (eol == NULL)
+		{
+			m_scanPos = m_data.length();
+			break;
+		}
+
+		const string::size_type end =
+			static_cast <string::size_type>(static_cast <const char*>(eol) - m_data.data()) + 1;
+
+		processLine(m_lineStart, end);
+
+		m_lineStart = end;
+	}
+
+	if (!m_keepData)
+		releaseData();
+}
+
+
+void incrementalParser::finish()
+{
+	if (m_finished)
+		return;
+
+	// Last line, without line break
+	if (m_lineStart < m_data.length() && !(m_state == STATE_BODY && m_levels.empty()))
+		processLine(m_lineStart, m_data.length());
+
+	m_lineStart = m_data.length();
+
+	if (m_state == STATE_HEADER)
+		endHeader(m_data.length());
+
+	// The last boundary is missing: the last line break belongs to the
+	// contents of the part
+	if (m_inContents)
+		reportContents(m_lineStart, m_lineStart);
+
+	// End the parts which are still open
+	while (!m_levels.empty())
+	{
+		if (m_levels.back().inPart)
+			m_listener->onPartEnd(static_cast <int>(m_levels.size()));
+
+		m_levels.pop_back();
+	}
+
+	m_finished = true;
+}
+
+
+ref <message> incrementalParser::getMessage() const
+{
+	ref <message> msg = vmime::create <message>();
+	msg->parse(m_data);
+
+	return (msg);
+}
+
+
+const string& incrementalParser::getBuffer() const
+{
+	return (m_data);
+}
+
+
+void incrementalParser::processLine(const string::size_type start, const string::size_type end)
+{
+	// Boundaries end the header and the body of the current part
+	if (processBoundary(start, end))
+		return;
+
+	if (m_state == STATE_HEADER)
+	{
+		// An empty line ends the header
+		if (m_data[start] == '\n' || (m_data[start] == '\r' && start + 1 < end && m_data[start + 1] == '\n'))
+			endHeader(end);
+	}
+	else if (m_inContents)
+	{
+		// Hold back the line break, which belongs to the next
+		// boundary if there is one
+		string::size_type contentsEnd = end;
+
+		if (contentsEnd > start && m_data[contentsEnd - 1] == '\n')
+		{
+			--contentsEnd;
+
+			if (contentsEnd > start && m_data[contentsEnd - 1] == '\r')
+				--contentsEnd;
+		}
+
+		reportContents(start, contentsEnd);
+
+		m_heldLineBreak.assign(m_data, contentsEnd, end - contentsEnd);
+	}
+}
+
+
+void incrementalParser::reportContents(const string::size_type start, const string::size_type end)
+{
+	const int depth = static_cast <int>(m_levels.size());
+
+	if (!m_heldLineBreak.empty())
+	{
+		m_listener->onBody(m_heldLineBreak.data(), m_heldLineBreak.length(), depth);
+		m_heldLineBreak.clear();
+	}
+
+	if (start < end)
+		m_listener->onBody(m_data.data() + start, end - start, depth);
+}
+
+
+void incrementalParser::releaseData()
+{
+	// Keep the line being received, and the header being received
+	string::size_type count = m_lineStart;
+
+	if (m_state == STATE_HEADER && m_headerStart < count)
+		count = m_headerStart;
+
+	if (count == 0)
+		return;
+
+	m_data.erase(0, count);
+
+	m_lineStart -= count;
+	m_scanPos = (m_scanPos > count ? m_scanPos - count : 0);
+	m_headerStart = (m_headerStart > count ? m_headerStart - count : 0);
+}
+
+
+void incrementalParser::endHeader(const string::size_type end)
+{
+	ref <header> hdr = vmime::create <header>();
+	hdr->parse(m_data, m_headerStart, end);
+
+	m_state = STATE_BODY;
+	m_inContents = true;
+
+	const int depth = static_cast <int>(m_levels.size());
+
+	// A multipart entity: the boundary of its parts is now known
+	if (hdr->hasField(fields::CONTENT_TYPE))
+	{
+		ref <const contentTypeField> ctf =
+			hdr->findField(fields::CONTENT_TYPE).dynamicCast <const contentTypeField>();
+
+		ref <const mediaType> type = ctf->getValue().dynamicCast <const mediaType>();
+
+		if (type->getType() == mediaTypes::MULTIPART && ctf->hasParameter("boundary"))
+		{
+			const string boundary = ctf->getBoundary();
+
+			if (!boundary.empty())
+			{
+				level lev;
+				lev.boundary = boundary;
+				lev.inPart = false;
+
+				m_levels.push_back(lev);
+
+				m_inContents = false;
+			}
+		}
+	}
+
+	m_listener->onHeader(hdr, depth);
+}
+
+
+bool incrementalParser::processBoundary(const string::size_type start, const string::size_type end)
+{
+	if (m_levels.empty() || end - start < 3 || m_data[start] != '-' || m_data[start + 1] != '-')
+		return false;
+
+	// Look for the innermost entity using this boundary
+	string::size_type i = m_levels.size();
+
+	for ( ; i != 0 ; --i)
+	{
+		const string& boundary = m_levels[i - 1].boundary;
+
+		if (end - start - 2 >= boundary.length() &&
+		    m_data.compare(start + 2, boundary.length(), boundary) == 0)
+		{
+			// Only whitespace (and "--" for the last boundary) may follow
+			string::size_type pos = start + 2 + boundary.length();
+
+			if (pos + 1 < end && m_data[pos] == '-' && m_data[pos + 1] == '-')
+				pos += 2;
+
+			string::size_type p = pos;
+
+			while (p < end && parserHelpers::isSpace(m_data[p]))
+				++p;
+
+			if (p == end)
+				break;
+		}
+	}
+
+	if (i == 0)
+		return false;
+
+	const string::size_type index = i - 1;
+	const string& boundary = m_levels[index].boundary;
+
+	const bool last = (start + 2 + boundary.length() + 1 < end &&
+		m_data[start + 2 + boundary.length()] == '-' && m_data[start + 3 + boundary.length()] == '-');
+
+	// The header of the current part ends here, if it had no empty line
+	if (m_state == STATE_HEADER)
+		endHeader(start);
+
+	// The contents of the current part, if any, end before the line
+	// break which precedes the boundary
+	m_inContents = false;
+	m_heldLineBreak.clear();
+
+	// Close the entities nested in the part which ends
+	while (m_levels.size() > index + 1)
+	{
+		if (m_levels.back().inPart)
+			m_listener->onPartEnd(static_cast <int>(m_levels.size()));
+
+		m_levels.pop_back();
+	}
+
+	if (m_levels[index].inPart)
+		m_listener->onPartEnd(static_cast <int>(index + 1));
+
+	if (last)
+	{
+		// Epilogue of the multipart entity
+		m_levels.pop_back();
+		m_state = STATE_BODY;
+	}
+	else
+	{
+		m_levels[index].inPart = true;
+		m_listener->onPartBegin(static_cast <int>(index + 1));
+
+		m_state = STATE_HEADER;
+		m_headerStart = end;
+	}
+
+	return true;
+}
+
+
+} // vmime
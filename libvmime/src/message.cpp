@@ -24,6 +24,8 @@
 #include "vmime/message.hpp"
 #include "vmime/options.hpp"
 
+#include "vmime/utility/arena.hpp"
+
 #include <sstream>
 
 
@@ -61,7 +63,15 @@ const string message::generate(const string::size_type maxLineLength,
 
 void message::parse(const string& buffer)
 {
-	bodyPart::parse(buffer);
+	if (options::getInstance()->message.arenaAllocation())
+	{
+		utility::arena::scope arenaScope;
+		bodyPart::parse(buffer);
+	}
+	else
+	{
+		bodyPart::parse(buffer);
+	}
 }
 
 
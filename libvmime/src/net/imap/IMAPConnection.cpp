@@ -41,6 +41,7 @@
 #endif // VMIME_HAVE_TLS_SUPPORT
 
 #include <sstream>
+#include <map>
 
 
 // Helpers for service properties
@@ -664,9 +665,73 @@ void IMAPConnection::sendRaw(const char* buffer, const int count)
 }
 
 
-IMAPParser::response* IMAPConnection::readResponse(IMAPParser::literalHandler* lh)
+IMAPParser::response* IMAPConnection::readResponse(IMAPParser::literalHandler* lh, IMAPParser::responseHandler* rh)
 {
-	return (m_parser->readResponse(lh));
+	return (m_parser->readResponse(lh, rh));
+}
+
+
+void IMAPConnection::sendPipelined(const std::vector <string>& commands,
+	std::vector <IMAPParser::response*>& responses, const int maxInFlight)
+{
+	if (maxInFlight < 1)
+		throw exceptions::invalid_argument();
+
+	std::vector <IMAPParser::response*> result(commands.size(), NULL);
+	std::map <string, std::vector <string>::size_type> inFlight;
+
+	std::vector <string>::size_type sent = 0, received = 0;
+
+	m_parser->setAcceptAnyTag(true);
+
+	try
+	{
+		while (received < commands.size())
+		{
+			while (sent < commands.size() &&
+			       inFlight.size() < static_cast <unsigned int>(maxInFlight))
+			{
+				send(true, commands[sent], true);
+				inFlight[*m_tag] = sent++;
+			}
+
+			IMAPParser::response* resp = m_parser->readResponse();
+			const IMAPParser::response_tagged* tagged = resp->response_done()->response_tagged();
+
+			std::map <string, std::vector <string>::size_type>::iterator it =
+				(tagged != NULL ? inFlight.find(tagged->tag()) : inFlight.end());
+
+			if (it == inFlight.end())
+			{
+				delete resp;
+
+				// Either a fatal response (BYE) or an unexpected tag: it
+				// does not answer any of the commands, so report it as is
+				throw exceptions::invalid_response("", m_parser->lastLine());
+			}
+
+			result[(*it).second] = resp;
+
+			inFlight.erase(it);
+			++received;
+		}
+	}
+	catch (std::exception&)
+	{
+		m_parser->setAcceptAnyTag(false);
+
+		for (std::vector <IMAPParser::response*>::iterator it = result.begin() ;
+		     it != result.end() ; ++it)
+		{
+			delete *it;
+		}
+
+		throw;
+	}
+
+	m_parser->setAcceptAnyTag(false);
+
+	responses.swap(result);
 }
 
 
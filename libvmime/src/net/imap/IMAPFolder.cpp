@@ -28,11 +28,13 @@
 #include "vmime/net/imap/IMAPMessage.hpp"
 #include "vmime/net/imap/IMAPUtils.hpp"
 #include "vmime/net/imap/IMAPConnection.hpp"
+#include "vmime/net/imap/IMAPPart.hpp"
 
 #include "vmime/message.hpp"
 
 #include "vmime/exception.hpp"
 #include "vmime/utility/smartPtr.hpp"
+#include "vmime/utility/stringUtils.hpp"
 
 #include <algorithm>
 #include <sstream>
@@ -658,6 +660,94 @@ std::vector <ref <folder> > IMAPFolder::getFolders(const bool recursive)
 }
 
 
+/** Passes FETCH responses to the messages they are about, as soon as
+  * they have been parsed.
+  */
+class IMAPFolder::fetchResponseHandler : public IMAPParser::responseHandler
+{
+public:
+
+	fetchResponseHandler(ref <IMAPFolder> folder, const int options, const int total,
+	                     utility::progressListener* progress)
+		: m_folder(folder), m_options(options), m_listener(NULL),
+		  m_total(total), m_current(0), m_progress(progress)
+	{
+	}
+
+	/** Fetch data for the specified messages only.
+	  */
+	void setMessages(const std::map <int, ref <IMAPMessage> >& messages)
+	{
+		m_messages = messages;
+	}
+
+	/** Create the messages on the fly, and pass them to a listener.
+	  */
+	void setListener(fetchListener* listener)
+	{
+		m_listener = listener;
+	}
+
+	int getTotal() const
+	{
+		return (m_total);
+	}
+
+	utility::progressListener* getProgressListener()
+	{
+		return (m_progress);
+	}
+
+	void handleResponseData(const IMAPParser::response_data& resp)
+	{
+		const IMAPParser::message_data* messageData = resp.message_data();
+
+		// We are only interested in responses of type "FETCH"
+		if (messageData == NULL || messageData->type() != IMAPParser::message_data::FETCH)
+			return;
+
+		// Process fetch response for this message
+		const int num = static_cast <int>(messageData->number());
+
+		ref <IMAPMessage> msg;
+
+		if (m_listener)
+		{
+			msg = vmime::create <IMAPMessage>(m_folder, num);
+		}
+		else
+		{
+			std::map <int, ref <IMAPMessage> >::iterator it = m_messages.find(num);
+
+			if (it == m_messages.end())
+				return;
+
+			msg = (*it).second;
+		}
+
+		msg->processFetchResponse(m_options, messageData->msg_att());
+
+		if (m_listener)
+			m_listener->messageFetched(msg);
+
+		if (m_progress)
+			m_progress->progress(++m_current, m_total);
+	}
+
+private:
+
+	ref <IMAPFolder> m_folder;
+	const int m_options;
+
+	std::map <int, ref <IMAPMessage> > m_messages;
+	fetchListener* m_listener;
+
+	const int m_total;
+	int m_current;
+	utility::progressListener* m_progress;
+};
+
+
 void IMAPFolder::fetchMessages(std::vector <ref <message> >& msg, const int options,
                                utility::progressListener* progress)
 {
@@ -680,71 +770,253 @@ void IMAPFolder::fetchMessages(std::vector <ref <message> >& msg, const int opti
 		numberToMsg[(*it)->getNumber()] = (*it).dynamicCast <IMAPMessage>();
 	}
 
-	// Send the request
-	const string command = IMAPUtils::buildFetchRequest(list, options);
-	m_connection->send(true, command, true);
+	fetchResponseHandler handler(thisRef().dynamicCast <IMAPFolder>(),
+		options, static_cast <int>(msg.size()), progress);
 
-	// Get the response
-	utility::auto_ptr <IMAPParser::response> resp(m_connection->readResponse());
+	handler.setMessages(numberToMsg);
 
-	if (resp->isBad() || resp->response_done()->response_tagged()->
-		resp_cond_state()->status() != IMAPParser::resp_cond_state::OK)
+	fetchMessages(IMAPUtils::listToSet(list, -1, false), options, handler);
+}
+
+
+void IMAPFolder::fetchMessages(const int from, const int to, const int options,
+                               fetchListener* listener, utility::progressListener* progress)
+{
+	ref <IMAPStore> store = m_store.acquire();
+
+	if (from < 1 || (to < from && to != -1) || listener == NULL)
+		throw exceptions::invalid_argument();
+
+	if (!store)
+		throw exceptions::illegal_state("Store disconnected");
+	else if (!isOpen())
+		throw exceptions::illegal_state("Folder not open");
+
+	std::ostringstream oss;
+	oss.imbue(std::locale::classic());
+
+	if (to == -1)
+		oss << from << ":*";
+	else
+		oss << from << ":" << to;
+
+	const int to2 = (to == -1) ? m_messageCount : to;
+
+	fetchResponseHandler handler(thisRef().dynamicCast <IMAPFolder>(),
+		options, (to2 >= from ? to2 - from + 1 : 0), progress);
+
+	handler.setListener(listener);
+
+	fetchMessages(oss.str(), options, handler);
+}
+
+
+void IMAPFolder::prefetchTextParts(std::vector <ref <message> >& msg, const int options,
+                                   const int maxLength, textPartListener* listener)
+{
+	ref <IMAPStore> store = m_store.acquire();
+
+	if (maxLength < 1 || listener == NULL)
+		throw exceptions::invalid_argument();
+
+	if (!store)
+		throw exceptions::illegal_state("Store disconnected");
+	else if (!isOpen())
+		throw exceptions::illegal_state("Folder not open");
+
+	// The sections of the text parts are only known once the
+	// structure of the messages has been fetched
+	fetchMessages(msg, options | FETCH_STRUCTURE);
+
+	// Group messages by list of items to fetch
+	std::map <string, std::vector <int> > groups;
+	std::map <int, ref <IMAPMessage> > numberToMsg;
+
+	for (std::vector <ref <message> >::iterator it = msg.begin() ; it != msg.end() ; ++it)
 	{
-		throw exceptions::command_error("FETCH",
-			m_connection->getParser()->lastLine(), "bad response");
+		std::vector <ref <const part> > parts;
+		findTextParts((*it)->getStructure(), parts);
+
+		if (parts.empty())
+			continue;
+
+		std::ostringstream items;
+		items.imbue(std::locale::classic());
+
+		for (std::vector <ref <const part> >::const_iterator jt = parts.begin() ; jt != parts.end() ; ++jt)
+		{
+			const string section = IMAPMessage::getSection(*jt);
+
+			if (jt != parts.begin()) items << " ";
+			items << "BODY.PEEK[" << (section.empty() ? "TEXT" : section) << "]<0." << maxLength << ">";
+		}
+
+		groups[items.str()].push_back((*it)->getNumber());
+		numberToMsg[(*it)->getNumber()] = (*it).dynamicCast <IMAPMessage>();
 	}
 
-	const std::vector <IMAPParser::continue_req_or_response_data*>& respDataList =
-		resp->continue_req_or_response_data();
+	if (groups.empty())
+		return;
 
-	const int total = msg.size();
-	int current = 0;
+	// Send one command per group
+	std::vector <string> commands;
+	commands.reserve(groups.size());
 
-	if (progress)
-		progress->start(total);
+	for (std::map <string, std::vector <int> >::const_iterator it = groups.begin() ;
+	     it != groups.end() ; ++it)
+	{
+		commands.push_back("FETCH " + IMAPUtils::listToSet((*it).second, -1, false)
+			+ " (" + (*it).first + ")");
+	}
+
+	std::vector <IMAPParser::response*> responses;
+	m_connection->sendPipelined(commands, responses);
+
+	std::vector <IMAPParser::response*>::size_type i = 0;
 
 	try
 	{
-		for (std::vector <IMAPParser::continue_req_or_response_data*>::const_iterator
-		     it = respDataList.begin() ; it != respDataList.end() ; ++it)
+		for ( ; i < responses.size() ; ++i)
 		{
-			if ((*it)->response_data() == NULL)
+			const IMAPParser::response* resp = responses[i];
+
+			if (resp->isBad() || resp->response_done()->response_tagged()->
+				resp_cond_state()->status() != IMAPParser::resp_cond_state::OK)
 			{
 				throw exceptions::command_error("FETCH",
-					m_connection->getParser()->lastLine(), "invalid response");
+					m_connection->getParser()->lastLine(), "bad response");
 			}
 
-			const IMAPParser::message_data* messageData =
-				(*it)->response_data()->message_data();
+			const std::vector <IMAPParser::continue_req_or_response_data*>& respDataList =
+				resp->continue_req_or_response_data();
 
-			// We are only interested in responses of type "FETCH"
-			if (messageData == NULL || messageData->type() != IMAPParser::message_data::FETCH)
-				continue;
+			for (std::vector <IMAPParser::continue_req_or_response_data*>::const_iterator
+			     it = respDataList.begin() ; it != respDataList.end() ; ++it)
+			{
+				if ((*it)->response_data() == NULL)
+					continue;
 
-			// Process fetch response for this message
-			const int num = static_cast <int>(messageData->number());
+				const IMAPParser::message_data* messageData =
+					(*it)->response_data()->message_data();
 
-			std::map <int, ref <IMAPMessage> >::iterator msg = numberToMsg.find(num);
+				// We are only interested in responses of type "FETCH"
+				if (messageData == NULL || messageData->type() != IMAPParser::message_data::FETCH)
+					continue;
 
-			if (msg != numberToMsg.end())
-			{
-				(*msg).second->processFetchResponse(options, messageData->msg_att());
+				std::map <int, ref <IMAPMessage> >::iterator msgIt =
+					numberToMsg.find(static_cast <int>(messageData->number()));
+
+				if (msgIt == numberToMsg.end())
+					continue;
+
+				const std::vector <IMAPParser::msg_att_item*>& items =
+					messageData->msg_att()->items();
 
-				if (progress)
-					progress->progress(++current, total);
+				for (std::vector <IMAPParser::msg_att_item*>::const_iterator
+				     jt = items.begin() ; jt != items.end() ; ++jt)
+				{
+					if ((*jt)->type() != IMAPParser::msg_att_item::BODY_SECTION)
+						continue;
+
+					ref <const part> p = findPart((*msgIt).second->getStructure(), (*jt)->section());
+
+					if (p != NULL)
+						listener->textPartFetched((*msgIt).second, p, (*jt)->nstring()->value());
+				}
 			}
+
+			delete responses[i];
+			responses[i] = NULL;
 		}
 	}
+	catch (std::exception&)
+	{
+		for ( ; i < responses.size() ; ++i)
+			delete responses[i];
+
+		throw;
+	}
+}
+
+
+// static
+void IMAPFolder::findTextParts(ref <const structure> str, std::vector <ref <const part> >& parts)
+{
+	for (int i = 0, n = str->getPartCount() ; i < n ; ++i)
+	{
+		ref <const part> p = str->getPartAt(i);
+
+		if (p->getType().getType() == mediaTypes::TEXT)
+			parts.push_back(p);
+
+		findTextParts(p->getStructure(), parts);
+	}
+}
+
+
+// static
+ref <const part> IMAPFolder::findPart(ref <const structure> str, const IMAPParser::section* section)
+{
+	if (str->getPartCount() == 0)
+		return NULL;
+
+	// Sections are numbered from the parts of the root part
+	ref <const part> p = str->getPartAt(0);
+
+	const std::vector <unsigned int>& numbers = section->nz_numbers();
+
+	for (std::vector <unsigned int>::const_iterator it = numbers.begin() ; it != numbers.end() ; ++it)
+	{
+		ref <const structure> sub = p->getStructure();
+
+		if (*it > static_cast <unsigned int>(sub->getPartCount()))
+			return NULL;
+
+		p = sub->getPartAt(*it - 1);
+	}
+
+	return (p);
+}
+
+
+void IMAPFolder::fetchMessages(const string& set, const int options, fetchResponseHandler& handler)
+{
+	// Send the request
+	const string command = IMAPUtils::buildFetchRequest(set, options);
+	m_connection->send(true, command, true);
+
+	// Get the response: messages are processed while it is being read,
+	// so that only one FETCH response is held in memory at a time
+	utility::progressListener* progress = handler.getProgressListener();
+
+	if (progress)
+		progress->start(handler.getTotal());
+
+	IMAPParser::response* response = NULL;
+
+	try
+	{
+		response = m_connection->readResponse(NULL, &handler);
+	}
 	catch (...)
 	{
 		if (progress)
-			progress->stop(total);
+			progress->stop(handler.getTotal());
 
 		throw;
 	}
 
 	if (progress)
-		progress->stop(total);
+		progress->stop(handler.getTotal());
+
+	utility::auto_ptr <IMAPParser::response> resp(response);
+
+	if (resp->isBad() || resp->response_done()->response_tagged()->
+		resp_cond_state()->status() != IMAPParser::resp_cond_state::OK)
+	{
+		throw exceptions::command_error("FETCH",
+			m_connection->getParser()->lastLine(), "bad response");
+	}
 }
 
 
@@ -1364,6 +1636,14 @@ void IMAPFolder::expunge()
 	// Get the response
 	utility::auto_ptr <IMAPParser::response> resp(m_connection->readResponse());
 
+	processExpungeResponse(resp);
+}
+
+
+void IMAPFolder::processExpungeResponse(const IMAPParser::response* resp)
+{
+	ref <IMAPStore> store = m_store.acquire();
+
 	if (resp->isBad() || resp->response_done()->response_tagged()->
 		resp_cond_state()->status() != IMAPParser::resp_cond_state::OK)
 	{
@@ -1659,14 +1939,126 @@ void IMAPFolder::copyMessages(const string& set, const folder::path& dest)
 }
 
 
-void IMAPFolder::status(int& count, int& unseen)
+void IMAPFolder::moveMessages(const folder::path& dest, const std::vector <int>& nums)
 {
 	ref <IMAPStore> store = m_store.acquire();
 
-	count = 0;
-	unseen = 0;
+	if (nums.empty())
+		throw exceptions::invalid_argument();
+
+	if (!store)
+		throw exceptions::illegal_state("Store disconnected");
+	else if (!isOpen())
+		throw exceptions::illegal_state("Folder not open");
+	else if (m_mode == MODE_READ_ONLY)
+		throw exceptions::illegal_state("Folder is read-only");
+
+	// The copy must have succeeded before anything is expunged,
+	// so it is not pipelined with the other commands
+	copyMessages(dest, nums);
+
+	// Mark the messages as deleted and expunge them
+	std::vector <int> list(nums);
+	std::sort(list.begin(), list.end());
 
-	// Build the request text
+	std::ostringstream command;
+	command.imbue(std::locale::classic());
+
+	command << "STORE ";
+	command << IMAPUtils::listToSet(list, m_messageCount, true);
+	command << " +FLAGS.SILENT (\\Deleted)";
+
+	std::vector <string> commands;
+	commands.push_back(command.str());
+	commands.push_back("EXPUNGE");
+
+	std::vector <IMAPParser::response*> responses;
+	m_connection->sendPipelined(commands, responses);
+
+	utility::auto_ptr <IMAPParser::response> storeResp(responses[0]);
+	utility::auto_ptr <IMAPParser::response> expungeResp(responses[1]);
+
+	if (storeResp->isBad() || storeResp->response_done()->response_tagged()->
+		resp_cond_state()->status() != IMAPParser::resp_cond_state::OK)
+	{
+		throw exceptions::command_error("STORE",
+			m_connection->getParser()->lastLine(), "bad response");
+	}
+
+	processExpungeResponse(expungeResp);
+}
+
+
+void IMAPFolder::status(int& count, int& unseen)
+{
+	// Send the request
+	m_connection->send(true, statusCommand(), true);
+
+	// Get the response
+	utility::auto_ptr <IMAPParser::response> resp(m_connection->readResponse());
+
+	processStatusResponse(resp, std::vector <IMAPParser::response*>(1, resp), count, unseen);
+}
+
+
+// static
+void IMAPFolder::status(const std::vector <ref <IMAPFolder> >& folders,
+	std::vector <int>& count, std::vector <int>& unseen)
+{
+	count.clear();
+	unseen.clear();
+
+	if (folders.empty())
+		return;
+
+	ref <IMAPConnection> connection = folders[0]->m_connection;
+
+	std::vector <string> commands;
+	commands.reserve(folders.size());
+
+	for (std::vector <ref <IMAPFolder> >::const_iterator it = folders.begin() ;
+	     it != folders.end() ; ++it)
+	{
+		if ((*it)->m_connection != connection)
+			throw exceptions::invalid_argument();
+
+		commands.push_back((*it)->statusCommand());
+	}
+
+	// Pipeline the requests. As the server may send the untagged STATUS
+	// data in any order, each folder looks up its own data by mailbox name
+	// in all the responses.
+	std::vector <IMAPParser::response*> responses;
+	connection->sendPipelined(commands, responses);
+
+	count.resize(folders.size(), 0);
+	unseen.resize(folders.size(), 0);
+
+	std::vector <IMAPParser::response*>::size_type i = 0;
+
+	try
+	{
+		for ( ; i < responses.size() ; ++i)
+		{
+			ref <IMAPFolder> folder = folders[i];
+			folder->processStatusResponse(responses[i], responses, count[i], unseen[i]);
+		}
+	}
+	catch (std::exception&)
+	{
+		for (i = 0 ; i < responses.size() ; ++i)
+			delete responses[i];
+
+		throw;
+	}
+
+	for (i = 0 ; i < responses.size() ; ++i)
+		delete responses[i];
+}
+
+
+const string IMAPFolder::statusCommand() const
+{
 	std::ostringstream command;
 	command.imbue(std::locale::classic());
 
@@ -1675,11 +2067,20 @@ void IMAPFolder::status(int& count, int& unseen)
 			(m_connection->hierarchySeparator(), getFullPath()));
 	command << " (MESSAGES UNSEEN)";
 
-	// Send the request
-	m_connection->send(true, command.str(), true);
+	return (command.str());
+}
 
-	// Get the response
-	utility::auto_ptr <IMAPParser::response> resp(m_connection->readResponse());
+
+void IMAPFolder::processStatusResponse(const IMAPParser::response* resp,
+	const std::vector <IMAPParser::response*>& dataResponses, int& count, int& unseen)
+{
+	ref <IMAPStore> store = m_store.acquire();
+
+	const string mailboxName = IMAPUtils::pathToString
+		(m_connection->hierarchySeparator(), getFullPath());
+
+	count = 0;
+	unseen = 0;
 
 	if (resp->isBad() || resp->response_done()->response_tagged()->
 		resp_cond_state()->status() != IMAPParser::resp_cond_state::OK)
@@ -1688,23 +2089,39 @@ void IMAPFolder::status(int& count, int& unseen)
 			m_connection->getParser()->lastLine(), "bad response");
 	}
 
-	const std::vector <IMAPParser::continue_req_or_response_data*>& respDataList =
-		resp->continue_req_or_response_data();
-
-	for (std::vector <IMAPParser::continue_req_or_response_data*>::const_iterator
-	     it = respDataList.begin() ; it != respDataList.end() ; ++it)
+	for (std::vector <IMAPParser::response*>::const_iterator
+	     rt = dataResponses.begin() ; rt != dataResponses.end() ; ++rt)
 	{
-		if ((*it)->response_data() == NULL)
+		const std::vector <IMAPParser::continue_req_or_response_data*>& respDataList =
+			(*rt)->continue_req_or_response_data();
+
+		for (std::vector <IMAPParser::continue_req_or_response_data*>::const_iterator
+		     it = respDataList.begin() ; it != respDataList.end() ; ++it)
 		{
-			throw exceptions::command_error("STATUS",
-				m_connection->getParser()->lastLine(), "invalid response");
-		}
+			if ((*it)->response_data() == NULL)
+			{
+				throw exceptions::command_error("STATUS",
+					m_connection->getParser()->lastLine(), "invalid response");
+			}
 
-		const IMAPParser::response_data* responseData = (*it)->response_data();
+			const IMAPParser::response_data* responseData = (*it)->response_data();
+
+			if (responseData->mailbox_data() == NULL ||
+			    responseData->mailbox_data()->type() != IMAPParser::mailbox_data::STATUS)
+			{
+				continue;
+			}
+
+			// Only keep the data for this folder ("INBOX" is case-insensitive)
+			const IMAPParser::mailbox* mbox = responseData->mailbox_data()->mailbox();
+
+			if (mbox->type() == IMAPParser::mailbox::INBOX
+				? utility::stringUtils::toLower(mailboxName) != "inbox"
+				: mbox->name() != mailboxName)
+			{
+				continue;
+			}
 
-		if (responseData->mailbox_data() &&
-			responseData->mailbox_data()->type() == IMAPParser::mailbox_data::STATUS)
-		{
 			const std::vector <IMAPParser::status_info*>& statusList =
 				responseData->mailbox_data()->status_info_list();
 
@@ -1743,8 +2160,8 @@ void IMAPFolder::status(int& count, int& unseen)
 			std::vector <int> nums;
 			nums.reserve(count - oldCount);
 
-			for (int i = oldCount + 1, j = 0 ; i <= count ; ++i, ++j)
-				nums[j] = i;
+			for (int i = oldCount + 1 ; i <= count ; ++i)
+				nums.push_back(i);
 
 			events::messageCountEvent event
 				(thisRef().dynamicCast <folder>(),
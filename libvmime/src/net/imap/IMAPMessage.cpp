@@ -239,31 +239,7 @@ void IMAPMessage::extract(ref <const part> p, utility::outputStream& os,
 	IMAPMessage_literalHandler literalHandler(os, progress);
 
 	// Construct section identifier
-	std::ostringstream section;
-	section.imbue(std::locale::classic());
-
-	if (p != NULL)
-	{
-		ref <const IMAPPart> currentPart = p.dynamicCast <const IMAPPart>();
-		std::vector <int> numbers;
-
-		numbers.push_back(currentPart->getNumber());
-		currentPart = currentPart->getParent();
-
-		while (currentPart != NULL)
-		{
-			numbers.push_back(currentPart->getNumber());
-			currentPart = currentPart->getParent();
-		}
-
-		numbers.erase(numbers.end() - 1);
-
-		for (std::vector <int>::reverse_iterator it = numbers.rbegin() ; it != numbers.rend() ; ++it)
-		{
-			if (it != numbers.rbegin()) section << ".";
-			section << (*it + 1);
-		}
-	}
+	const string section = (p != NULL ? getSection(p) : "");
 
 	// Build the request text
 	std::ostringstream command;
@@ -273,7 +249,7 @@ void IMAPMessage::extract(ref <const part> p, utility::outputStream& os,
 	if (peek) command << ".PEEK";
 	command << "[";
 
-	if (section.str().empty())
+	if (section.empty())
 	{
 		if (headerOnly)
 			command << "HEADER";
@@ -282,14 +258,25 @@ void IMAPMessage::extract(ref <const part> p, utility::outputStream& os,
 	}
 	else
 	{
-		command << section.str();
+		command << section;
 		if (headerOnly) command << ".MIME";   // "MIME" not "HEADER" for parts
 	}
 
 	command << "]";
 
+	// Partial fetch: the length of the range is mandatory, and the
+	// server returns less data if the section ends before
 	if (start != 0 || length != -1)
-		command << "<" << start << "." << length << ">";
+	{
+		command << "<" << start << ".";
+
+		if (length == -1)
+			command << static_cast <unsigned int>(-1);
+		else
+			command << length;
+
+		command << ">";
+	}
 
 	// Send the request
 	folder.constCast <IMAPFolder>()->m_connection->send(true, command.str(), true);
@@ -313,6 +300,36 @@ void IMAPMessage::extract(ref <const part> p, utility::outputStream& os,
 }
 
 
+// static
+const string IMAPMessage::getSection(ref <const part> p)
+{
+	ref <const IMAPPart> currentPart = p.dynamicCast <const IMAPPart>();
+	std::vector <int> numbers;
+
+	numbers.push_back(currentPart->getNumber());
+	currentPart = currentPart->getParent();
+
+	while (currentPart != NULL)
+	{
+		numbers.push_back(currentPart->getNumber());
+		currentPart = currentPart->getParent();
+	}
+
+	numbers.erase(numbers.end() - 1);
+
+	std::ostringstream section;
+	section.imbue(std::locale::classic());
+
+	for (std::vector <int>::reverse_iterator it = numbers.rbegin() ; it != numbers.rend() ; ++it)
+	{
+		if (it != numbers.rbegin()) section << ".";
+		section << (*it + 1);
+	}
+
+	return (section.str());
+}
+
+
 void IMAPMessage::fetch(ref <IMAPFolder> msgFolder, const int options)
 {
 	ref <IMAPFolder> folder = m_folder.acquire();
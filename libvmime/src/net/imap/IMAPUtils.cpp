@@ -610,6 +610,13 @@ const string IMAPUtils::dateTime(const vmime::datetime& date)
 
 // static
 const string IMAPUtils::buildFetchRequest(const std::vector <int>& list, const int options)
+{
+	return (buildFetchRequest(listToSet(list, -1, false), options));
+}
+
+
+// static
+const string IMAPUtils::buildFetchRequest(const string& set, const int options)
 {
 	// Example:
 	//   C: A654 FETCH 2:4 (FLAGS BODY[HEADER.FIELDS (DATE FROM)])
@@ -671,7 +678,7 @@ const string IMAPUtils::buildFetchRequest(const std::vector <int>& list, const i
 	std::ostringstream command;
 	command.imbue(std::locale::classic());
 
-	command << "FETCH " << listToSet(list, -1, false) << " (";
+	command << "FETCH " << set << " (";
 
 	for (std::vector <string>::const_iterator it = items.begin() ;
 	     it != items.end() ; ++it)
@@ -741,7 +741,6 @@ void POP3Store::sendRequest(const string& buffer, const bool end)
 void POP3Store::readResponse(string& buffer, const bool multiLine,
                              utility::progressListener* progress)
 {
-	bool foundTerminator = false;
 	int current = 0, total = 0;
 
 	if (progress)
@@ -752,67 +751,53 @@ void POP3Store::readResponse(string& buffer, const bool multiLine,
 
 	buffer.clear();
 
-	string::value_type last1 = '\0', last2 = '\0';
-
-	for ( ; !foundTerminator ; )
-	{
-#if 0 // not supported
-		// Check for possible cancellation
-		if (progress && progress->cancel())
-			throw exceptions::operation_cancelled();
-#endif
+	// The buffer receives the first line, then the multi-line data
+	utility::outputStreamStringAdapter os(buffer);
+	utility::dotUnstuffingFilteredOutputStream dos(os);
 
-		// Check whether the time-out delay is elapsed
-		if (m_timeoutHandler && m_timeoutHandler->isTimeOut())
-		{
-			if (!m_timeoutHandler->handleTimeOut())
-				throw exceptions::operation_timed_out();
+	bool firstLineDone = false;
+	bool foundTerminator = false;
 
-			m_timeoutHandler->resetTimeOut();
-		}
+	while (!foundTerminator)
+	{
+		char receiveBuffer[4096];
+		const int read = receive(receiveBuffer, sizeof(receiveBuffer));
 
-		// Receive data from the socket
-		string receiveBuffer;
-		m_socket->receive(receiveBuffer);
+		const char* data = receiveBuffer;
+		const char* end = receiveBuffer + read;
 
-		if (receiveBuffer.empty())   // buffer is empty
+		if (!firstLineDone)
 		{
-			platform::getHandler()->wait();
-			continue;
-		}
+			const char* eol = std::find(data, end, '\n');
 
-		// We have received data: reset the time-out counter
-		if (m_timeoutHandler)
-			m_timeoutHandler->resetTimeOut();
+			if (eol != end)
+			{
+				buffer.append(data, eol + 1);
+				data = eol + 1;
 
-		// Check for transparent characters: '\n..' becomes '\n.'
-		const string::value_type first = receiveBuffer[0];
+				firstLineDone = true;
 
-		if (first == '.' && last2 == '\n' && last1 == '.')
-		{
-			receiveBuffer.erase(receiveBuffer.begin());
-		}
-		else if (receiveBuffer.length() >= 2 && first == '.' &&
-		         receiveBuffer[1] == '.' && last1 == '\n')
-		{
-			receiveBuffer.erase(receiveBuffer.begin());
+				// If there is an error (-ERR) when executing a command that
+				// requires a multi-line response, the error response will
+				// include only one line, so we do not wait for a multi-line
+				// terminator.
+				if (!multiLine || buffer[0] == '-')
+					foundTerminator = checkTerminator(buffer, false);
+			}
+			else
+			{
+				buffer.append(data, end);
+				data = end;
+			}
 		}
 
-		for (string::size_type trans ;
-		     string::npos != (trans = receiveBuffer.find("\n..")) ; )
+		if (firstLineDone && !foundTerminator)
 		{
-			receiveBuffer.replace(trans, 3, "\n.");
+			dos.write(data, end - data);
+			foundTerminator = dos.isTerminated();
 		}
 
-		last1 = receiveBuffer[receiveBuffer.length() - 1];
-		last2 = static_cast <char>((receiveBuffer.length() >= 2) ? receiveBuffer[receiveBuffer.length() - 2] : 0);
-
-		// Append the data to the response buffer
-		buffer += receiveBuffer;
-		current += receiveBuffer.length();
-
-		// Check for terminator string (and strip it if present)
-		foundTerminator = checkTerminator(buffer, multiLine);
+		current += read;
 
 		// Notify progress
 		if (progress)
@@ -820,15 +805,6 @@ void POP3Store::readResponse(string& buffer, const bool multiLine,
 			total = std::max(total, current);
 			progress->progress(current, total);
 		}
-
-		// If there is an error (-ERR) when executing a command that
-		// requires a multi-line response, the error response will
-		// include only one line, so we stop waiting for a multi-line
-		// terminator and check for a "normal" one.
-		if (multiLine && !foundTerminator && buffer.length() >= 4 && buffer[0] == '-')
-		{
-			foundTerminator = checkTerminator(buffer, false);
-		}
 	}
 
 	if (progress)
@@ -841,7 +817,7 @@ void POP3Store::readResponse(utility::outputStream& os,
 {
 	int current = 0, total = predictedSize;
 
-	string temp;
+	string firstLine;
 	bool codeDone = false;
 
 	if (progress)
@@ -850,31 +826,67 @@ void POP3Store::readResponse(utility::outputStream& os,
 	if (m_timeoutHandler)
 		m_timeoutHandler->resetTimeOut();
 
-	utility::inputStreamSocketAdapter sis(*m_socket);
-	utility::stopSequenceFilteredInputStream <5> sfis1(sis, "\r\n.\r\n");
-	utility::stopSequenceFilteredInputStream <3> sfis2(sfis1, "\n.\n");
-	utility::dotFilteredInputStream dfis(sfis2);   // "\n.." --> "\n."
+	// Data is unstuffed as it is received and written directly
+	// into the output stream, until the terminator is found
+	utility::dotUnstuffingFilteredOutputStream dos(os);
 
-	utility::inputStream& is = dfis;
-
-	while (!is.eof())
+	while (!dos.isTerminated())
 	{
-#if 0 // not supported
-		// Check for possible cancellation
-		if (progress && progress->cancel())
-			throw exceptions::operation_cancelled();
-#endif
+		char buffer[65536];
+		const int read = receive(buffer, sizeof(buffer));
+
+		const char* data = buffer;
+		const char* end = buffer + read;
+
+		// If we don't have extracted the response code yet
+		if (!codeDone)
+		{
+			const char* eol = std::find(data, end, '\n');
+
+			firstLine.append(data, eol);
+
+			if (eol == end)
+				continue;
+
+			if (!isSuccessResponse(firstLine))
+				throw exceptions::command_error("?", firstLine);
 
+			codeDone = true;
+			data = eol + 1;
+		}
+
+		// Inject the data into the output stream
+		dos.write(data, end - data);
+		current += static_cast <int>(end - data);
+
+		// Notify progress
+		if (progress)
+		{
+			total = std::max(total, current);
+			progress->progress(current, total);
+		}
+	}
+
+	if (progress)
+		progress->stop(total);
+}
+
+
+int POP3Store::receive(char* buffer, const int count)
+{
+	for ( ; ; )
+	{
 		// Check whether the time-out delay is elapsed
 		if (m_timeoutHandler && m_timeoutHandler->isTimeOut())
 		{
 			if (!m_timeoutHandler->handleTimeOut())
 				throw exceptions::operation_timed_out();
+
+			m_timeoutHandler->resetTimeOut();
 		}
 
 		// Receive data from the socket
-		utility::stream::value_type buffer[65536];
-		const utility::stream::size_type read = is.read(buffer, sizeof(buffer));
+		const int read = m_socket->receiveRaw(buffer, count);
 
 		if (read == 0)   // buffer is empty
 		{
@@ -886,43 +898,8 @@ void POP3Store::readResponse(utility::outputStream& os,
 		if (m_timeoutHandler)
 			m_timeoutHandler->resetTimeOut();
 
-		// If we don't have extracted the response code yet
-		if (!codeDone)
-		{
-			temp += string(buffer, read);
-
-			string firstLine;
-
-			if (stripFirstLine(temp, temp, &firstLine) == true)
-			{
-				if (!isSuccessResponse(firstLine))
-					throw exceptions::command_error("?", firstLine);
-
-				codeDone = true;
-
-				os.write(temp.data(), temp.length());
-				temp.clear();
-
-				continue;
-			}
-		}
-		else
-		{
-			// Inject the data into the output stream
-			os.write(buffer, read);
-			current += read;
-
-			// Notify progress
-			if (progress)
-			{
-				total = std::max(total, current);
-				progress->progress(current, total);
-			}
-		}
+		return (read);
 	}
-
-	if (progress)
-		progress->stop(total);
 }
 
 
@@ -24,6 +24,8 @@
 #include "vmime/types.hpp"
 #include "vmime/object.hpp"
 
+#include "vmime/utility/arena.hpp"
+
 
 #ifndef VMIME_BUILDING_DOC
 
@@ -32,6 +34,85 @@ namespace vmime
 {
 
 
+// static
+void* object::operator new(std::size_t size)
+{
+	return utility::arena::allocate(size);
+}
+
+
+// static
+void object::operator delete(void* ptr)
+{
+	utility::arena::deallocate(ptr);
+}
+
+
+#if VMIME_INTRUSIVE_REFCOUNT
+
+
+object::object()
+	: m_strongCount(1), m_refMgr(0)
+{
+}
+
+
+object::object(const object&)
+	: m_strongCount(1), m_refMgr(0)
+{
+}
+
+
+object& object::operator=(const object&)
+{
+	// Do _NOT_ copy reference count and 'm_refMgr'
+	return *this;
+}
+
+
+object::~object()
+{
+	// Weak references to this object now point to NULL
+	if (m_refMgr)
+	{
+		static_cast <utility::weakRefManagerImpl*>(m_refMgr)->detachObject();
+		m_refMgr = 0;
+	}
+}
+
+
+void object::releaseStrongRef() const
+{
+	if (m_strongCount.decrement() <= 0)
+	{
+		try
+		{
+			delete this;
+		}
+		catch (...)
+		{
+			// Exception in destructor
+		}
+	}
+}
+
+
+void object::setRefManager(utility::refManager* mgr)
+{
+	m_refMgr = mgr;
+}
+
+
+utility::refManager* object::getRefManager() const
+{
+	return utility::weakRefManagerImpl::getOrCreate
+		(const_cast <object*>(this), &m_refMgr);
+}
+
+
+#else // !VMIME_INTRUSIVE_REFCOUNT
+
+
 object::object()
 	: m_refMgr(utility::refManager::create(this))
 {
@@ -58,41 +139,44 @@ object::~object()
 }
 
 
-ref <object> object::thisRef()
+void object::setRefManager(utility::refManager* mgr)
 {
-	m_refMgr->addStrong();
-	return ref <object>::fromPtr(this);
+	m_refMgr = mgr;
 }
 
 
-ref <const object> object::thisRef() const
+utility::refManager* object::getRefManager() const
 {
-	m_refMgr->addStrong();
-	return ref <const object>::fromPtr(this);
+	return m_refMgr;
 }
 
 
-weak_ref <object> object::thisWeakRef()
+#endif // VMIME_INTRUSIVE_REFCOUNT
+
+
+ref <object> object::thisRef()
 {
-	return weak_ref <object>(thisRef());
+	addStrongRef();
+	return ref <object>::fromPtr(this);
 }
 
 
-weak_ref <const object> object::thisWeakRef() const
+ref <const object> object::thisRef() const
 {
-	return weak_ref <const object>(thisRef());
+	addStrongRef();
+	return ref <const object>::fromPtr(this);
 }
 
 
-void object::setRefManager(utility::refManager* mgr)
+weak_ref <object> object::thisWeakRef()
 {
-	m_refMgr = mgr;
+	return weak_ref <object>(thisRef());
 }
 
 
-utility::refManager* object::getRefManager() const
+weak_ref <const object> object::thisWeakRef() const
 {
-	return m_refMgr;
+	return weak_ref <const object>(thisRef());
 }
 
 
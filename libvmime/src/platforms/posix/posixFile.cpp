@@ -29,12 +29,15 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 
 #include <dirent.h>
 
 #include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
+
 #include "vmime/exception.hpp"
 
 
@@ -225,6 +228,101 @@ vmime::utility::stream::size_type posixFileReaderInputStream::skip(const size_ty
 
 
 
+//
+// posixFileMappedReaderInputStream
+//
+
+posixFileMappedReaderInputStream::posixFileMappedReaderInputStream
+	(const vmime::utility::file::path& path, const int fd)
+	: m_path(path), m_fd(fd), m_data(NULL), m_length(0), m_pos(0)
+{
+	struct stat buf;
+
+	if (::fstat(m_fd, &buf) == -1)
+	{
+		::close(m_fd);
+		posixFileSystemFactory::reportError(m_path, errno);
+	}
+
+	// Zero-length mappings are not allowed
+	if (buf.st_size == 0)
+		return;
+
+	void* addr = ::mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+
+	if (addr == MAP_FAILED)
+	{
+		::close(m_fd);
+		posixFileSystemFactory::reportError(m_path, errno);
+	}
+
+	m_data = static_cast <value_type*>(addr);
+	m_length = static_cast <size_type>(buf.st_size);
+
+	// Contents are mostly consumed front to back
+	::madvise(m_data, m_length, MADV_SEQUENTIAL);
+}
+
+
+posixFileMappedReaderInputStream::~posixFileMappedReaderInputStream()
+{
+	if (m_data != NULL)
+		::munmap(m_data, m_length);
+
+	if (::close(m_fd) == -1)
+		posixFileSystemFactory::reportError(m_path, errno);
+}
+
+
+bool posixFileMappedReaderInputStream::eof() const
+{
+	return (m_pos >= m_length);
+}
+
+
+void posixFileMappedReaderInputStream::reset()
+{
+	m_pos = 0;
+}
+
+
+vmime::utility::stream::size_type posixFileMappedReaderInputStream::read
+	(value_type* const data, const size_type count)
+{
+	const size_type n = std::min(count, m_length - m_pos);
+
+	if (n != 0)
+		::memcpy(data, m_data + m_pos, n);
+
+	m_pos += n;
+
+	return (n);
+}
+
+
+vmime::utility::stream::size_type posixFileMappedReaderInputStream::skip(const size_type count)
+{
+	const size_type n = std::min(count, m_length - m_pos);
+
+	m_pos += n;
+
+	return (n);
+}
+
+
+const vmime::utility::stream::value_type* posixFileMappedReaderInputStream::getData() const
+{
+	return (m_data);
+}
+
+
+vmime::utility::stream::size_type posixFileMappedReaderInputStream::getLength() const
+{
+	return (m_length);
+}
+
+
+
 //
 // posixFileWriter
 //
@@ -269,6 +367,28 @@ ref <vmime::utility::inputStream> posixFileReader::getInputStream()
 
 
 
+//
+// posixFileMappedReader
+//
+
+posixFileMappedReader::posixFileMappedReader(const vmime::utility::file::path& path, const vmime::string& nativePath)
+	: m_path(path), m_nativePath(nativePath)
+{
+}
+
+
+ref <vmime::utility::inputStream> posixFileMappedReader::getInputStream()
+{
+	int fd = 0;
+
+	if ((fd = ::open(m_nativePath.c_str(), O_RDONLY, 0640)) == -1)
+		posixFileSystemFactory::reportError(m_path, errno);
+
+	return vmime::create <posixFileMappedReaderInputStream>(m_path, fd);
+}
+
+
+
 //
 // posixFile
 //
@@ -454,6 +574,12 @@ ref <vmime::utility::fileReader> posixFile::getFileReader()
 }
 
 
+ref <vmime::utility::fileReader> posixFile::getMappedFileReader()
+{
+	return vmime::create <posixFileMappedReader>(m_path, m_nativePath);
+}
+
+
 ref <vmime::utility::fileIterator> posixFile::getFiles() const
 {
 	if (!isDirectory())
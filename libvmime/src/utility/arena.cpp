@@ -0,0 +1,239 @@
+//
+// VMime library (http://www.vmime.org)
+// Copyright (C) 2002-2009 Vincent Richard <vincent@vincent-richard.net>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// Linking this library statically or dynamically with other modules is making
+// a combined work based on this library.  Thus, the terms and conditions of
+// the GNU General Public License cover the whole combination.
+//
+
+#include "vmime/utility/arena.hpp"
+
+#include <new>
+
+
+namespace vmime {
+namespace utility {
+
+
+namespace {
+
+
+// Stored before each block returned by arena::allocate(); the union
+// keeps the block aligned like a pointer, a long or a double (8 bytes
+// on common platforms), which is enough for the objects of the library
+// but not for types with a stricter alignment, such as long double
+union allocationHeader
+{
+	arena* owner;
+	void* p;
+	long l;
+	double d;
+};
+
+
+// Arena in which objects are allocated by the current thread
+#if defined(__GNUC__)
+__thread arena* currentArena = NULL;
+#elif defined(_MSC_VER)
+__declspec(thread) arena* currentArena = NULL;
+#else
+arena* currentArena = NULL;  // no thread-local storage: not thread-safe
+#endif
+
+
+const std::size_t FIRST_CHUNK_SIZE = 4096;
+const std::size_t MAX_CHUNK_SIZE = 65536;
+
+
+} // namespace
+
+
+arena::scope::scope()
+	: m_arena(new arena), m_previous(currentArena)
+{
+	currentArena = m_arena;
+}
+
+
+arena::scope::scope(cache& c)
+	: m_previous(currentArena)
+{
+	if (c.m_arena->m_refs == 1)
+	{
+		// Only the cache holds the arena
+		c.m_arena->reset();
+	}
+	else
+	{
+		// Objects from the previous scope are still alive: leave the
+		// arena to them
+		c.m_arena->release();
+		c.m_arena = new arena;
+	}
+
+	m_arena = c.m_arena;
+	m_arena->m_refs.increment();
+
+	currentArena = m_arena;
+}
+
+
+arena::scope::~scope()
+{
+	currentArena = m_previous;
+
+	m_arena->release();
+}
+
+
+arena::cache::cache()
+	: m_arena(new arena)
+{
+}
+
+
+arena::cache::~cache()
+{
+	m_arena->release();
+}
+
+
+arena::arena()
+	: m_pos(NULL), m_left(0), m_nextChunkSize(FIRST_CHUNK_SIZE), m_capacity(0), m_refs(1)
+{
+}
+
+
+arena::~arena()
+{
+	for (std::vector <char*>::iterator it = m_chunks.begin() ; it != m_chunks.end() ; ++it)
+		::operator delete(*it);
+}
+
+
+void* arena::allocateBlock(const std::size_t size)
+{
+	// Keep the next block aligned
+	const std::size_t blockSize = (size + sizeof(allocationHeader) - 1)
+		/ sizeof(allocationHeader) * sizeof(allocationHeader);
+
+	if (blockSize > m_left)
+	{
+		const std::size_t chunkSize = (blockSize > m_nextChunkSize ? blockSize : m_nextChunkSize);
+
+		m_chunks.reserve(m_chunks.size() + 1);
+
+		char* chunk = static_cast <char*>(::operator new(chunkSize));
+		m_chunks.push_back(chunk);
+
+		m_pos = chunk;
+		m_left = chunkSize;
+		m_capacity += chunkSize;
+
+		if (m_nextChunkSize < MAX_CHUNK_SIZE)
+			m_nextChunkSize *= 2;
+	}
+
+	void* block = m_pos;
+
+	m_pos += blockSize;
+	m_left -= blockSize;
+
+	return block;
+}
+
+
+void arena::release()
+{
+	if (m_refs.decrement() <= 0)
+		delete this;
+}
+
+
+void arena::reset()
+{
+	if (m_chunks.size() > 1)
+	{
+		// Replace the chunks with a single one, large enough to
+		// hold everything which was allocated last time
+		const std::size_t size = m_capacity;
+
+		for (std::vector <char*>::iterator it = m_chunks.begin() ; it != m_chunks.end() ; ++it)
+			::operator delete(*it);
+
+		m_chunks.clear();
+		m_pos = NULL;
+		m_left = 0;
+		m_capacity = 0;
+
+		m_chunks.push_back(static_cast <char*>(::operator new(size)));
+		m_capacity = size;
+	}
+
+	if (m_chunks.empty())
+	{
+		m_pos = NULL;
+		m_left = 0;
+	}
+	else
+	{
+		m_pos = m_chunks[0];
+		m_left = m_capacity;
+	}
+}
+
+
+// static
+void* arena::allocate(const std::size_t size)
+{
+	arena* owner = currentArena;
+	allocationHeader* header;
+
+	if (owner != NULL)
+	{
+		header = static_cast <allocationHeader*>(owner->allocateBlock(sizeof(allocationHeader) + size));
+		owner->m_refs.increment();
+	}
+	else
+	{
+		header = static_cast <allocationHeader*>(::operator new(sizeof(allocationHeader) + size));
+	}
+
+	header->owner = owner;
+
+	return header + 1;
+}
+
+
+// static
+void arena::deallocate(void* ptr)
+{
+	if (ptr == NULL)
+		return;
+
+	allocationHeader* header = static_cast <allocationHeader*>(ptr) - 1;
+
+	if (header->owner != NULL)
+		header->owner->release();
+	else
+		::operator delete(header);
+}
+
+
+} // utility
+} // vmime
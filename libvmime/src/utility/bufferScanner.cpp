@@ -0,0 +1,382 @@
+//
+// VMime library (http://www.vmime.org)
+// Copyright (C) 2002-2009 Vincent Richard <vincent@vincent-richard.net>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// Linking this library statically or dynamically with other modules is making
+// a combined work based on this library.  Thus, the terms and conditions of
+// the GNU General Public License cover the whole combination.
+//
+
+#include "vmime/utility/bufferScanner.hpp"
+#include "vmime/utility/cpuFeatures.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if VMIME_HAVE_SSE2_INTRINSICS
+#	include <emmintrin.h>
+#endif
+
+#if VMIME_HAVE_AVX2_INTRINSICS
+#	include <immintrin.h>
+#endif
+
+
+namespace vmime {
+namespace utility {
+
+
+namespace {
+
+
+typedef string::size_type size_type;
+
+typedef void (*findAllFunc)(const char* data, const size_type start, const size_type end,
+	const char* needle, const size_type needleLength, std::vector <size_type>& positions);
+
+typedef size_type (*findNonASCIIFunc)(const char* data, const size_type length);
+
+typedef size_type (*copyUntilFunc)(const char* data, const size_type length,
+	const char c1, const char c2, char* out);
+
+
+// Check a candidate whose first and last characters already match
+inline bool matchesAt(const char* data, const size_type pos,
+	const char* needle, const size_type needleLength)
+{
+	return needleLength <= 2 || std::memcmp(data + pos + 1, needle + 1, needleLength - 2) == 0;
+}
+
+
+void findAllScalar(const char* data, const size_type start, const size_type end,
+	const char* needle, const size_type needleLength, std::vector <size_type>& positions)
+{
+	const char first = needle[0];
+	const char last = needle[needleLength - 1];
+
+	for (size_type pos = start ; pos + needleLength <= end ; )
+	{
+		const void* p = std::memchr(data + pos, first, end - needleLength + 1 - pos);
+
+		if (p == NULL)
+			break;
+
+		pos = static_cast <size_type>(static_cast <const char*>(p) - data);
+
+		if (data[pos + needleLength - 1] == last && matchesAt(data, pos, needle, needleLength))
+			positions.push_back(pos);
+
+		++pos;
+	}
+}
+
+
+#if VMIME_HAVE_SSE2_INTRINSICS
+
+// Compare the first and the last characters of the needle at 16
+// consecutive positions at once, then verify the candidates.
+void findAllSSE2(const char* data, const size_type start, const size_type end,
+	const char* needle, const size_type needleLength, std::vector <size_type>& positions)
+{
+	const __m128i first = _mm_set1_epi8(needle[0]);
+	const __m128i last = _mm_set1_epi8(needle[needleLength - 1]);
+
+	size_type pos = start;
+
+	for ( ; pos + needleLength - 1 + 16 <= end ; pos += 16)
+	{
+		const __m128i blockFirst = _mm_loadu_si128(reinterpret_cast <const __m128i*>(data + pos));
+		const __m128i blockLast = _mm_loadu_si128(reinterpret_cast <const __m128i*>(data + pos + needleLength - 1));
+
+		unsigned int mask = static_cast <unsigned int>(_mm_movemask_epi8
+			(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last))));
+
+		while (mask != 0)
+		{
+			const size_type candidate = pos + static_cast <size_type>(__builtin_ctz(mask));
+
+			if (matchesAt(data, candidate, needle, needleLength))
+				positions.push_back(candidate);
+
+			mask &= mask - 1;
+		}
+	}
+
+	findAllScalar(data, pos, end, needle, needleLength, positions);
+}
+
+#endif // VMIME_HAVE_SSE2_INTRINSICS
+
+
+#if VMIME_HAVE_AVX2_INTRINSICS
+
+__attribute__((target("avx2")))
+void findAllAVX2(const char* data, const size_type start, const size_type end,
+	const char* needle, const size_type needleLength, std::vector <size_type>& positions)
+{
+	const __m256i first = _mm256_set1_epi8(needle[0]);
+	const __m256i last = _mm256_set1_epi8(needle[needleLength - 1]);
+
+	size_type pos = start;
+
+	for ( ; pos + needleLength - 1 + 32 <= end ; pos += 32)
+	{
+		const __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast <const __m256i*>(data + pos));
+		const __m256i blockLast = _mm256_loadu_si256(reinterpret_cast <const __m256i*>(data + pos + needleLength - 1));
+
+		unsigned int mask = static_cast <unsigned int>(_mm256_movemask_epi8
+			(_mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last))));
+
+		while (mask != 0)
+		{
+			const size_type candidate = pos + static_cast <size_type>(__builtin_ctz(mask));
+
+			if (matchesAt(data, candidate, needle, needleLength))
+				positions.push_back(candidate);
+
+			mask &= mask - 1;
+		}
+	}
+
+	findAllScalar(data, pos, end, needle, needleLength, positions);
+}
+
+#endif // VMIME_HAVE_AVX2_INTRINSICS
+
+
+findAllFunc selectFindAll()
+{
+#if VMIME_HAVE_AVX2_INTRINSICS
+	if (cpuFeatures::hasAVX2())
+		return findAllAVX2;
+#endif
+
+#if VMIME_HAVE_SSE2_INTRINSICS
+	if (cpuFeatures::hasSSE2())
+		return findAllSSE2;
+#endif
+
+	return findAllScalar;
+}
+
+
+size_type findNonASCIIScalar(const char* data, const size_type length)
+{
+	for (size_type pos = 0 ; pos < length ; ++pos)
+	{
+		if (static_cast <unsigned char>(data[pos]) >= 0x80)
+			return pos;
+	}
+
+	return length;
+}
+
+
+#if VMIME_HAVE_SSE2_INTRINSICS
+
+size_type findNonASCIISSE2(const char* data, const size_type length)
+{
+	size_type pos = 0;
+
+	for ( ; pos + 16 <= length ; pos += 16)
+	{
+		const unsigned int mask = static_cast <unsigned int>(_mm_movemask_epi8
+			(_mm_loadu_si128(reinterpret_cast <const __m128i*>(data + pos))));
+
+		if (mask != 0)
+			return pos + static_cast <size_type>(__builtin_ctz(mask));
+	}
+
+	return pos + findNonASCIIScalar(data + pos, length - pos);
+}
+
+#endif // VMIME_HAVE_SSE2_INTRINSICS
+
+
+#if VMIME_HAVE_AVX2_INTRINSICS
+
+__attribute__((target("avx2")))
+size_type findNonASCIIAVX2(const char* data, const size_type length)
+{
+	size_type pos = 0;
+
+	for ( ; pos + 32 <= length ; pos += 32)
+	{
+		const unsigned int mask = static_cast <unsigned int>(_mm256_movemask_epi8
+			(_mm256_loadu_si256(reinterpret_cast <const __m256i*>(data + pos))));
+
+		if (mask != 0)
+			return pos + static_cast <size_type>(__builtin_ctz(mask));
+	}
+
+	return pos + findNonASCIIScalar(data + pos, length - pos);
+}
+
+#endif // VMIME_HAVE_AVX2_INTRINSICS
+
+
+findNonASCIIFunc selectFindNonASCII()
+{
+#if VMIME_HAVE_AVX2_INTRINSICS
+	if (cpuFeatures::hasAVX2())
+		return findNonASCIIAVX2;
+#endif
+
+#if VMIME_HAVE_SSE2_INTRINSICS
+	if (cpuFeatures::hasSSE2())
+		return findNonASCIISSE2;
+#endif
+
+	return findNonASCIIScalar;
+}
+
+
+size_type copyUntilScalar(const char* data, const size_type length,
+	const char c1, const char c2, char* out)
+{
+	for (size_type pos = 0 ; pos < length ; ++pos)
+	{
+		if (data[pos] == c1 || data[pos] == c2)
+			return pos;
+
+		out[pos] = data[pos];
+	}
+
+	return length;
+}
+
+
+#if VMIME_HAVE_SSE2_INTRINSICS
+
+// Blocks are stored before looking for the characters: bytes after
+// the returned position may be overwritten, which is allowed.
+size_type copyUntilSSE2(const char* data, const size_type length,
+	const char c1, const char c2, char* out)
+{
+	const __m128i v1 = _mm_set1_epi8(c1);
+	const __m128i v2 = _mm_set1_epi8(c2);
+
+	size_type pos = 0;
+
+	for ( ; pos + 16 <= length ; pos += 16)
+	{
+		const __m128i block = _mm_loadu_si128(reinterpret_cast <const __m128i*>(data + pos));
+
+		_mm_storeu_si128(reinterpret_cast <__m128i*>(out + pos), block);
+
+		const unsigned int mask = static_cast <unsigned int>(_mm_movemask_epi8
+			(_mm_or_si128(_mm_cmpeq_epi8(block, v1), _mm_cmpeq_epi8(block, v2))));
+
+		if (mask != 0)
+			return pos + static_cast <size_type>(__builtin_ctz(mask));
+	}
+
+	return pos + copyUntilScalar(data + pos, length - pos, c1, c2, out + pos);
+}
+
+#endif // VMIME_HAVE_SSE2_INTRINSICS
+
+
+#if VMIME_HAVE_AVX2_INTRINSICS
+
+__attribute__((target("avx2")))
+size_type copyUntilAVX2(const char* data, const size_type length,
+	const char c1, const char c2, char* out)
+{
+	const __m256i v1 = _mm256_set1_epi8(c1);
+	const __m256i v2 = _mm256_set1_epi8(c2);
+
+	size_type pos = 0;
+
+	for ( ; pos + 32 <= length ; pos += 32)
+	{
+		const __m256i block = _mm256_loadu_si256(reinterpret_cast <const __m256i*>(data + pos));
+
+		_mm256_storeu_si256(reinterpret_cast <__m256i*>(out + pos), block);
+
+		const unsigned int mask = static_cast <unsigned int>(_mm256_movemask_epi8
+			(_mm256_or_si256(_mm256_cmpeq_epi8(block, v1), _mm256_cmpeq_epi8(block, v2))));
+
+		if (mask != 0)
+			return pos + static_cast <size_type>(__builtin_ctz(mask));
+	}
+
+	// Finish with 128-bit blocks, as runs are often short
+	return pos + copyUntilSSE2(data + pos, length - pos, c1, c2, out + pos);
+}
+
+#endif // VMIME_HAVE_AVX2_INTRINSICS
+
+
+copyUntilFunc selectCopyUntil()
+{
+#if VMIME_HAVE_AVX2_INTRINSICS
+	if (cpuFeatures::hasAVX2())
+		return copyUntilAVX2;
+#endif
+
+#if VMIME_HAVE_SSE2_INTRINSICS
+	if (cpuFeatures::hasSSE2())
+		return copyUntilSSE2;
+#endif
+
+	return copyUntilScalar;
+}
+
+
+} // namespace
+
+
+// static
+void bufferScanner::findAll(const string& buffer, const string& needle,
+	const string::size_type start, const string::size_type end,
+	std::vector <string::size_type>& positions)
+{
+	static const findAllFunc impl = selectFindAll();
+
+	const size_type needleLength = needle.length();
+	const size_type realEnd = std::min(end, buffer.length());
+
+	if (needleLength == 0 || start >= realEnd || realEnd - start < needleLength)
+		return;
+
+	impl(buffer.data(), start, realEnd, needle.data(), needleLength, positions);
+}
+
+
+// static
+string::size_type bufferScanner::findNonASCII(const char* data, const string::size_type length)
+{
+	static const findNonASCIIFunc impl = selectFindNonASCII();
+
+	return impl(data, length);
+}
+
+
+// static
+string::size_type bufferScanner::copyUntil(const char* data, const string::size_type length,
+	const char c1, const char c2, char* out)
+{
+	static const copyUntilFunc impl = selectCopyUntil();
+
+	return impl(data, length, c1, c2, out);
+}
+
+
+
+} // utility
+} // vmime
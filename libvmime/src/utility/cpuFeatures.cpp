@@ -0,0 +1,108 @@
+//
+// VMime library (http://www.vmime.org)
+// Copyright (C) 2002-2009 Vincent Richard <vincent@vincent-richard.net>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// Linking this library statically or dynamically with other modules is making
+// a combined work based on this library.  Thus, the terms and conditions of
+// the GNU General Public License cover the whole combination.
+//
+
+#include "vmime/utility/cpuFeatures.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#	include <cpuid.h>
+#	define VMIME_CPUID_X86 1
+#endif
+
+
+namespace vmime {
+namespace utility {
+
+
+#if VMIME_CPUID_X86
+
+// Read the XCR0 register, to check that the OS saves the YMM registers
+static unsigned int readXCR0()
+{
+	unsigned int eax, edx;
+
+	// xgetbv, encoded for assemblers which do not know it
+	__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a" (eax), "=d" (edx) : "c" (0));
+
+	return eax;
+}
+
+#endif // VMIME_CPUID_X86
+
+
+cpuFeatures::features::features()
+	: sse2(false), ssse3(false), avx2(false)
+{
+#if VMIME_CPUID_X86
+
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return;
+
+	sse2 = (edx & (1 << 26)) != 0;
+	ssse3 = (ecx & (1 << 9)) != 0;
+
+	const bool osxsave = (ecx & (1 << 27)) != 0;
+	const bool avx = (ecx & (1 << 28)) != 0;
+
+	if (osxsave && avx && (readXCR0() & 0x6) == 0x6 && __get_cpuid_max(0, NULL) >= 7)
+	{
+		__cpuid_count(7, 0, eax, ebx, ecx, edx);
+		avx2 = (ebx & (1 << 5)) != 0;
+	}
+
+#endif // VMIME_CPUID_X86
+}
+
+
+// static
+const cpuFeatures::features& cpuFeatures::getFeatures()
+{
+	static const features instance;
+	return (instance);
+}
+
+
+// static
+bool cpuFeatures::hasSSE2()
+{
+	return (VMIME_HAVE_SSE2_INTRINSICS && getFeatures().sse2);
+}
+
+
+// static
+bool cpuFeatures::hasSSSE3()
+{
+	return (VMIME_HAVE_SSSE3_INTRINSICS && getFeatures().ssse3);
+}
+
+
+// static
+bool cpuFeatures::hasAVX2()
+{
+	return (VMIME_HAVE_AVX2_INTRINSICS && getFeatures().avx2);
+}
+
+
+} // utility
+} // vmime
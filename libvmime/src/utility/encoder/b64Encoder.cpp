@@ -22,14 +22,594 @@
 //
 
 #include "vmime/utility/encoder/b64Encoder.hpp"
+#include "vmime/utility/cpuFeatures.hpp"
 #include "vmime/parserHelpers.hpp"
 
+#if VMIME_HAVE_SSSE3_INTRINSICS
+#	include <tmmintrin.h>
+#endif
+
+#if VMIME_HAVE_AVX2_INTRINSICS
+#	include <immintrin.h>
+#endif
+
 
 namespace vmime {
 namespace utility {
 namespace encoder {
 
 
+namespace {
+
+
+typedef string::size_type size_type;
+
+
+// The vectorized functions may write up to this number of bytes
+// past the end of their output
+const size_type OUTPUT_SLACK = 32;
+
+
+//
+// Encoding
+//
+
+// Encode as many groups of 3 bytes as possible at once; 'available' is
+// the number of bytes which can be read from 'in'. Return the number
+// of groups encoded.
+typedef size_type (*encodeBlocksFunc)(const unsigned char* in,
+	const size_type groups, const size_type available, unsigned char* out);
+
+
+size_type encodeBlocksScalar(const unsigned char* /* in */,
+	const size_type /* groups */, const size_type /* available */, unsigned char* /* out */)
+{
+	return 0;
+}
+
+
+#if VMIME_HAVE_SSSE3_INTRINSICS
+
+// Encode 12 bytes (read from a 16-byte register) into 16 characters
+__attribute__((target("ssse3")))
+inline __m128i encodeBlockSSSE3(__m128i in)
+{
+	// Put the bits of each group of 3 bytes into 4 bytes, and
+	// move each 6-bit value to the low bits of its byte
+	in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+
+	const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+	const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+	const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+
+	const __m128i indices = _mm_or_si128(t1, t3);
+
+	// Map 6-bit values to the alphabet: compute a class for each value
+	// (0 for 'a'-'z', 1-10 for digits, 11 for '+', 12 for '/', 13 for
+	// 'A'-'Z'), then look up the offset to add for this class
+	__m128i classes = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+	const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+	classes = _mm_or_si128(classes, _mm_and_si128(less, _mm_set1_epi8(13)));
+
+	const __m128i offsets = _mm_setr_epi8
+		('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		 '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+	return _mm_add_epi8(_mm_shuffle_epi8(offsets, classes), indices);
+}
+
+
+__attribute__((target("ssse3")))
+size_type encodeBlocksSSSE3(const unsigned char* in,
+	const size_type groups, const size_type available, unsigned char* out)
+{
+	size_type done = 0;
+
+	for ( ; done + 4 <= groups && done * 3 + 16 <= available ; done += 4)
+	{
+		const __m128i block = _mm_loadu_si128(reinterpret_cast <const __m128i*>(in + done * 3));
+		_mm_storeu_si128(reinterpret_cast <__m128i*>(out + done * 4), encodeBlockSSSE3(block));
+	}
+
+	return done;
+}
+
+#endif // VMIME_HAVE_SSSE3_INTRINSICS
+
+
+#if VMIME_HAVE_AVX2_INTRINSICS
+
+__attribute__((target("avx2")))
+size_type encodeBlocksAVX2(const unsigned char* in,
+	const size_type groups, const size_type available, unsigned char* out)
+{
+	size_type done = 0;
+
+	for ( ; done + 8 <= groups && done * 3 + 28 <= available ; done += 8)
+	{
+		// 12 bytes in each lane
+		const __m128i lo = _mm_loadu_si128(reinterpret_cast <const __m128i*>(in + done * 3));
+		const __m128i hi = _mm_loadu_si128(reinterpret_cast <const __m128i*>(in + done * 3 + 12));
+
+		__m256i block = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+		block = _mm256_shuffle_epi8(block, _mm256_setr_epi8
+			(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+			 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+
+		const __m256i t0 = _mm256_and_si256(block, _mm256_set1_epi32(0x0fc0fc00));
+		const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+		const __m256i t2 = _mm256_and_si256(block, _mm256_set1_epi32(0x003f03f0));
+		const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+
+		const __m256i indices = _mm256_or_si256(t1, t3);
+
+		__m256i classes = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+		const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+		classes = _mm256_or_si256(classes, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+
+		const __m256i offsets = _mm256_setr_epi8
+			('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			 '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+			 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			 '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+		const __m256i result = _mm256_add_epi8(_mm256_shuffle_epi8(offsets, classes), indices);
+
+		_mm256_storeu_si256(reinterpret_cast <__m256i*>(out + done * 4), result);
+	}
+
+	return done + encodeBlocksSSSE3(in + done * 3, groups - done, available - done * 3, out + done * 4);
+}
+
+#endif // VMIME_HAVE_AVX2_INTRINSICS
+
+
+encodeBlocksFunc selectEncodeBlocks()
+{
+#if VMIME_HAVE_AVX2_INTRINSICS
+	if (cpuFeatures::hasAVX2())
+		return encodeBlocksAVX2;
+#endif
+
+#if VMIME_HAVE_SSSE3_INTRINSICS
+	if (cpuFeatures::hasSSSE3())
+		return encodeBlocksSSSE3;
+#endif
+
+	return encodeBlocksScalar;
+}
+
+
+/** Encoder state, kept between chunks of data.
+  */
+
+class encodeState
+{
+public:
+
+	// 'maxLineLength' is the value of the "maxlinelength" property
+	encodeState(const unsigned char* alphabet, const int maxLineLength)
+		: m_alphabet(alphabet), m_groupsPerLine(0), m_lineGroups(0)
+	{
+		static const encodeBlocksFunc impl = selectEncodeBlocks();
+		m_encodeBlocks = impl;
+
+		if (maxLineLength != -1)
+		{
+			// A line break is inserted when the line length reaches
+			// 'maxLineLength' - 2 (CRLF) - 4 (next group)
+			const int threshold = std::min(maxLineLength, 76) - 2 - 4;
+
+			m_groupsPerLine = (threshold <= 4 ? 1 : static_cast <size_type>((threshold + 3) / 4));
+		}
+	}
+
+	/** Return the maximum number of bytes written by encode()
+	  * for the specified number of input bytes.
+	  */
+	static size_type getMaxEncodedLength(const size_type length)
+	{
+		// 4 characters and at most a line break per group
+		return (length / 3 + 1) * 6 + OUTPUT_SLACK;
+	}
+
+	/** Encode the complete groups of 3 bytes in the input and, if
+	  * 'final' is set, the last incomplete group.
+	  *
+	  * @return number of bytes consumed
+	  */
+	size_type encode(const unsigned char* in, const size_type length,
+		const bool final, unsigned char* out, size_type& outLength)
+	{
+		size_type groups = length / 3;
+		size_type pos = 0;
+
+		outLength = 0;
+
+		while (groups != 0)
+		{
+			size_type count = groups;
+
+			if (m_groupsPerLine != 0 && count > m_groupsPerLine - m_lineGroups)
+				count = m_groupsPerLine - m_lineGroups;
+
+			const size_type done = m_encodeBlocks(in + pos, count, length - pos, out + outLength);
+
+			for (size_type i = done ; i < count ; ++i)
+				encodeGroup(in + pos + i * 3, 3, out + outLength + i * 4);
+
+			pos += count * 3;
+			outLength += count * 4;
+			groups -= count;
+
+			endGroups(count, out, outLength);
+		}
+
+		if (final && pos < length)
+		{
+			encodeGroup(in + pos, length - pos, out + outLength);
+
+			outLength += 4;
+			pos = length;
+
+			endGroups(1, out, outLength);
+		}
+
+		return pos;
+	}
+
+private:
+
+	void encodeGroup(const unsigned char* bytes, const size_type count, unsigned char* output) const
+	{
+		switch (count)
+		{
+		case 1:
+
+			output[0] = m_alphabet[(bytes[0] & 0xFC) >> 2];
+			output[1] = m_alphabet[(bytes[0] & 0x03) << 4];
+			output[2] = m_alphabet[64]; // padding
+			output[3] = m_alphabet[64]; // padding
+
+			break;
+
+		case 2:
+
+			output[0] = m_alphabet[(bytes[0] & 0xFC) >> 2];
+			output[1] = m_alphabet[((bytes[0] & 0x03) << 4) | ((bytes[1] & 0xF0) >> 4)];
+			output[2] = m_alphabet[(bytes[1] & 0x0F) << 2];
+			output[3] = m_alphabet[64]; // padding
+
+			break;
+
+		default:
+		case 3:
+
+			output[0] = m_alphabet[(bytes[0] & 0xFC) >> 2];
+			output[1] = m_alphabet[((bytes[0] & 0x03) << 4) | ((bytes[1] & 0xF0) >> 4)];
+			output[2] = m_alphabet[((bytes[1] & 0x0F) << 2) | ((bytes[2] & 0xC0) >> 6)];
+			output[3] = m_alphabet[(bytes[2] & 0x3F)];
+
+			break;
+		}
+	}
+
+	// Insert a line break if the current line is full
+	void endGroups(const size_type count, unsigned char* out, size_type& outLength)
+	{
+		if (m_groupsPerLine != 0)
+		{
+			m_lineGroups += count;
+
+			if (m_lineGroups >= m_groupsPerLine)
+			{
+				out[outLength++] = '\r';
+				out[outLength++] = '\n';
+
+				m_lineGroups = 0;
+			}
+		}
+	}
+
+
+	const unsigned char* m_alphabet;
+	encodeBlocksFunc m_encodeBlocks;
+
+	size_type m_groupsPerLine;  // 0 if lines are not cut
+	size_type m_lineGroups;     // number of groups on the current line
+};
+
+
+//
+// Decoding
+//
+
+// Decode as many blocks of valid base64 characters as possible at once
+// (whitespace, padding and invalid characters stop decoding). Return
+// the number of characters decoded.
+typedef size_type (*decodeBlocksFunc)(const unsigned char* in,
+	const size_type length, unsigned char* out, size_type& outLength);
+
+
+size_type decodeBlocksScalar(const unsigned char* /* in */,
+	const size_type /* length */, unsigned char* /* out */, size_type& /* outLength */)
+{
+	return 0;
+}
+
+
+#if VMIME_HAVE_SSSE3_INTRINSICS
+
+__attribute__((target("ssse3")))
+size_type decodeBlocksSSSE3(const unsigned char* in,
+	const size_type length, unsigned char* out, size_type& outLength)
+{
+	size_type pos = 0;
+
+	for ( ; pos + 16 <= length ; pos += 16)
+	{
+		const __m128i block = _mm_loadu_si128(reinterpret_cast <const __m128i*>(in + pos));
+
+		// Find the character ranges and the offset to add to get the
+		// 6-bit values; characters >= 0x80 are negative and never match
+		const __m128i upper = _mm_and_si128
+			(_mm_cmpgt_epi8(block, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(block, _mm_set1_epi8('Z' + 1)));
+		const __m128i lower = _mm_and_si128
+			(_mm_cmpgt_epi8(block, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(block, _mm_set1_epi8('z' + 1)));
+		const __m128i digit = _mm_and_si128
+			(_mm_cmpgt_epi8(block, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(block, _mm_set1_epi8('9' + 1)));
+		const __m128i plus = _mm_cmpeq_epi8(block, _mm_set1_epi8('+'));
+		const __m128i slash = _mm_cmpeq_epi8(block, _mm_set1_epi8('/'));
+
+		const __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(_mm_or_si128(digit, plus), slash));
+
+		if (_mm_movemask_epi8(valid) != 0xffff)
+			break;
+
+		const __m128i offset = _mm_or_si128
+			(_mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')), _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+			 _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+			 	_mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(62 - '+')), _mm_and_si128(slash, _mm_set1_epi8(63 - '/')))));
+
+		const __m128i values = _mm_add_epi8(block, offset);
+
+		// Merge the 6-bit values: 4 bytes => 24 bits
+		const __m128i merged = _mm_madd_epi16
+			(_mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140)), _mm_set1_epi32(0x00011000));
+
+		const __m128i result = _mm_shuffle_epi8(merged, _mm_setr_epi8
+			(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+		_mm_storeu_si128(reinterpret_cast <__m128i*>(out + outLength), result);
+		outLength += 12;
+	}
+
+	return pos;
+}
+
+#endif // VMIME_HAVE_SSSE3_INTRINSICS
+
+
+#if VMIME_HAVE_AVX2_INTRINSICS
+
+__attribute__((target("avx2")))
+size_type decodeBlocksAVX2(const unsigned char* in,
+	const size_type length, unsigned char* out, size_type& outLength)
+{
+	size_type pos = 0;
+
+	for ( ; pos + 32 <= length ; pos += 32)
+	{
+		const __m256i block = _mm256_loadu_si256(reinterpret_cast <const __m256i*>(in + pos));
+
+		const __m256i upper = _mm256_andnot_si256
+			(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('Z')), _mm256_cmpgt_epi8(block, _mm256_set1_epi8('A' - 1)));
+		const __m256i lower = _mm256_andnot_si256
+			(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('z')), _mm256_cmpgt_epi8(block, _mm256_set1_epi8('a' - 1)));
+		const __m256i digit = _mm256_andnot_si256
+			(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('9')), _mm256_cmpgt_epi8(block, _mm256_set1_epi8('0' - 1)));
+		const __m256i plus = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('+'));
+		const __m256i slash = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('/'));
+
+		const __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(_mm256_or_si256(digit, plus), slash));
+
+		if (_mm256_movemask_epi8(valid) != -1)
+			break;
+
+		const __m256i offset = _mm256_or_si256
+			(_mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-'A')), _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a'))),
+			 _mm256_or_si256(_mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')),
+			 	_mm256_or_si256(_mm256_and_si256(plus, _mm256_set1_epi8(62 - '+')), _mm256_and_si256(slash, _mm256_set1_epi8(63 - '/')))));
+
+		const __m256i values = _mm256_add_epi8(block, offset);
+
+		const __m256i merged = _mm256_madd_epi16
+			(_mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140)), _mm256_set1_epi32(0x00011000));
+
+		// 12 bytes in each lane, then make them contiguous
+		const __m256i shuffled = _mm256_shuffle_epi8(merged, _mm256_setr_epi8
+			(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+			 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+		const __m256i result = _mm256_permutevar8x32_epi32(shuffled, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+
+		_mm256_storeu_si256(reinterpret_cast <__m256i*>(out + outLength), result);
+		outLength += 24;
+	}
+
+	return pos + decodeBlocksSSSE3(in + pos, length - pos, out, outLength);
+}
+
+#endif // VMIME_HAVE_AVX2_INTRINSICS
+
+
+decodeBlocksFunc selectDecodeBlocks()
+{
+#if VMIME_HAVE_AVX2_INTRINSICS
+	if (cpuFeatures::hasAVX2())
+		return decodeBlocksAVX2;
+#endif
+
+#if VMIME_HAVE_SSSE3_INTRINSICS
+	if (cpuFeatures::hasSSSE3())
+		return decodeBlocksSSSE3;
+#endif
+
+	return decodeBlocksScalar;
+}
+
+
+/** Decoder state, kept between chunks of data.
+  */
+
+class decodeState
+{
+public:
+
+	decodeState(const unsigned char* decodeMap)
+		: m_decodeMap(decodeMap), m_count(0), m_finished(false)
+	{
+		static const decodeBlocksFunc impl = selectDecodeBlocks();
+		m_decodeBlocks = impl;
+	}
+
+	/** Return the maximum number of bytes written by decode()
+	  * for the specified number of input bytes.
+	  */
+	static size_type getMaxDecodedLength(const size_type length)
+	{
+		return (length / 4 + 1) * 3 + OUTPUT_SLACK;
+	}
+
+	/** Test whether the end of the encoded data has been reached
+	  * (ie. padding was found).
+	  *
+	  * @return true if no more data should be decoded
+	  */
+	bool isFinished() const
+	{
+		return m_finished;
+	}
+
+	/** Decode a chunk of data. Whitespace is ignored, and an
+	  * incomplete group is kept for the next call.
+	  *
+	  * @return number of bytes written to 'out'
+	  */
+	size_type decode(const unsigned char* in, const size_type length, unsigned char* out)
+	{
+		size_type outLength = 0;
+		size_type pos = 0;
+
+		while (!m_finished && pos < length)
+		{
+			// Decode whole blocks of valid characters at once
+			if (m_count == 0)
+			{
+				pos += m_decodeBlocks(in + pos, length - pos, out, outLength);
+
+				if (pos == length)
+					break;
+			}
+
+			// Then go on until the end of the next group (this takes
+			// care of whitespace, padding and invalid characters)
+			while (pos < length)
+			{
+				const unsigned char c = in[pos++];
+
+				if (!parserHelpers::isSpace(c))
+				{
+					m_bytes[m_count++] = c;
+
+					if (m_count == 4)
+					{
+						decodeGroup(out, outLength);
+						break;
+					}
+				}
+			}
+		}
+
+		return outLength;
+	}
+
+	/** Decode the last incomplete group, if any.
+	  *
+	  * @return number of bytes written to 'out'
+	  */
+	size_type finish(unsigned char* out)
+	{
+		size_type outLength = 0;
+
+		if (!m_finished && m_count != 0)
+		{
+			// Missing characters are treated as padding
+			while (m_count < 4)
+				m_bytes[m_count++] = '=';
+
+			decodeGroup(out, outLength);
+		}
+
+		m_finished = true;
+
+		return outLength;
+	}
+
+private:
+
+	void decodeGroup(unsigned char* output, size_type& outLength)
+	{
+		m_count = 0;
+
+		unsigned char c1 = m_bytes[0];
+		unsigned char c2 = m_bytes[1];
+
+		if (c1 == '=' || c2 == '=')  // end
+		{
+			m_finished = true;
+			return;
+		}
+
+		output[outLength++] = static_cast <unsigned char>((m_decodeMap[c1] << 2) | ((m_decodeMap[c2] & 0x30) >> 4));
+
+		c1 = m_bytes[2];
+
+		if (c1 == '=')  // end
+		{
+			m_finished = true;
+			return;
+		}
+
+		output[outLength++] = static_cast <unsigned char>(((m_decodeMap[c2] & 0xf) << 4) | ((m_decodeMap[c1] & 0x3c) >> 2));
+
+		c2 = m_bytes[3];
+
+		if (c2 == '=')  // end
+		{
+			m_finished = true;
+			return;
+		}
+
+		output[outLength++] = static_cast <unsigned char>(((m_decodeMap[c1] & 0x03) << 6) | m_decodeMap[c2]);
+	}
+
+
+	const unsigned char* m_decodeMap;
+	decodeBlocksFunc m_decodeBlocks;
+
+	unsigned char m_bytes[4];
+	int m_count;
+
+	bool m_finished;
+};
+
+
+} // namespace
+
+
 b64Encoder::b64Encoder()
 {
 }
@@ -80,107 +660,62 @@ utility::stream::size_type b64Encoder::encode(utility::inputStream& in,
 {
 	in.reset();  // may not work...
 
-	const int propMaxLineLength = getProperties().getProperty <int>("maxlinelength", -1);
+	encodeState state(sm_alphabet, getProperties().getProperty <int>("maxlinelength", -1));
 
-	const bool cutLines = (propMaxLineLength != -1);
-	const int maxLineLength = std::min(propMaxLineLength, 76);
+	// Process data; input is encoded by slices so that the output
+	// buffer stays small
+	enum { SLICE_SIZE = 3072 };
 
-	// Process data
-	utility::stream::value_type buffer[65536];
-	utility::stream::size_type bufferLength = 0;
-	utility::stream::size_type bufferPos = 0;
+	unsigned char buffer[65536];
+	size_type bufferLength = 0;
 
-	unsigned char bytes[3];
-	unsigned char output[4];
+	unsigned char output[SLICE_SIZE / 3 * 6 + 6 + OUTPUT_SLACK];
 
 	utility::stream::size_type total = 0;
 	utility::stream::size_type inTotal = 0;
 
-	int curCol = 0;
-
 	if (progress)
 		progress->start(0);
 
-	while (bufferPos < bufferLength || !in.eof())
+	while (true)
 	{
-		if (bufferPos >= bufferLength)
-		{
-			bufferLength = in.read(buffer, sizeof(buffer));
-			bufferPos = 0;
+		// Unencoded bytes from the previous chunk (incomplete group)
+		// are at the beginning of the buffer
+		const size_type read = in.read(reinterpret_cast <utility::stream::value_type*>
+			(buffer + bufferLength), sizeof(buffer) - bufferLength);
 
-			if (bufferLength == 0)
-				break;
-		}
-
-		// Get 3 bytes of data
-		int count = 0;
-
-		while (count < 3 && bufferPos < bufferLength)
-			bytes[count++] = buffer[bufferPos++];
-
-		while (count < 3)
-		{
-			// There may be more data in the next chunk...
-			if (bufferPos >= bufferLength)
-			{
-				bufferLength = in.read(buffer, sizeof(buffer));
-				bufferPos = 0;
-
-				if (bufferLength == 0)
-					break;
-			}
+		bufferLength += read;
 
-			while (count < 3 && bufferPos < bufferLength)
-				bytes[count++] = buffer[bufferPos++];
-		}
+		const bool final = (read == 0 || in.eof());
+		size_type pos = 0;
 
-		// Encode data
-		switch (count)
+		while (pos < bufferLength)
 		{
-		case 1:
-
-			output[0] = sm_alphabet[(bytes[0] & 0xFC) >> 2];
-			output[1] = sm_alphabet[(bytes[0] & 0x03) << 4];
-			output[2] = sm_alphabet[64]; // padding
-			output[3] = sm_alphabet[64]; // padding
-
-			break;
-
-		case 2:
+			const size_type sliceLength = std::min(bufferLength - pos, static_cast <size_type>(SLICE_SIZE));
+			const bool finalSlice = (final && pos + sliceLength == bufferLength);
 
-			output[0] = sm_alphabet[(bytes[0] & 0xFC) >> 2];
-			output[1] = sm_alphabet[((bytes[0] & 0x03) << 4) | ((bytes[1] & 0xF0) >> 4)];
-			output[2] = sm_alphabet[(bytes[1] & 0x0F) << 2];
-			output[3] = sm_alphabet[64]; // padding
-
-			break;
+			size_type outLength = 0;
+			const size_type consumed = state.encode(buffer + pos, sliceLength, finalSlice, output, outLength);
 
-		default:
-		case 3:
+			B64_WRITE(out, output, outLength);
+			total += outLength;
 
-			output[0] = sm_alphabet[(bytes[0] & 0xFC) >> 2];
-			output[1] = sm_alphabet[((bytes[0] & 0x03) << 4) | ((bytes[1] & 0xF0) >> 4)];
-			output[2] = sm_alphabet[((bytes[1] & 0x0F) << 2) | ((bytes[2] & 0xC0) >> 6)];
-			output[3] = sm_alphabet[(bytes[2] & 0x3F)];
+			pos += consumed;
 
-			break;
+			if (consumed != sliceLength)
+				break;
 		}
 
-		// Write encoded data to output stream
-		B64_WRITE(out, output, 4);
-
-		inTotal += count;
-		total += 4;
-		curCol += 4;
+		inTotal += pos;
 
-		if (cutLines && curCol >= maxLineLength - 2 /* \r\n */ - 4 /* next bytes */)
-		{
-			out.write("\r\n", 2);
-			curCol = 0;
-		}
+		std::copy(buffer + pos, buffer + bufferLength, buffer);
+		bufferLength -= pos;
 
 		if (progress)
 			progress->progress(inTotal, inTotal);
+
+		if (final)
+			break;
 	}
 
 	if (progress)
@@ -195,111 +730,81 @@ utility::stream::size_type b64Encoder::decode(utility::inputStream& in,
 {
 	in.reset();  // may not work...
 
+	decodeState state(sm_decodeMap);
+
 	// Process the data
-	char buffer[16384];
-	int bufferLength = 0;
-	int bufferPos = 0;
+	unsigned char buffer[16384];
+	unsigned char output[sizeof(buffer) / 4 * 3 + 3 + OUTPUT_SLACK];
 
 	utility::stream::size_type total = 0;
 	utility::stream::size_type inTotal = 0;
 
-	unsigned char bytes[4];
-	unsigned char output[3];
-
 	if (progress)
 		progress->start(0);
 
-	while (bufferPos < bufferLength || !in.eof())
+	while (!state.isFinished() && !in.eof())
 	{
-		bytes[0] = '=';
-		bytes[1] = '=';
-		bytes[2] = '=';
-		bytes[3] = '=';
+		const size_type length = in.read(reinterpret_cast <utility::stream::value_type*>(buffer), sizeof(buffer));
 
-		// Need to get more data?
-		if (bufferPos >= bufferLength)
-		{
-			bufferLength = in.read(buffer, sizeof(buffer));
-			bufferPos = 0;
+		// No more data
+		if (length == 0)
+			break;
 
-			// No more data
-			if (bufferLength == 0)
-				break;
-		}
+		const size_type outLength = state.decode(buffer, length, output);
 
-		// 4 bytes of input provide 3 bytes of output, so
-		// get the next 4 bytes from the input stream.
-		int count = 0;
+		B64_WRITE(out, output, outLength);
 
-		while (count < 4 && bufferPos < bufferLength)
-		{
-			const unsigned char c = buffer[bufferPos++];
+		total += outLength;
+		inTotal += length;
 
-			if (!parserHelpers::isSpace(c))
-				bytes[count++] = c;
-		}
+		if (progress)
+			progress->progress(inTotal, inTotal);
+	}
 
-		if (count != 4)
-		{
-			while (count < 4 && !in.eof())
-			{
-				// Data continues on the next chunk
-				bufferLength = in.read(buffer, sizeof(buffer));
-				bufferPos = 0;
+	const size_type outLength = state.finish(output);
 
-				while (count < 4 && bufferPos < bufferLength)
-				{
-					const unsigned char c = buffer[bufferPos++];
+	B64_WRITE(out, output, outLength);
+	total += outLength;
 
-					if (!parserHelpers::isSpace(c))
-						bytes[count++] = c;
-				}
-			}
-		}
+	if (progress)
+		progress->stop(inTotal);
 
-		// Decode the bytes
-		unsigned char c1 = bytes[0];
-		unsigned char c2 = bytes[1];
+	return (total);
+}
 
-		if (c1 == '=' || c2 == '=')  // end
-			break;
 
-		output[0] = static_cast <unsigned char>((sm_decodeMap[c1] << 2) | ((sm_decodeMap[c2] & 0x30) >> 4));
+// static
+void b64Encoder::encodeBuffer(const char* data, const string::size_type length,
+	string& out, const int maxLineLength)
+{
+	encodeState state(sm_alphabet, maxLineLength);
 
-		c1 = bytes[2];
+	const string::size_type outStart = out.length();
+	out.resize(outStart + encodeState::getMaxEncodedLength(length));
 
-		if (c1 == '=')  // end
-		{
-			B64_WRITE(out, output, 1);
-			total += 1;
-			break;
-		}
+	size_type outLength = 0;
 
-		output[1] = static_cast <unsigned char>(((sm_decodeMap[c2] & 0xf) << 4) | ((sm_decodeMap[c1] & 0x3c) >> 2));
+	state.encode(reinterpret_cast <const unsigned char*>(data), length,
+		true, reinterpret_cast <unsigned char*>(&out[outStart]), outLength);
 
-		c2 = bytes[3];
+	out.resize(outStart + outLength);
+}
 
-		if (c2 == '=')  // end
-		{
-			B64_WRITE(out, output, 2);
-			total += 2;
-			break;
-		}
 
-		output[2] = static_cast <unsigned char>(((sm_decodeMap[c1] & 0x03) << 6) | sm_decodeMap[c2]);
+// static
+void b64Encoder::decodeBuffer(const char* data, const string::size_type length, string& out)
+{
+	decodeState state(sm_decodeMap);
 
-		B64_WRITE(out, output, 3);
-		total += 3;
-		inTotal += count;
+	const string::size_type outStart = out.length();
+	out.resize(outStart + decodeState::getMaxDecodedLength(length));
 
-		if (progress)
-			progress->progress(inTotal, inTotal);
-	}
+	unsigned char* output = reinterpret_cast <unsigned char*>(&out[outStart]);
 
-	if (progress)
-		progress->stop(inTotal);
+	size_type outLength = state.decode(reinterpret_cast <const unsigned char*>(data), length, output);
+	outLength += state.finish(output + outLength);
 
-	return (total);
+	out.resize(outStart + outLength);
 }
 
 
@@ -23,6 +23,9 @@
 
 #include "vmime/utility/encoder/qpEncoder.hpp"
 #include "vmime/parserHelpers.hpp"
+#include "vmime/utility/bufferScanner.hpp"
+
+#include <algorithm>
 
 
 namespace vmime {
@@ -410,6 +413,25 @@ utility::stream::size_type qpEncoder::decode(utility::inputStream& in,
 				break;
 		}
 
+		// Copy literal characters up to the next special one, or
+		// until the output buffer is full
+		const int run = static_cast <int>(bufferScanner::copyUntil
+			(buffer + bufferPos, std::min(bufferLength - bufferPos,
+				static_cast <int>(sizeof(outBuffer)) - outBufferPos), '=', rfc2047 ? '_' : '=',
+			 reinterpret_cast <char*>(outBuffer + outBufferPos)));
+
+		if (run != 0)
+		{
+			bufferPos += run;
+			outBufferPos += run;
+			inTotal += run;
+
+			if (progress)
+				progress->progress(static_cast <int>(inTotal), static_cast <int>(inTotal));
+
+			continue;
+		}
+
 		// Decode the next sequence (hex-encoded byte or printable character)
 		unsigned char c = static_cast <unsigned char>(buffer[bufferPos++]);
 
@@ -506,6 +528,7 @@ utility::stream::size_type qpEncoder::decode(utility::inputStream& in,
 
 			// no break here...
 		}
+		// fall through
 		default:
 		{
 			outBuffer[outBufferPos++] = c;
@@ -531,6 +554,107 @@ utility::stream::size_type qpEncoder::decode(utility::inputStream& in,
 }
 
 
+// static
+void qpEncoder::decodeBuffer(const char* data, const string::size_type length,
+	string& out, const bool rfc2047)
+{
+	// Decoded data is never longer than encoded data
+	const string::size_type outStart = out.length();
+	out.resize(outStart + length);
+
+	unsigned char* output = reinterpret_cast <unsigned char*>(&out[outStart]);
+	string::size_type outLength = 0;
+
+	string::size_type pos = 0;
+
+	while (pos < length)
+	{
+		// Copy literal characters up to the next special one
+		// (there is always room in the output for the remaining input)
+		const string::size_type run = bufferScanner::copyUntil
+			(data + pos, length - pos, '=', rfc2047 ? '_' : '=',
+			 reinterpret_cast <char*>(output + outLength));
+
+		pos += run;
+		outLength += run;
+
+		if (pos >= length)
+			break;
+
+		// Decode the next sequence (hex-encoded byte or printable character)
+		unsigned char c = static_cast <unsigned char>(data[pos++]);
+
+		switch (c)
+		{
+		case '=':
+		{
+			if (pos < length)
+			{
+				c = static_cast <unsigned char>(data[pos++]);
+
+				switch (c)
+				{
+				// Ignore soft line break ("=\r\n" or "=\n")
+				case '\r':
+
+					if (pos < length)
+						++pos;
+
+					break;
+
+				case '\n':
+
+					break;
+
+				// Hex-encoded char
+				default:
+
+					if (pos < length)
+					{
+						const unsigned char next = static_cast <unsigned char>(data[pos++]);
+
+						output[outLength++] = static_cast <unsigned char>
+							(sm_hexDecodeTable[c] * 16 + sm_hexDecodeTable[next]);
+					}
+					else
+					{
+						// Premature end-of-data
+					}
+
+					break;
+				}
+			}
+			else
+			{
+				// Premature end-of-data
+			}
+
+			break;
+		}
+		case '_':
+		{
+			if (rfc2047)
+			{
+				// RFC-2047, Page 5, 4.2. The "Q" encoding
+				output[outLength++] = 0x20;
+				break;
+			}
+
+			// no break here...
+		}
+		// fall through
+		default:
+		{
+			output[outLength++] = c;
+		}
+
+		}
+	}
+
+	out.resize(outStart + outLength);
+}
+
+
 } // encoder
 } // utility
 } // vmime
@@ -187,6 +187,190 @@ void dotFilteredOutputStream::flush()
 }
 
 
+// dotUnstuffingFilteredOutputStream
+
+dotUnstuffingFilteredOutputStream::dotUnstuffingFilteredOutputStream(outputStream& os)
+	: m_stream(os), m_state(STATE_LINE_START)
+{
+}
+
+
+outputStream& dotUnstuffingFilteredOutputStream::getNextOutputStream()
+{
+	return (m_stream);
+}
+
+
+void dotUnstuffingFilteredOutputStream::write
+	(const value_type* const data, const size_type count)
+{
+	if (count == 0 || m_state == STATE_TERMINATED)
+		return;
+
+	const value_type* pos = data;
+	const value_type* end = data + count;
+	const value_type* start = data;   // first byte not written yet
+
+	// Beginning of the sequence which may be part of the terminator,
+	// or NULL if it begins with the bytes held from the previous call
+	const value_type* seq = NULL;
+
+	while (pos < end && m_state != STATE_TERMINATED)
+	{
+		switch (m_state)
+		{
+		case STATE_LINE:
+		{
+			const value_type* eol = std::find(pos, end, '\n');
+
+			if (eol == end)
+			{
+				if (*(end - 1) == '\r')
+				{
+					seq = end - 1;
+					m_state = STATE_CR;
+				}
+
+				pos = end;
+			}
+			else
+			{
+				seq = (eol > pos && *(eol - 1) == '\r') ? eol - 1 : eol;
+				m_state = STATE_LINE_START;
+
+				pos = eol + 1;
+			}
+
+			break;
+		}
+		case STATE_CR:
+
+			if (*pos == '\n')
+			{
+				m_state = STATE_LINE_START;
+				++pos;
+			}
+			else
+			{
+				m_state = STATE_LINE;
+			}
+
+			break;
+
+		case STATE_LINE_START:
+
+			if (*pos == '.')
+			{
+				m_state = STATE_DOT;
+				++pos;
+			}
+			else
+			{
+				m_state = STATE_LINE;
+			}
+
+			break;
+
+		case STATE_DOT:
+
+			if (*pos == '.')
+			{
+				// "..": skip the first dot
+				if (pos > data)
+				{
+					if (!m_held.empty())
+					{
+						m_stream.write(m_held.data(), m_held.length());
+						m_held.clear();
+					}
+
+					m_stream.write(start, pos - 1 - start);
+				}
+				else
+				{
+					m_stream.write(m_held.data(), m_held.length() - 1);
+					m_held.clear();
+				}
+
+				start = pos;
+				m_state = STATE_LINE;
+
+				++pos;
+			}
+			else if (*pos == '\r')
+			{
+				m_state = STATE_DOT_CR;
+				++pos;
+			}
+			else if (*pos == '\n')
+			{
+				m_state = STATE_TERMINATED;
+			}
+			else
+			{
+				m_state = STATE_LINE;
+			}
+
+			break;
+
+		case STATE_DOT_CR:
+
+			if (*pos == '\n')
+				m_state = STATE_TERMINATED;
+			else
+				m_state = STATE_LINE;
+
+			break;
+
+		case STATE_TERMINATED:
+
+			break;
+		}
+
+		// Held bytes turned out to be part of the data
+		if (m_state == STATE_LINE && !m_held.empty())
+		{
+			m_stream.write(m_held.data(), m_held.length());
+			m_held.clear();
+		}
+	}
+
+	if (m_state == STATE_TERMINATED)
+	{
+		// Do not write the terminator
+		if (seq != NULL)
+			m_stream.write(start, seq - start);
+
+		m_held.clear();
+	}
+	else if (m_state == STATE_LINE)
+	{
+		m_stream.write(start, end - start);
+	}
+	else if (seq != NULL)
+	{
+		m_stream.write(start, seq - start);
+		m_held.assign(seq, end);
+	}
+	else
+	{
+		m_held.append(start, end);
+	}
+}
+
+
+void dotUnstuffingFilteredOutputStream::flush()
+{
+	m_stream.flush();
+}
+
+
+bool dotUnstuffingFilteredOutputStream::isTerminated() const
+{
+	return (m_state == STATE_TERMINATED);
+}
+
+
 // CRLFToLFFilteredOutputStream
 
 CRLFToLFFilteredOutputStream::CRLFToLFFilteredOutputStream(outputStream& os)
@@ -23,12 +23,27 @@
 
 #include "vmime/object.hpp"
 #include "vmime/utility/smartPtr.hpp"
+#include "vmime/utility/arena.hpp"
 
 
 namespace vmime {
 namespace utility {
 
 
+// static
+void* refManager::operator new(std::size_t size)
+{
+	return arena::allocate(size);
+}
+
+
+// static
+void refManager::operator delete(void* ptr)
+{
+	arena::deallocate(ptr);
+}
+
+
 void refManager::deleteObjectImpl(object* obj)
 {
 	obj->setRefManager(0);
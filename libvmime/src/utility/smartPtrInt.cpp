@@ -38,7 +38,11 @@ namespace utility {
 // static
 refManager* refManager::create(object* obj)
 {
+#if VMIME_INTRUSIVE_REFCOUNT
+	return new weakRefManagerImpl(obj);
+#else
 	return new refManagerImpl(obj);
+#endif
 }
 
 
@@ -131,6 +135,141 @@ long refManagerImpl::getWeakRefCount() const
 
 
 
+#if VMIME_INTRUSIVE_REFCOUNT
+
+
+//
+// weakRefManagerImpl
+//
+
+weakRefManagerImpl::weakRefManagerImpl(object* obj)
+	: m_object(obj), m_weakCount(1)  // the object holds one weak reference
+{
+}
+
+
+weakRefManagerImpl::~weakRefManagerImpl()
+{
+}
+
+
+// static
+refManager* weakRefManagerImpl::getOrCreate(object* obj, refManager* volatile* mgr)
+{
+	refManager* current = *mgr;
+
+	if (current)
+		return current;
+
+	refManager* newMgr = new weakRefManagerImpl(obj);
+
+	// Another thread may be creating a manager for the same object
+#if defined(_WIN32)
+	current = static_cast <refManager*>
+		(InterlockedCompareExchangePointer
+			(reinterpret_cast <void* volatile*>(mgr), newMgr, 0));
+#elif defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1))
+	current = __sync_val_compare_and_swap(mgr, static_cast <refManager*>(0), newMgr);
+#elif defined(VMIME_HAVE_PTHREAD)
+	static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+	pthread_mutex_lock(&mutex);
+
+	current = *mgr;
+
+	if (!current)
+		*mgr = newMgr;
+
+	pthread_mutex_unlock(&mutex);
+#else // not thread-safe implementation
+	current = *mgr;
+
+	if (!current)
+		*mgr = newMgr;
+#endif
+
+	if (current)
+	{
+		delete newMgr;
+		return current;
+	}
+
+	return newMgr;
+}
+
+
+void weakRefManagerImpl::detachObject()
+{
+	m_object = 0;
+	releaseWeak();
+}
+
+
+bool weakRefManagerImpl::addStrong()
+{
+	object* obj = m_object;
+
+	if (!obj || obj->m_strongCount <= 0)
+		return false;
+
+	obj->addStrongRef();
+
+	return true;
+}
+
+
+void weakRefManagerImpl::releaseStrong()
+{
+	object* obj = m_object;
+
+	if (obj)
+		obj->releaseStrongRef();
+}
+
+
+void weakRefManagerImpl::addWeak()
+{
+	m_weakCount.increment();
+}
+
+
+void weakRefManagerImpl::releaseWeak()
+{
+	if (m_weakCount.decrement() <= 0)
+		delete this;
+}
+
+
+object* weakRefManagerImpl::getObject()
+{
+	return m_object;
+}
+
+
+long weakRefManagerImpl::getStrongRefCount() const
+{
+	const object* obj = m_object;
+	return (obj ? static_cast <long>(obj->m_strongCount) : 0);
+}
+
+
+long weakRefManagerImpl::getWeakRefCount() const
+{
+	const object* obj = m_object;
+
+	// Same semantics as refManagerImpl: each strong reference
+	// also counts as a weak reference
+	if (obj)
+		return m_weakCount - 1 + obj->m_strongCount;
+	else
+		return m_weakCount;
+}
+
+
+#endif // VMIME_INTRUSIVE_REFCOUNT
+
+
+
 //
 // refCounter
 //
@@ -0,0 +1 @@
+utility/arena.cpp
\ No newline at end of file
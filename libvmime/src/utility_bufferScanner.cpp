@@ -0,0 +1 @@
+utility/bufferScanner.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+utility/cpuFeatures.cpp
\ No newline at end of file
@@ -267,32 +267,32 @@ void word::parse(const string& buffer, const string::size_type position,
 					const string::const_iterator dataEnd = p;
 					p += 2; // skip '?='
 
-					utility::encoder::encoder* theEncoder = NULL;
+					const char* const encodedData = buffer.data() + (dataPos - buffer.begin());
+					const string::size_type encodedLength = static_cast <string::size_type>(dataEnd - dataPos);
+
+					bool decoded = true;
+
+					m_buffer.clear();
 
 					// Base-64 encoding
 					if (*encPos == 'B' || *encPos == 'b')
 					{
-						theEncoder = new utility::encoder::b64Encoder();
+						utility::encoder::b64Encoder::decodeBuffer
+							(encodedData, encodedLength, m_buffer);
 					}
 					// Quoted-Printable encoding
 					else if (*encPos == 'Q' || *encPos == 'q')
 					{
-						theEncoder = new utility::encoder::qpEncoder();
-						theEncoder->getProperties()["rfc2047"] = true;
+						utility::encoder::qpEncoder::decodeBuffer
+							(encodedData, encodedLength, m_buffer, true);
 					}
-
-					if (theEncoder)
+					else
 					{
-						// Decode text
-						string decodedBuffer;
-
-						utility::inputStreamStringAdapter ein(string(dataPos, dataEnd));
-						utility::outputStreamStringAdapter eout(decodedBuffer);
-
-						theEncoder->decode(ein, eout);
-						delete (theEncoder);
+						decoded = false;
+					}
 
-						m_buffer = decodedBuffer;
+					if (decoded)
+					{
 						m_charset = charset(string(charsetPos, charsetEnd));
 
 						setParsedBounds(position, p - buffer.begin());
@@ -0,0 +1,584 @@
+//
+// VMime library (http://www.vmime.org)
+// Copyright (C) 2002-2009 Vincent Richard <vincent@vincent-richard.net>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// Linking this library statically or dynamically with other modules is making
+// a combined work based on this library.  Thus, the terms and conditions of
+// the GNU General Public License cover the whole combination.
+//
+
+#include "tests/testUtils.hpp"
+
+#include "vmime/net/imap/IMAPConnection.hpp"
+#include "vmime/net/imap/IMAPFolder.hpp"
+
+#include <algorithm>
+
+
+#define VMIME_TEST_SUITE         IMAPFolderTest
+#define VMIME_TEST_SUITE_MODULE  "Net/IMAP"
+
+
+/** IMAP test server.
+  *
+  * Pre-authenticated connection to a mailbox holding 3 messages; the
+  * size of message N is N * 1000 bytes, and messages 1 and 2 are seen.
+  * Message 1 is a single text part; messages 2 and 3 have a text part
+  * and an attachment. Other folders hold as many messages as there are
+  * characters in their name, one of them unseen; copying to "Missing"
+  * fails. When 'reorderStatus' is set, the untagged STATUS data of
+  * pipelined commands is sent in the reverse order of the commands.
+  */
+class mailboxIMAPTestSocket : public lineBasedTestSocket
+{
+public:
+
+	static const int MESSAGE_COUNT = 3;
+
+	// Maximum number of commands received before the client read
+	// the responses
+	static int maxPipelined;
+
+	static bool reorderStatus;
+
+
+	mailboxIMAPTestSocket()
+		: m_pipelined(0), m_messageCount(MESSAGE_COUNT)
+	{
+	}
+
+	int receiveRaw(char* buffer, const int count)
+	{
+		m_pipelined = 0;
+
+		// Send the responses held back for pipelined STATUS commands
+		for (std::vector <vmime::string>::reverse_iterator it = m_heldStatus.rbegin() ;
+		     it != m_heldStatus.rend() ; ++it)
+		{
+			localSend(*it);
+		}
+
+		for (std::vector <vmime::string>::iterator it = m_heldDone.begin() ;
+		     it != m_heldDone.end() ; ++it)
+		{
+			localSend(*it);
+		}
+
+		m_heldStatus.clear();
+		m_heldDone.clear();
+
+		return testSocket::receiveRaw(buffer, count);
+	}
+
+
+	void onConnected()
+	{
+		localSend("* PREAUTH test.vmime.org IMAP4rev1 server ready\r\n");
+	}
+
+	void processCommand()
+	{
+		if (!haveMoreLines())
+			return;
+
+		std::istringstream iss(getNextLine());
+
+		vmime::string tag, command;
+		iss >> tag >> command;
+
+		command = vmime::utility::stringUtils::toUpper(command);
+
+		if (++m_pipelined > maxPipelined)
+			maxPipelined = m_pipelined;
+
+		if (command == "LIST")
+		{
+			localSend("* LIST () \"/\" \"\"\r\n");
+		}
+		else if (command == "SELECT" || command == "EXAMINE")
+		{
+			std::ostringstream oss;
+			oss << "* " << m_messageCount << " EXISTS\r\n";
+			oss << "* 0 RECENT\r\n";
+			oss << "* FLAGS (\\Seen \\Deleted)\r\n";
+			oss << "* OK [UIDVALIDITY 42] UIDs valid\r\n";
+
+			localSend(oss.str());
+		}
+		else if (command == "FETCH")
+		{
+			vmime::string set, items;
+			iss >> set;
+			std::getline(iss, items);
+
+			const std::vector <int> nums = parseSet(set);
+
+			for (std::vector <int>::const_iterator it = nums.begin() ; it != nums.end() ; ++it)
+			{
+				std::ostringstream oss;
+				oss << "* " << *it << " FETCH (UID " << *it;
+
+				if (items.find("RFC822.SIZE") != vmime::string::npos)
+					oss << " RFC822.SIZE " << (*it * 1000);
+
+				if (items.find(" FLAGS") != vmime::string::npos ||
+				    items.find("(FLAGS") != vmime::string::npos)
+				{
+					oss << " FLAGS (" << (*it <= 2 ? "\\Seen" : "") << ")";
+				}
+
+				if (items.find("BODYSTRUCTURE") != vmime::string::npos)
+				{
+					const vmime::string text =
+						"(\"TEXT\" \"PLAIN\" (\"CHARSET\" \"us-ascii\") NIL NIL \"7BIT\" 100 2)";
+
+					if (*it == 1)
+						oss << " BODYSTRUCTURE " << text;
+					else
+						oss << " BODYSTRUCTURE (" << text << "(\"APPLICATION\" \"OCTET-STREAM\" "
+						    << "NIL NIL NIL \"BASE64\" 200) \"MIXED\")";
+				}
+
+				// Body sections, with an optional range
+				for (vmime::string::size_type pos = items.find("BODY") ;
+				     pos != vmime::string::npos ; pos = items.find("BODY", pos + 1))
+				{
+					const vmime::string::size_type open = items.find('[', pos);
+
+					if (open != pos + 4 && open != pos + 9)  // "BODY[" or "BODY.PEEK["
+						continue;
+
+					const vmime::string::size_type close = items.find(']', open);
+					const vmime::string section = items.substr(open + 1, close - open - 1);
+
+					const vmime::string data = sectionData(*it, section);
+
+					vmime::string::size_type start = 0, length = data.length();
+
+					if (items[close + 1] == '<')
+					{
+						std::istringstream range(items.substr(close + 2));
+						char dot;
+						range >> start >> dot >> length;
+					}
+
+					const vmime::string part = data.substr
+						(std::min(start, data.length()), length);
+
+					oss << " BODY[" << section << "]";
+
+					if (items[close + 1] == '<')
+						oss << "<" << start << ">";
+
+					oss << " {" << part.length() << "}\r\n" << part;
+				}
+
+				oss << ")\r\n";
+
+				localSend(oss.str());
+			}
+		}
+		else if (command == "STATUS")
+		{
+			vmime::string name;
+			iss >> name;
+
+			if (name[0] == '"')
+				name = name.substr(1, name.length() - 2);
+
+			std::ostringstream oss;
+			oss << "* STATUS " << name << " (MESSAGES " << name.length() << " UNSEEN 1)\r\n";
+
+			if (reorderStatus)
+			{
+				m_heldStatus.push_back(oss.str());
+				m_heldDone.push_back(tag + " OK STATUS completed\r\n");
+				return;
+			}
+
+			localSend(oss.str());
+		}
+		else if (command == "STORE")
+		{
+			vmime::string set, item, flags;
+			iss >> set >> item >> flags;
+
+			if (flags == "(\\Deleted)")
+			{
+				const std::vector <int> nums = parseSet(set);
+				m_deleted.insert(m_deleted.end(), nums.begin(), nums.end());
+			}
+		}
+		else if (command == "COPY")
+		{
+			vmime::string set, name;
+			iss >> set >> name;
+
+			if (name == "Missing" || name == "\"Missing\"")
+			{
+				localSend(tag + " NO [TRYCREATE] no such mailbox\r\n");
+				return;
+			}
+		}
+		else if (command == "EXPUNGE")
+		{
+			std::sort(m_deleted.begin(), m_deleted.end());
+
+			for (std::vector <int>::reverse_iterator it = m_deleted.rbegin() ;
+			     it != m_deleted.rend() ; ++it)
+			{
+				std::ostringstream oss;
+				oss << "* " << *it << " EXPUNGE\r\n";
+
+				localSend(oss.str());
+			}
+
+			m_messageCount -= static_cast <int>(m_deleted.size());
+			m_deleted.clear();
+		}
+		else if (command == "LOGOUT")
+		{
+			localSend("* BYE test.vmime.org logging out\r\n");
+		}
+
+		localSend(tag + " OK " + command + " completed\r\n");
+	}
+
+private:
+
+	int m_pipelined;
+	int m_messageCount;
+	std::vector <int> m_deleted;
+	std::vector <vmime::string> m_heldStatus;
+	std::vector <vmime::string> m_heldDone;
+
+
+	static const vmime::string sectionData(const int num, const vmime::string& section)
+	{
+		std::ostringstream oss;
+		oss << "Section " << section << " of message " << num;
+
+		return oss.str();
+	}
+
+	static const std::vector <int> parseSet(const vmime::string& set)
+	{
+		std::vector <int> nums;
+		std::istringstream iss(set);
+		vmime::string range;
+
+		while (std::getline(iss, range, ','))
+		{
+			const vmime::string::size_type colon = range.find(':');
+
+			const int first = std::atoi(range.c_str());
+			int last = first;
+
+			if (colon != vmime::string::npos)
+			{
+				if (range[colon + 1] == '*')
+					last = MESSAGE_COUNT;
+				else
+					last = std::atoi(range.c_str() + colon + 1);
+			}
+
+			for (int n = first ; n <= last ; ++n)
+				nums.push_back(n);
+		}
+
+		return nums;
+	}
+};
+
+
+int mailboxIMAPTestSocket::maxPipelined = 0;
+bool mailboxIMAPTestSocket::reorderStatus = false;
+
+
+VMIME_TEST_SUITE_BEGIN
+
+	VMIME_TEST_LIST_BEGIN
+		VMIME_TEST(testFetchMessages)
+		VMIME_TEST(testFetchMessagesListener)
+		VMIME_TEST(testStatusBatch)
+		VMIME_TEST(testStatusBatchReordered)
+		VMIME_TEST(testMoveMessages)
+		VMIME_TEST(testExtractRange)
+		VMIME_TEST(testPrefetchTextParts)
+	VMIME_TEST_LIST_END
+
+
+	static vmime::ref <vmime::net::store> connectStore()
+	{
+		vmime::ref <vmime::net::session> session =
+			vmime::create <vmime::net::session>();
+
+		vmime::ref <vmime::net::store> store = session->getStore
+			(vmime::utility::url("imap://localhost"));
+
+		store->setSocketFactory(vmime::create <testSocketFactory <mailboxIMAPTestSocket> >());
+		store->setTimeoutHandlerFactory(vmime::create <testTimeoutHandlerFactory>());
+
+		store->connect();
+
+		return store;
+	}
+
+
+	class testFetchListener : public vmime::net::imap::IMAPFolder::fetchListener
+	{
+	public:
+
+		void messageFetched(vmime::ref <vmime::net::message> msg)
+		{
+			numbers.push_back(msg->getNumber());
+			sizes.push_back(msg->getSize());
+			flags.push_back(msg->getFlags());
+		}
+
+		std::vector <int> numbers;
+		std::vector <int> sizes;
+		std::vector <int> flags;
+	};
+
+
+	class testTextPartListener : public vmime::net::imap::IMAPFolder::textPartListener
+	{
+	public:
+
+		void textPartFetched(vmime::ref <vmime::net::message> msg,
+			vmime::ref <const vmime::net::part> p, const vmime::string& data)
+		{
+			types[msg->getNumber()] = p->getType().generate();
+			texts[msg->getNumber()] = data;
+		}
+
+		std::map <int, vmime::string> types;
+		std::map <int, vmime::string> texts;
+	};
+
+
+	void testFetchMessages()
+	{
+		vmime::ref <vmime::net::store> store = connectStore();
+
+		vmime::ref <vmime::net::folder> folder = store->getDefaultFolder();
+		folder->open(vmime::net::folder::MODE_READ_ONLY);
+
+		std::vector <vmime::ref <vmime::net::message> > msgs = folder->getMessages(2, 3);
+
+		folder->fetchMessages(msgs, vmime::net::folder::FETCH_SIZE | vmime::net::folder::FETCH_FLAGS);
+
+		VASSERT_EQ("Size 2", 2000, msgs[0]->getSize());
+		VASSERT_EQ("Size 3", 3000, msgs[1]->getSize());
+		VASSERT_EQ("Flags 2", static_cast <int>(vmime::net::message::FLAG_SEEN), msgs[0]->getFlags());
+		VASSERT_EQ("Flags 3", 0, msgs[1]->getFlags());
+	}
+
+	void testFetchMessagesListener()
+	{
+		vmime::ref <vmime::net::store> store = connectStore();
+
+		vmime::ref <vmime::net::imap::IMAPFolder> folder =
+			store->getDefaultFolder().dynamicCast <vmime::net::imap::IMAPFolder>();
+
+		folder->open(vmime::net::folder::MODE_READ_ONLY);
+
+		testFetchListener listener;
+		folder->fetchMessages(1, -1, vmime::net::folder::FETCH_SIZE | vmime::net::folder::FETCH_FLAGS, &listener);
+
+		VASSERT_EQ("Count", 3, static_cast <int>(listener.numbers.size()));
+
+		for (int i = 0 ; i < 3 ; ++i)
+		{
+			VASSERT_EQ("Number", i + 1, listener.numbers[i]);
+			VASSERT_EQ("Size", (i + 1) * 1000, listener.sizes[i]);
+		}
+
+		VASSERT_EQ("Flags", 0, listener.flags[2]);
+
+		VASSERT_THROW("Listener", folder->fetchMessages(1, -1, vmime::net::folder::FETCH_SIZE, NULL),
+			vmime::exceptions::invalid_argument);
+	}
+
+	void testStatusBatch()
+	{
+		vmime::ref <vmime::net::store> store = connectStore();
+
+		std::vector <vmime::ref <vmime::net::imap::IMAPFolder> > folders;
+
+		for (int i = 1 ; i <= 20 ; ++i)
+		{
+			folders.push_back(store->getFolder(vmime::net::folder::path
+				(vmime::string(i, 'f'))).dynamicCast <vmime::net::imap::IMAPFolder>());
+		}
+
+		mailboxIMAPTestSocket::maxPipelined = 0;
+
+		std::vector <int> count, unseen;
+		vmime::net::imap::IMAPFolder::status(folders, count, unseen);
+
+		VASSERT_EQ("Count", 20, static_cast <int>(count.size()));
+		VASSERT_EQ("Unseen", 20, static_cast <int>(unseen.size()));
+
+		for (int i = 0 ; i < 20 ; ++i)
+		{
+			VASSERT_EQ("Messages", i + 1, count[i]);
+			VASSERT_EQ("Unseen", 1, unseen[i]);
+		}
+
+		// Commands were sent before the previous responses were read
+		VASSERT_EQ("Pipelined", 16, mailboxIMAPTestSocket::maxPipelined);
+
+		// Folders must share their connection
+		vmime::ref <vmime::net::imap::IMAPFolder> inbox =
+			store->getDefaultFolder().dynamicCast <vmime::net::imap::IMAPFolder>();
+
+		inbox->open(vmime::net::folder::MODE_READ_ONLY);
+		folders.push_back(inbox);
+
+		VASSERT_THROW("Connection", vmime::net::imap::IMAPFolder::status(folders, count, unseen),
+			vmime::exceptions::invalid_argument);
+	}
+
+	void testStatusBatchReordered()
+	{
+		vmime::ref <vmime::net::store> store = connectStore();
+
+		std::vector <vmime::ref <vmime::net::imap::IMAPFolder> > folders;
+
+		for (int i = 1 ; i <= 5 ; ++i)
+		{
+			folders.push_back(store->getFolder(vmime::net::folder::path
+				(vmime::string(i, 'f'))).dynamicCast <vmime::net::imap::IMAPFolder>());
+		}
+
+		std::vector <int> count, unseen;
+
+		mailboxIMAPTestSocket::reorderStatus = true;
+
+		try
+		{
+			vmime::net::imap::IMAPFolder::status(folders, count, unseen);
+		}
+		catch (...)
+		{
+			mailboxIMAPTestSocket::reorderStatus = false;
+			throw;
+		}
+
+		mailboxIMAPTestSocket::reorderStatus = false;
+
+		VASSERT_EQ("Count", 5, static_cast <int>(count.size()));
+
+		// Data is matched by mailbox name, not by arrival order
+		for (int i = 0 ; i < 5 ; ++i)
+		{
+			VASSERT_EQ("Messages", i + 1, count[i]);
+			VASSERT_EQ("Unseen", 1, unseen[i]);
+		}
+	}
+
+	void testMoveMessages()
+	{
+		vmime::ref <vmime::net::store> store = connectStore();
+
+		vmime::ref <vmime::net::imap::IMAPFolder> folder =
+			store->getDefaultFolder().dynamicCast <vmime::net::imap::IMAPFolder>();
+
+		folder->open(vmime::net::folder::MODE_READ_WRITE);
+
+		vmime::ref <vmime::net::message> msg3 = folder->getMessage(3);
+
+		std::vector <int> nums;
+		nums.push_back(2);
+		nums.push_back(1);
+
+		folder->moveMessages(vmime::net::folder::path("Archive"), nums);
+
+		VASSERT_EQ("Count", 1, folder->getMessageCount());
+		VASSERT_EQ("Number", 1, msg3->getNumber());
+
+		// Nothing is expunged if the copy fails
+		std::vector <int> bad;
+		bad.push_back(1);
+
+		VASSERT_THROW("Copy", folder->moveMessages(vmime::net::folder::path("Missing"), bad),
+			vmime::exceptions::command_error);
+
+		VASSERT_EQ("Count after error", 1, folder->getMessageCount());
+	}
+
+	void testExtractRange()
+	{
+		vmime::ref <vmime::net::store> store = connectStore();
+
+		vmime::ref <vmime::net::folder> folder = store->getDefaultFolder();
+		folder->open(vmime::net::folder::MODE_READ_ONLY);
+
+		vmime::ref <vmime::net::message> msg = folder->getMessage(2);
+		folder->fetchMessage(msg, vmime::net::folder::FETCH_STRUCTURE);
+
+		std::ostringstream oss1;
+		vmime::utility::outputStreamAdapter os1(oss1);
+
+		msg->extract(os1, NULL, 8);
+
+		VASSERT_EQ("Open range", "TEXT of message 2", oss1.str());
+
+		std::ostringstream oss2;
+		vmime::utility::outputStreamAdapter os2(oss2);
+
+		msg->extractPart(msg->getStructure()->getPartAt(0)->getStructure()->getPartAt(1),
+			os2, NULL, 0, 9, true);
+
+		VASSERT_EQ("Part range", "Section 2", oss2.str());
+	}
+
+	void testPrefetchTextParts()
+	{
+		vmime::ref <vmime::net::store> store = connectStore();
+
+		vmime::ref <vmime::net::imap::IMAPFolder> folder =
+			store->getDefaultFolder().dynamicCast <vmime::net::imap::IMAPFolder>();
+
+		folder->open(vmime::net::folder::MODE_READ_ONLY);
+
+		std::vector <vmime::ref <vmime::net::message> > msgs = folder->getMessages();
+
+		mailboxIMAPTestSocket::maxPipelined = 0;
+
+		testTextPartListener listener;
+		folder->prefetchTextParts(msgs, vmime::net::folder::FETCH_SIZE, 12, &listener);
+
+		VASSERT_EQ("Count", 3, static_cast <int>(listener.texts.size()));
+
+		VASSERT_EQ("Text 1", "Section TEXT", listener.texts[1]);
+		VASSERT_EQ("Text 2", "Section 1 of", listener.texts[2]);
+		VASSERT_EQ("Text 3", "Section 1 of", listener.texts[3]);
+
+		VASSERT_EQ("Type 1", "text/plain", listener.types[1]);
+		VASSERT_EQ("Type 2", "text/plain", listener.types[2]);
+
+		VASSERT_EQ("Size", 2000, msgs[1]->getSize());
+
+		// Messages 2 and 3 have the same layout: one command for the
+		// structure, then two pipelined commands for the text parts
+		VASSERT_EQ("Pipelined", 2, mailboxIMAPTestSocket::maxPipelined);
+	}
+
+VMIME_TEST_SUITE_END
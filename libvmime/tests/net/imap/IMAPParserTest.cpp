@@ -0,0 +1,314 @@
+//
+// VMime library (http://www.vmime.org)
+// Copyright (C) 2002-2009 Vincent Richard <vincent@vincent-richard.net>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// Linking this library statically or dynamically with other modules is making
+// a combined work based on this library.  Thus, the terms and conditions of
+// the GNU General Public License cover the whole combination.
+//
+
+#include "tests/testUtils.hpp"
+
+#include "vmime/net/imap/IMAPTag.hpp"
+#include "vmime/net/imap/IMAPParser.hpp"
+
+
+#define VMIME_TEST_SUITE         IMAPParserTest
+#define VMIME_TEST_SUITE_MODULE  "Net/IMAP"
+
+
+/** Test socket which returns at most a few bytes at a time.
+  */
+class smallReadsTestSocket : public testSocket
+{
+public:
+
+	int receiveRaw(char* buffer, const int count)
+	{
+		return testSocket::receiveRaw(buffer, std::min(count, 7));
+	}
+};
+
+
+VMIME_TEST_SUITE_BEGIN
+
+	VMIME_TEST_LIST_BEGIN
+		VMIME_TEST(testResponse)
+		VMIME_TEST(testResponseHandler)
+		VMIME_TEST(testLongLine)
+		VMIME_TEST(testLiteral)
+		VMIME_TEST(testLiteralHandler)
+		VMIME_TEST(testSmallReads)
+		VMIME_TEST(testAcceptAnyTag)
+	VMIME_TEST_LIST_END
+
+
+	typedef vmime::net::imap::IMAPParser IMAPParser;
+
+
+	// Records the untagged responses, and the line the parser was on
+	class recordingResponseHandler : public IMAPParser::responseHandler
+	{
+	public:
+
+		recordingResponseHandler(vmime::ref <IMAPParser> parser)
+			: m_parser(parser)
+		{
+		}
+
+		void handleResponseData(const IMAPParser::response_data& resp)
+		{
+			if (resp.message_data())
+				numbers.push_back(static_cast <int>(resp.message_data()->number()));
+			else
+				numbers.push_back(0);
+
+			lines.push_back(m_parser->lastLine());
+		}
+
+		std::vector <int> numbers;
+		std::vector <vmime::string> lines;
+
+	private:
+
+		vmime::ref <IMAPParser> m_parser;
+	};
+
+
+	// Stores all the literals in the same string
+	class recordingLiteralHandler : public IMAPParser::literalHandler
+	{
+	public:
+
+		target* targetFor(const IMAPParser::component& /* comp */, const int /* data */)
+		{
+			return new targetString(NULL, data);
+		}
+
+		vmime::string data;
+	};
+
+
+	static vmime::ref <IMAPParser> createParser(vmime::ref <vmime::net::imap::IMAPTag> tag,
+		vmime::ref <testSocket> socket)
+	{
+		vmime::ref <vmime::net::timeoutHandler> toh =
+			vmime::create <testTimeoutHandler>();
+
+		return vmime::create <IMAPParser>
+			(tag, vmime::ref <vmime::net::socket>(socket), toh);
+	}
+
+	static const vmime::string itemValue(const IMAPParser::response& resp, const int n)
+	{
+		return resp.continue_req_or_response_data()[n]->response_data()->
+			message_data()->msg_att()->items()[0]->nstring()->value();
+	}
+
+	static const vmime::string fetchResponse(const vmime::net::imap::IMAPTag& tag)
+	{
+		return "* 1 FETCH (UID 10)\r\n"
+		       "* 2 FETCH (UID 20)\r\n"
+		       "* 3 EXISTS\r\n"
+		       + vmime::string(tag) + " OK FETCH completed\r\n";
+	}
+
+	void testResponse()
+	{
+		vmime::ref <vmime::net::imap::IMAPTag> tag =
+			vmime::create <vmime::net::imap::IMAPTag>();
+		vmime::ref <testSocket> socket = vmime::create <testSocket>();
+
+		vmime::ref <IMAPParser> parser = createParser(tag, socket);
+
+		++(*tag);
+		socket->localSend(fetchResponse(*tag));
+
+		vmime::utility::auto_ptr <IMAPParser::response> resp(parser->readResponse());
+
+		VASSERT("Bad", !resp->isBad());
+		VASSERT_EQ("Count", 3, static_cast <int>(resp->continue_req_or_response_data().size()));
+		VASSERT_EQ("Number", 2, static_cast <int>(resp->continue_req_or_response_data()[1]->
+			response_data()->message_data()->number()));
+	}
+
+	void testResponseHandler()
+	{
+		vmime::ref <vmime::net::imap::IMAPTag> tag =
+			vmime::create <vmime::net::imap::IMAPTag>();
+		vmime::ref <testSocket> socket = vmime::create <testSocket>();
+
+		vmime::ref <IMAPParser> parser = createParser(tag, socket);
+
+		++(*tag);
+		socket->localSend(fetchResponse(*tag));
+
+		recordingResponseHandler handler(parser);
+
+		vmime::utility::auto_ptr <IMAPParser::response> resp(parser->readResponse(NULL, &handler));
+
+		VASSERT("Bad", !resp->isBad());
+		VASSERT_EQ("Count", 0, static_cast <int>(resp->continue_req_or_response_data().size()));
+
+		VASSERT_EQ("Handled", 3, static_cast <int>(handler.numbers.size()));
+		VASSERT_EQ("Number 1", 1, handler.numbers[0]);
+		VASSERT_EQ("Number 2", 2, handler.numbers[1]);
+		VASSERT_EQ("Number 3", 0, handler.numbers[2]);
+
+		// Each response is handled as soon as its line has been parsed
+		VASSERT_EQ("Line 1", "* 1 FETCH (UID 10)", handler.lines[0]);
+		VASSERT_EQ("Line 2", "* 2 FETCH (UID 20)", handler.lines[1]);
+		VASSERT_EQ("Line 3", "* 3 EXISTS", handler.lines[2]);
+	}
+
+	void testLongLine()
+	{
+		vmime::ref <vmime::net::imap::IMAPTag> tag =
+			vmime::create <vmime::net::imap::IMAPTag>();
+		vmime::ref <testSocket> socket = vmime::create <testSocket>();
+
+		vmime::ref <IMAPParser> parser = createParser(tag, socket);
+
+		// Several times the size of a socket block
+		const vmime::string text(100000, 'x');
+
+		++(*tag);
+		socket->localSend("* 1 FETCH (RFC822.TEXT \"" + text + "\")\r\n"
+			"* 2 FETCH (RFC822.TEXT \"y\")\r\n"
+			+ vmime::string(*tag) + " OK FETCH completed\r\n");
+
+		vmime::utility::auto_ptr <IMAPParser::response> resp(parser->readResponse());
+
+		VASSERT("Bad", !resp->isBad());
+		VASSERT_EQ("Count", 2, static_cast <int>(resp->continue_req_or_response_data().size()));
+		VASSERT_EQ("Text 1", text, itemValue(*resp, 0));
+		VASSERT_EQ("Text 2", "y", itemValue(*resp, 1));
+	}
+
+	void testLiteral()
+	{
+		vmime::ref <vmime::net::imap::IMAPTag> tag =
+			vmime::create <vmime::net::imap::IMAPTag>();
+		vmime::ref <testSocket> socket = vmime::create <testSocket>();
+
+		vmime::ref <IMAPParser> parser = createParser(tag, socket);
+
+		// Most of the literal is not received with the line announcing it
+		vmime::string text;
+
+		for (int i = 0 ; i < 10000 ; ++i)
+			text += "0123456789\r\n"[i % 12];
+
+		++(*tag);
+
+		std::ostringstream oss;
+		oss << "* 1 FETCH (RFC822.TEXT {" << text.length() << "}\r\n" << text << " UID 10)\r\n";
+		oss << "* 2 FETCH (RFC822.TEXT {3}\r\nabc)\r\n";
+		oss << vmime::string(*tag) << " OK FETCH completed\r\n";
+
+		socket->localSend(oss.str());
+
+		vmime::utility::auto_ptr <IMAPParser::response> resp(parser->readResponse());
+
+		VASSERT("Bad", !resp->isBad());
+		VASSERT_EQ("Count", 2, static_cast <int>(resp->continue_req_or_response_data().size()));
+		VASSERT_EQ("Text 1", text, itemValue(*resp, 0));
+		VASSERT_EQ("Text 2", "abc", itemValue(*resp, 1));
+	}
+
+	void testLiteralHandler()
+	{
+		vmime::ref <vmime::net::imap::IMAPTag> tag =
+			vmime::create <vmime::net::imap::IMAPTag>();
+		vmime::ref <testSocket> socket = vmime::create <testSocket>();
+
+		vmime::ref <IMAPParser> parser = createParser(tag, socket);
+
+		const vmime::string text(50000, 'z');
+
+		++(*tag);
+
+		std::ostringstream oss;
+		oss << "* 1 FETCH (BODY[TEXT] {" << text.length() << "}\r\n" << text << ")\r\n";
+		oss << vmime::string(*tag) << " OK FETCH completed\r\n";
+
+		socket->localSend(oss.str());
+
+		recordingLiteralHandler handler;
+
+		vmime::utility::auto_ptr <IMAPParser::response> resp(parser->readResponse(&handler));
+
+		VASSERT("Bad", !resp->isBad());
+		VASSERT_EQ("Literal", text, handler.data);
+	}
+
+	void testSmallReads()
+	{
+		vmime::ref <vmime::net::imap::IMAPTag> tag =
+			vmime::create <vmime::net::imap::IMAPTag>();
+		vmime::ref <testSocket> socket = vmime::create <smallReadsTestSocket>();
+
+		vmime::ref <IMAPParser> parser = createParser(tag, socket);
+
+		++(*tag);
+
+		socket->localSend("* 1 FETCH (RFC822.TEXT {26}\r\nabcdefghijklm\r\nnopqrstuvwx UID 1)\r\n"
+			"* 2 FETCH (RFC822.TEXT \"quoted text\")\r\n"
+			"* 3 FETCH (RFC822.TEXT {0}\r\n)\r\n"
+			+ vmime::string(*tag) + " OK FETCH completed\r\n");
+
+		vmime::utility::auto_ptr <IMAPParser::response> resp(parser->readResponse());
+
+		VASSERT("Bad", !resp->isBad());
+		VASSERT_EQ("Count", 3, static_cast <int>(resp->continue_req_or_response_data().size()));
+		VASSERT_EQ("Text 1", "abcdefghijklm\r\nnopqrstuvwx", itemValue(*resp, 0));
+		VASSERT_EQ("Text 2", "quoted text", itemValue(*resp, 1));
+		VASSERT_EQ("Text 3", "", itemValue(*resp, 2));
+	}
+
+	void testAcceptAnyTag()
+	{
+		vmime::ref <vmime::net::imap::IMAPTag> tag =
+			vmime::create <vmime::net::imap::IMAPTag>();
+		vmime::ref <testSocket> socket = vmime::create <testSocket>();
+
+		vmime::ref <IMAPParser> parser = createParser(tag, socket);
+
+		// Two commands in flight, completed in reverse order
+		const vmime::string tag1 = ++(*tag);
+		const vmime::string tag2 = ++(*tag);
+
+		socket->localSend("* 1 EXPUNGE\r\n"
+			+ tag2 + " OK EXPUNGE completed\r\n"
+			+ tag1 + " NO STORE failed\r\n");
+
+		parser->setAcceptAnyTag(true);
+
+		vmime::utility::auto_ptr <IMAPParser::response> resp1(parser->readResponse());
+		vmime::utility::auto_ptr <IMAPParser::response> resp2(parser->readResponse());
+
+		VASSERT_EQ("Data 1", 1, static_cast <int>(resp1->continue_req_or_response_data().size()));
+		VASSERT_EQ("Tag 1", tag2, resp1->response_done()->response_tagged()->tag());
+		VASSERT_EQ("Status 1", IMAPParser::resp_cond_state::OK,
+			resp1->response_done()->response_tagged()->resp_cond_state()->status());
+
+		VASSERT_EQ("Tag 2", tag1, resp2->response_done()->response_tagged()->tag());
+		VASSERT_EQ("Status 2", IMAPParser::resp_cond_state::NO,
+			resp2->response_done()->response_tagged()->resp_cond_state()->status());
+	}
+
+VMIME_TEST_SUITE_END
@@ -0,0 +1,210 @@
+//
+// VMime library (http://www.vmime.org)
+// Copyright (C) 2002-2009 Vincent Richard <vincent@vincent-richard.net>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// Linking this library statically or dynamically with other modules is making
+// a combined work based on this library.  Thus, the terms and conditions of
+// the GNU General Public License cover the whole combination.
+//
+
+#include "tests/testUtils.hpp"
+
+#include "vmime/net/pop3/POP3Store.hpp"
+
+
+#define VMIME_TEST_SUITE         POP3MessageTest
+#define VMIME_TEST_SUITE_MODULE  "Net/POP3"
+
+
+class mailboxPOP3TestSocket;
+
+
+// Lines starting with dots, longer than the socket reads
+static const vmime::string largeMessage()
+{
+	std::ostringstream oss;
+	oss << "Subject: large\r\n\r\n";
+
+	for (int i = 0 ; i < 2000 ; ++i)
+		oss << vmime::string(i % 5, '.') << "line " << i << "\r\n";
+
+	oss << ".";
+
+	return oss.str();
+}
+
+
+VMIME_TEST_SUITE_BEGIN
+
+	VMIME_TEST_LIST_BEGIN
+		VMIME_TEST(testExtract)
+		VMIME_TEST(testExtractLarge)
+		VMIME_TEST(testFetchHeader)
+	VMIME_TEST_LIST_END
+
+
+	static vmime::ref <vmime::net::store> connectStore()
+	{
+		vmime::ref <vmime::net::session> session =
+			vmime::create <vmime::net::session>();
+
+		session->getProperties()["store.pop3.auth.username"] = "user";
+		session->getProperties()["store.pop3.auth.password"] = "pass";
+
+		vmime::ref <vmime::net::store> store = session->getStore
+			(vmime::utility::url("pop3://localhost"));
+
+		store->setSocketFactory(vmime::create <testSocketFactory <mailboxPOP3TestSocket> >());
+		store->setTimeoutHandlerFactory(vmime::create <testTimeoutHandlerFactory>());
+
+		store->connect();
+
+		return store;
+	}
+
+	static const vmime::string extract(vmime::ref <vmime::net::message> msg)
+	{
+		std::ostringstream oss;
+		vmime::utility::outputStreamAdapter os(oss);
+
+		msg->extract(os);
+
+		return oss.str();
+	}
+
+	void testExtract()
+	{
+		vmime::ref <vmime::net::store> store = connectStore();
+
+		vmime::ref <vmime::net::folder> folder = store->getDefaultFolder();
+		folder->open(vmime::net::folder::MODE_READ_ONLY);
+
+		VASSERT_EQ("Message", "Subject: test\r\n\r\n.line\r\n..\r\n.\r\nend",
+			extract(folder->getMessage(1)));
+	}
+
+	void testExtractLarge()
+	{
+		vmime::ref <vmime::net::store> store = connectStore();
+
+		vmime::ref <vmime::net::folder> folder = store->getDefaultFolder();
+		folder->open(vmime::net::folder::MODE_READ_ONLY);
+
+		VASSERT_EQ("Message", largeMessage(), extract(folder->getMessage(2)));
+	}
+
+	void testFetchHeader()
+	{
+		vmime::ref <vmime::net::store> store = connectStore();
+
+		vmime::ref <vmime::net::folder> folder = store->getDefaultFolder();
+		folder->open(vmime::net::folder::MODE_READ_ONLY);
+
+		vmime::ref <vmime::net::message> msg = folder->getMessage(1);
+		folder->fetchMessage(msg, vmime::net::folder::FETCH_FULL_HEADER);
+
+		VASSERT_EQ("Subject", "test", msg->getHeader()->Subject()->getValue()->generate());
+	}
+
+VMIME_TEST_SUITE_END
+
+
+/** POP3 test server.
+  *
+  * Accepts any credentials; the maildrop holds the two messages of
+  * the tests, which are sent in small chunks.
+  */
+class mailboxPOP3TestSocket : public lineBasedTestSocket
+{
+public:
+
+	void onConnected()
+	{
+		localSend("+OK test.vmime.org POP3 server ready\r\n");
+	}
+
+	int receiveRaw(char* buffer, const int count)
+	{
+		return testSocket::receiveRaw(buffer, std::min(count, 13));
+	}
+
+	void processCommand()
+	{
+		if (!haveMoreLines())
+			return;
+
+		std::istringstream iss(getNextLine());
+
+		vmime::string command;
+		int num = 0;
+		iss >> command >> num;
+
+		command = vmime::utility::stringUtils::toUpper(command);
+
+		if (command == "STAT")
+		{
+			localSend("+OK 2 2000\r\n");
+		}
+		else if (command == "RETR")
+		{
+			localSend("+OK message follows\r\n");
+			localSend(stuff(message(num)) + "\r\n.\r\n");
+		}
+		else if (command == "TOP")
+		{
+			const vmime::string msg = message(num);
+
+			localSend("+OK header follows\r\n");
+			localSend(stuff(msg.substr(0, msg.find("\r\n\r\n") + 2)) + "\r\n.\r\n");
+		}
+		else if (command == "CAPA")
+		{
+			localSend("-ERR not supported\r\n");
+		}
+		else
+		{
+			localSend("+OK\r\n");
+		}
+	}
+
+private:
+
+	static const vmime::string message(const int num)
+	{
+		if (num == 1)
+			return "Subject: test\r\n\r\n.line\r\n..\r\n.\r\nend";
+		else
+			return largeMessage();
+	}
+
+	// Add a dot before lines starting with a dot
+	static const vmime::string stuff(const vmime::string& data)
+	{
+		vmime::string result;
+
+		for (vmime::string::size_type i = 0 ; i < data.length() ; ++i)
+		{
+			if (data[i] == '.' && (i == 0 || data[i - 1] == '\n'))
+				result += '.';
+
+			result += data[i];
+		}
+
+		return result;
+	}
+};
+
@@ -34,6 +34,7 @@ VMIME_TEST_SUITE_BEGIN
 		VMIME_TEST(testParse)
 		VMIME_TEST(testGenerate)
 		VMIME_TEST(testParseMissingLastBoundary)
+		VMIME_TEST(testParseLazy)
 	VMIME_TEST_LIST_END
 
 
@@ -96,6 +97,39 @@ VMIME_TEST_SUITE_BEGIN
 		VASSERT_EQ("part2-body", "BODY2", extractContents(p.getBody()->getPartAt(1)->getBody()->getContents()));
 	}
 
+	void testParseLazy()
+	{
+		vmime::string str =
+			"Content-Type: multipart/mixed; boundary=\"MY-BOUNDARY\""
+			"\r\n\r\n"
+			"--MY-BOUNDARY\r\nHEADER1\r\n\r\nBODY1\r\n"
+			"--MY-BOUNDARY\r\nContent-Type: multipart/alternative; boundary=\"B2\"\r\n\r\n"
+			"--B2\r\nHEADER2\r\n\r\nBODY2\r\n"
+			"--B2--\r\n"
+			"--MY-BOUNDARY--\r\n";
+
+		vmime::ref <vmime::bodyPart> p = vmime::create <vmime::bodyPart>();
+		p->getBody()->setLazyParsing(true);
+		p->parse(str);
+
+		VASSERT_EQ("count", 2, p->getBody()->getPartCount());
+
+		vmime::ref <vmime::bodyPart> p2 = p->getBody()->getPartAt(1);
+
+		VASSERT_EQ("part2-count", 1, p2->getBody()->getPartCount());
+		VASSERT_EQ("part2-body", "BODY2", extractContents(p2->getBody()->getPartAt(0)->getBody()->getContents()));
+		VASSERT("part2-parent", p2->getParentPart() == p);
+		VASSERT("part2-lazy", p2->getBody()->isLazyParsing());
+
+		VASSERT_EQ("part1-body", "BODY1", extractContents(p->getBody()->getPartAt(0)->getBody()->getContents()));
+		VASSERT_EQ("part1-offset", str.find("HEADER1"), p->getBody()->getPartAt(0)->getParsedOffset());
+
+		p->getBody()->removePart(0);
+
+		VASSERT_EQ("remove-count", 1, p->getBody()->getPartCount());
+		VASSERT("remove-part", p->getBody()->getPartAt(0) == p2);
+	}
+
 	void testGenerate()
 	{
 		vmime::bodyPart p1;
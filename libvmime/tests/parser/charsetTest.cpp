@@ -104,6 +104,16 @@ VMIME_TEST_SUITE_BEGIN
 		// Test invalid input
 		VMIME_TEST(testFilterInvalid1)
 
+		// Test descriptor reuse
+		VMIME_TEST(testConvertStatefulReuse)
+		VMIME_TEST(testConvertCachedReuse)
+
+		// Test built-in conversions to UTF-8
+		VMIME_TEST(testConvertToUTF8SingleByte)
+		VMIME_TEST(testConvertToUTF8Valid)
+		VMIME_TEST(testConvertToUTF8Invalid)
+		VMIME_TEST(testFilterToUTF8Split)
+
 		// TODO: more tests
 	VMIME_TEST_LIST_END
 
@@ -227,6 +237,111 @@ VMIME_TEST_SUITE_BEGIN
 		VASSERT_EQ("1", toHex(expectedOut), toHex(actualOut));
 	}
 
+	void testConvertStatefulReuse()
+	{
+		// "\u65e5\u672c" (Japanese) in UTF-8
+		vmime::string in("\xe6\x97\xa5\xe6\x9c\xac");
+
+		vmime::string out1;
+		vmime::charset::convert(in, out1,
+			vmime::charset("utf-8"), vmime::charset("iso-2022-jp"));
+
+		// Output starts with an escape sequence; a reused descriptor
+		// must have been reset and write it again
+		vmime::string out2;
+		vmime::charset::convert(in, out2,
+			vmime::charset("utf-8"), vmime::charset("iso-2022-jp"));
+
+		VASSERT_EQ("1", "\x1b$B", out1.substr(0, 3));
+		VASSERT_EQ("2", toHex(out1), toHex(out2));
+	}
+
+	void testConvertCachedReuse()
+	{
+		vmime::string in("\xe6\x97\xa5\xe6\x9c\xac");
+
+		vmime::string out1, out2, out3;
+
+		{
+			vmime::charsetConverter::cache c;
+
+			{
+				vmime::charsetConverter::cache::scope s(c);
+
+				vmime::charset::convert(in, out1,
+					vmime::charset("utf-8"), vmime::charset("iso-2022-jp"));
+				vmime::charset::convert(in, out2,
+					vmime::charset("utf-8"), vmime::charset("iso-2022-jp"));
+			}
+
+			// Descriptors kept by the cache go back to the pool
+			// when it is destroyed
+		}
+
+		vmime::charset::convert(in, out3,
+			vmime::charset("utf-8"), vmime::charset("iso-2022-jp"));
+
+		VASSERT_EQ("1", "\x1b$B", out1.substr(0, 3));
+		VASSERT_EQ("2", toHex(out1), toHex(out2));
+		VASSERT_EQ("3", toHex(out1), toHex(out3));
+	}
+
+	static const vmime::string convertToUTF8(const vmime::string& in, const vmime::charset& source)
+	{
+		vmime::string out;
+		vmime::charset::convert(in, out, source, vmime::charset("utf-8"));
+
+		return out;
+	}
+
+	void testConvertToUTF8SingleByte()
+	{
+		VASSERT_EQ("1", "caf\xc3\xa9 \xc3\xbf", convertToUTF8("caf\xe9 \xff", vmime::charset("iso-8859-1")));
+		VASSERT_EQ("2", "caf\xc3\xa9 \xe2\x82\xac", convertToUTF8("caf\xe9 \x80", vmime::charset("windows-1252")));
+		VASSERT_EQ("3", "\xc5\xb8?", convertToUTF8("\x9f\x81", vmime::charset("CP1252")));
+		VASSERT_EQ("4", "caf? au lait", convertToUTF8("caf\xe9 au lait", vmime::charset("US-ASCII")));
+	}
+
+	void testConvertToUTF8Valid()
+	{
+		const vmime::string in("A\xc3\xa9\xe6\x97\xa5\xf0\x9f\x98\x80 \xf4\x8f\xbf\xbf");
+
+		VASSERT_EQ("1", toHex(in), toHex(convertToUTF8(in, vmime::charset("utf-8"))));
+		VASSERT_EQ("2", toHex(in), toHex(convertToUTF8(in, vmime::charset("UTF8"))));
+	}
+
+	void testConvertToUTF8Invalid()
+	{
+		const vmime::charset utf8("utf-8");
+
+		VASSERT_EQ("1", "?(", convertToUTF8("\xc3(", utf8));                 // bad continuation
+		VASSERT_EQ("2", "??", convertToUTF8("\xc0\x80", utf8));              // overlong
+		VASSERT_EQ("3", "???", convertToUTF8("\xed\xa0\x80", utf8));         // surrogate
+		VASSERT_EQ("4", "????", convertToUTF8("\xf4\x90\x80\x80", utf8));    // > U+10FFFF
+		VASSERT_EQ("5", "ab??", convertToUTF8("ab\xe6\x97", utf8));          // truncated
+	}
+
+	void testFilterToUTF8Split()
+	{
+		// Multi-byte sequences split between calls to write()
+		const vmime::string in("\xe6\x97\xa5\xe6\x9c\xac\xf0\x9f\x98\x80\xe6\x97");
+
+		for (unsigned int chunk = 1 ; chunk <= 4 ; ++chunk)
+		{
+			vmime::string out;
+			vmime::utility::outputStreamStringAdapter osa(out);
+			vmime::utility::charsetFilteredOutputStream os
+				(vmime::charset("utf-8"), vmime::charset("utf-8"), osa);
+
+			for (vmime::string::size_type i = 0 ; i < in.length() ; i += chunk)
+				os.write(in.data() + i, std::min(static_cast <vmime::string::size_type>(chunk), in.length() - i));
+
+			os.flush();
+
+			VASSERT_EQ("1", toHex(in.substr(0, 10) + "??"), toHex(out));
+		}
+	}
+
 
 	// Conversion to hexadecimal for easier debugging
 	static const vmime::string toHex(const vmime::string str)
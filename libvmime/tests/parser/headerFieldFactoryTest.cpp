@@ -0,0 +1,102 @@
+//
+// VMime library (http://www.vmime.org)
+// Copyright (C) 2002-2009 Vincent Richard <vincent@vincent-richard.net>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// Linking this library statically or dynamically with other modules is making
+// a combined work based on this library.  Thus, the terms and conditions of
+// the GNU General Public License cover the whole combination.
+//
+
+#include "tests/testUtils.hpp"
+
+#include "vmime/contentTypeField.hpp"
+#include "vmime/mailboxField.hpp"
+
+
+#define VMIME_TEST_SUITE         headerFieldFactoryTest
+#define VMIME_TEST_SUITE_MODULE  "Parser"
+
+
+VMIME_TEST_SUITE_BEGIN
+
+	VMIME_TEST_LIST_BEGIN
+		VMIME_TEST(testCreateStandard)
+		VMIME_TEST(testCreateCaseInsensitive)
+		VMIME_TEST(testCreateUnknown)
+		VMIME_TEST(testCreateValue)
+	VMIME_TEST_LIST_END
+
+
+	void testCreateStandard()
+	{
+		vmime::headerFieldFactory* hff = vmime::headerFieldFactory::getInstance();
+
+		vmime::ref <vmime::headerField> f1 = hff->create("Content-Type", "text/plain");
+
+		VASSERT("1.1", f1.dynamicCast <vmime::contentTypeField>() != NULL);
+		VASSERT("1.2", f1->getValue().dynamicCast <vmime::mediaType>() != NULL);
+		VASSERT_EQ("1.3", "Content-Type", f1->getName());
+
+		vmime::ref <vmime::headerField> f2 = hff->create("Received", "from a by b; Sun, 1 Jan 2006 00:00:00 +0000");
+
+		VASSERT("2.1", f2->getValue().dynamicCast <vmime::relay>() != NULL);
+	}
+
+	void testCreateCaseInsensitive()
+	{
+		vmime::headerFieldFactory* hff = vmime::headerFieldFactory::getInstance();
+
+		vmime::ref <vmime::headerField> f1 = hff->create("FROM", "a@b.c");
+
+		VASSERT("1.1", f1.dynamicCast <vmime::mailboxField>() != NULL);
+		VASSERT("1.2", f1->getValue().dynamicCast <vmime::mailbox>() != NULL);
+		VASSERT_EQ("1.3", "FROM", f1->getName());
+
+		vmime::ref <vmime::headerField> f2 = hff->create("message-id", "<a@b.c>");
+
+		VASSERT("2.1", f2->getValue().dynamicCast <vmime::messageId>() != NULL);
+		VASSERT_EQ("2.2", "message-id", f2->getName());
+	}
+
+	void testCreateUnknown()
+	{
+		vmime::headerFieldFactory* hff = vmime::headerFieldFactory::getInstance();
+
+		vmime::ref <vmime::headerField> f1 = hff->create("X-Unknown-Field", "value");
+
+		VASSERT("1.1", f1->getValue().dynamicCast <vmime::text>() != NULL);
+		VASSERT_EQ("1.2", "X-Unknown-Field", f1->getName());
+
+		// Same length and first letter as a standard field
+		vmime::ref <vmime::headerField> f2 = hff->create("Fron", "a@b.c");
+
+		VASSERT("2.1", f2.dynamicCast <vmime::mailboxField>() == NULL);
+		VASSERT("2.2", f2->getValue().dynamicCast <vmime::text>() != NULL);
+	}
+
+	void testCreateValue()
+	{
+		vmime::headerFieldFactory* hff = vmime::headerFieldFactory::getInstance();
+
+		VASSERT("1", hff->createValue("To").dynamicCast <vmime::addressList>() != NULL);
+		VASSERT("2", hff->createValue("DATE").dynamicCast <vmime::datetime>() != NULL);
+		VASSERT("3", hff->createValue("X-Mailer").dynamicCast <vmime::text>() != NULL);
+		VASSERT("4", hff->createValue("").dynamicCast <vmime::text>() != NULL);
+	}
+
+VMIME_TEST_SUITE_END
+
@@ -63,6 +63,16 @@ VMIME_TEST_SUITE_BEGIN
 		VMIME_TEST(testFindAllFields1)
 		VMIME_TEST(testFindAllFields2)
 		VMIME_TEST(testFindAllFields3)
+
+		VMIME_TEST(testParse1)
+		VMIME_TEST(testParse2)
+
+		VMIME_TEST(testFindAfterRename)
+		VMIME_TEST(testFieldInTwoHeaders)
+		VMIME_TEST(testFindAfterInsert)
+		VMIME_TEST(testFindAfterRemove)
+		VMIME_TEST(testFindCaseInsensitive)
+		VMIME_TEST(testFindNonLetters)
 	VMIME_TEST_LIST_END
 
 
@@ -357,5 +367,177 @@ VMIME_TEST_SUITE_BEGIN
 		VASSERT_EQ("Second value", "C: c2", headerTest::getFieldValue(*res[2]));
 	}
 
+	// parse function tests
+	void testParse1()
+	{
+		const vmime::string buffer =
+			"A: a1\r\nB: b1\r\n b2\r\nInvalid line\r\nC:c1\n\r\nBody";
+
+		vmime::header hdr;
+		vmime::string::size_type pos = 0;
+		hdr.parse(buffer, 0, buffer.length(), &pos);
+
+		VASSERT_EQ("Count", static_cast <unsigned int>(3), hdr.getFieldCount());
+		VASSERT_EQ("Position", buffer.find("Body"), pos);
+
+		VASSERT_EQ("A", "A: a1", headerTest::getFieldValue(*hdr.getFieldAt(0)));
+		VASSERT_EQ("C", "C: c1", headerTest::getFieldValue(*hdr.getFieldAt(2)));
+
+		// Folded field: bounds include the continuation line
+		VASSERT_EQ("B name", "B", hdr.getFieldAt(1)->getName());
+		VASSERT_EQ("B offset", buffer.find("B:"), hdr.getFieldAt(1)->getParsedOffset());
+		VASSERT_EQ("B length", buffer.find("Invalid") - buffer.find("B:"),
+			hdr.getFieldAt(1)->getParsedLength());
+	}
+
+	void testParse2()
+	{
+		// Long header block, with more data than the tokenizer
+		// scans at once
+		std::ostringstream oss;
+
+		for (unsigned int i = 0 ; i < 40 ; ++i)
+		{
+			oss << "Received: from host" << i << ".example.com (host" << i << ")\r\n"
+			    << "\tby mx.example.com with ESMTP id " << i << "\r\n";
+		}
+
+		oss << "Subject: last\r\n\r\nBody";
+
+		const vmime::string buffer = oss.str();
+
+		vmime::header hdr;
+		vmime::string::size_type pos = 0;
+		hdr.parse(buffer, 0, buffer.length(), &pos);
+
+		VASSERT_EQ("Count", static_cast <unsigned int>(41), hdr.getFieldCount());
+		VASSERT_EQ("Received", static_cast <unsigned int>(40), hdr.findAllFields("Received").size());
+		VASSERT_EQ("Subject", "Subject: last", headerTest::getFieldValue(*hdr.getFieldAt(40)));
+		VASSERT_EQ("Position", buffer.length() - 4, pos);
+	}
+
+	// index tests
+	void testFindAfterRename()
+	{
+		vmime::header hdr;
+		hdr.parse("A: a\r\nB: b\r\nC: c\r\n");
+
+		VASSERT_EQ("1", true, hdr.hasField("B"));
+
+		vmime::ref <vmime::headerField> f1 = hdr.getFieldAt(1);
+		f1->setName("D");
+
+		VASSERT_EQ("2", false, hdr.hasField("B"));
+		VASSERT_EQ("3", true, hdr.hasField("D"));
+
+		vmime::ref <vmime::headerField> f2 = hdr.getFieldAt(2);
+		f2->setName("A");
+
+		VASSERT_EQ("4", static_cast <unsigned int>(2), hdr.findAllFields("A").size());
+		VASSERT_EQ("5", false, hdr.hasField("C"));
+	}
+
+	void testFieldInTwoHeaders()
+	{
+		vmime::header hdr1;
+		hdr1.parse("A: a\r\nB: b\r\n");
+
+		vmime::ref <vmime::headerField> f = hdr1.getFieldAt(0);
+
+		// A field belongs to one header only
+		vmime::header hdr2;
+
+		VASSERT_THROW("1", hdr2.appendField(f), vmime::exceptions::invalid_argument);
+		VASSERT_THROW("2", hdr1.appendField(f), vmime::exceptions::invalid_argument);
+		VASSERT_EQ("3", 0, hdr2.getFieldCount());
+
+		hdr1.removeField(f);
+		hdr2.appendField(f);
+
+		f->setName("C");
+
+		VASSERT_EQ("4", true, hdr2.hasField("C"));
+		VASSERT_EQ("5", false, hdr1.hasField("C"));
+
+		// Copies do not share fields
+		vmime::header hdr3(hdr2);
+
+		f->setName("D");
+
+		VASSERT_EQ("6", true, hdr2.hasField("D"));
+		VASSERT_EQ("7", true, hdr3.hasField("C"));
+		VASSERT_EQ("8", false, hdr3.hasField("D"));
+	}
+
+	void testFindAfterInsert()
+	{
+		vmime::header hdr;
+		hdr.parse("A: a1\r\nB: b\r\n");
+
+		VASSERT_EQ("1", "A: a1", headerTest::getFieldValue(*hdr.findField("A")));
+
+		vmime::ref <vmime::headerField> fa = vmime::headerFieldFactory::getInstance()->create("A", "a0");
+		hdr.insertFieldBefore(0, fa);
+
+		VASSERT_EQ("2", "A: a0", headerTest::getFieldValue(*hdr.findField("A")));
+
+		// Append enough fields for the index to be resized
+		for (unsigned int i = 0 ; i < 20 ; ++i)
+			hdr.appendField(vmime::headerFieldFactory::getInstance()->create("A", "an"));
+
+		std::vector <vmime::ref <vmime::headerField> > res = hdr.findAllFields("A");
+
+		VASSERT_EQ("3", static_cast <unsigned int>(22), res.size());
+		VASSERT_EQ("4", "A: a0", headerTest::getFieldValue(*res[0]));
+		VASSERT_EQ("5", "A: a1", headerTest::getFieldValue(*res[1]));
+		VASSERT_EQ("6", "A: an", headerTest::getFieldValue(*res[21]));
+		VASSERT_EQ("7", true, hdr.hasField("B"));
+	}
+
+	void testFindAfterRemove()
+	{
+		vmime::header hdr;
+		hdr.parse("A: a1\r\nB: b\r\nA: a2\r\n");
+
+		VASSERT_EQ("1", "A: a1", headerTest::getFieldValue(*hdr.findField("A")));
+
+		hdr.removeField(0);
+
+		VASSERT_EQ("2", "A: a2", headerTest::getFieldValue(*hdr.findField("A")));
+
+		hdr.removeAllFields("A");
+
+		VASSERT_EQ("3", false, hdr.hasField("A"));
+		VASSERT_EQ("4", true, hdr.hasField("B"));
+		VASSERT_THROW("5", hdr.findField("A"), vmime::exceptions::no_such_field);
+	}
+
+	void testFindCaseInsensitive()
+	{
+		vmime::header hdr;
+		hdr.parse("SUBJECT: s\r\nx-custom: c\r\n");
+
+		VASSERT_EQ("1", true, hdr.hasField("Subject"));
+		VASSERT_EQ("2", true, hdr.hasField("X-Custom"));
+		VASSERT_EQ("3", "x-custom: c", headerTest::getFieldValue(*hdr.findField("X-CUSTOM")));
+		VASSERT_EQ("4", false, hdr.hasField("X-Custo"));
+
+		// getField() must find the existing field
+		hdr.getField("subject");
+
+		VASSERT_EQ("5", 2, hdr.getFieldCount());
+	}
+
+	void testFindNonLetters()
+	{
+		vmime::header hdr;
+		hdr.parse("X-[a: 1\r\nX-{a: 2\r\nX-@b: 3\r\n");
+
+		// Only letters are case-insensitive
+		VASSERT_EQ("1", "X-{a: 2", headerTest::getFieldValue(*hdr.findField("X-{A")));
+		VASSERT_EQ("2", static_cast <unsigned int>(1), hdr.findAllFields("X-{a").size());
+		VASSERT_EQ("3", false, hdr.hasField("X-`b"));
+	}
+
 VMIME_TEST_SUITE_END
 
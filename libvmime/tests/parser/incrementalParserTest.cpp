@@ -0,0 +1,359 @@
+//
+// VMime library (http://www.vmime.org)
+// Copyright (C) 2002-2009 Vincent Richard <vincent@vincent-richard.net>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// Linking this library statically or dynamically with other modules is making
+// a combined work based on this library.  Thus, the terms and conditions of
+// the GNU General Public License cover the whole combination.
+//
+
+#include "tests/testUtils.hpp"
+
+
+#define VMIME_TEST_SUITE         incrementalParserTest
+#define VMIME_TEST_SUITE_MODULE  "Parser"
+
+
+VMIME_TEST_SUITE_BEGIN
+
+	VMIME_TEST_LIST_BEGIN
+		VMIME_TEST(testSinglePart)
+		VMIME_TEST(testMultipart)
+		VMIME_TEST(testNestedMultipart)
+		VMIME_TEST(testMissingLastBoundary)
+		VMIME_TEST(testHeaderBeforeBody)
+		VMIME_TEST(testLongLine)
+		VMIME_TEST(testGetMessage)
+		VMIME_TEST(testBody)
+		VMIME_TEST(testReleaseData)
+	VMIME_TEST_LIST_END
+
+
+	// Record the events as a string
+	class testListener : public vmime::incrementalParserListener
+	{
+	public:
+
+		testListener(const bool logBody = false)
+			: m_logBody(logBody), m_bodyDepth(0)
+		{
+		}
+
+		void onHeader(vmime::ref <const vmime::header> hdr, const int depth)
+		{
+			flushBody();
+
+			std::ostringstream oss;
+			oss << "H" << depth << "(";
+
+			for (int i = 0 ; i < hdr->getFieldCount() ; ++i)
+				oss << (i == 0 ? "" : ",") << hdr->getFieldAt(i)->getName();
+
+			oss << ")";
+			log += oss.str();
+		}
+
+		void onPartBegin(const int depth)
+		{
+			flushBody();
+
+			std::ostringstream oss;
+			oss << "B" << depth;
+			log += oss.str();
+		}
+
+		void onPartEnd(const int depth)
+		{
+			flushBody();
+
+			std::ostringstream oss;
+			oss << "E" << depth;
+			log += oss.str();
+		}
+
+		// Contents received in several calls are logged once
+		void onBody(const char* data, const vmime::string::size_type length, const int depth)
+		{
+			if (m_logBody)
+			{
+				m_body.append(data, length);
+				m_bodyDepth = depth;
+			}
+		}
+
+		void flushBody()
+		{
+			if (!m_body.empty())
+			{
+				std::ostringstream oss;
+				oss << "D" << m_bodyDepth << "[" << m_body << "]";
+				log += oss.str();
+
+				m_body.clear();
+			}
+		}
+
+		vmime::string log;
+
+	private:
+
+		bool m_logBody;
+		vmime::string m_body;
+		int m_bodyDepth;
+	};
+
+	// Feed the data by chunks of the specified size
+	static const vmime::string parse(const vmime::string& data, const vmime::string::size_type chunkSize,
+		const bool logBody, const bool keepData)
+	{
+		testListener listener(logBody);
+		vmime::incrementalParser parser(&listener, keepData);
+
+		for (vmime::string::size_type pos = 0 ; pos < data.length() ; pos += chunkSize)
+			parser.feed(data.data() + pos, std::min(chunkSize, data.length() - pos));
+
+		parser.finish();
+		listener.flushBody();
+
+		return listener.log;
+	}
+
+	// The events must not depend on how the data is split, nor on
+	// whether the data is kept
+	static void checkEvents(const vmime::string& data, const vmime::string& expected,
+		const bool logBody = false)
+	{
+		static const vmime::string::size_type chunkSizes[] = { 1, 2, 3, 7, 64, 100000 };
+
+		for (unsigned int i = 0 ; i < sizeof(chunkSizes) / sizeof(chunkSizes[0]) ; ++i)
+		{
+			for (int keepData = 0 ; keepData < 2 ; ++keepData)
+			{
+				std::ostringstream oss;
+				oss << "chunk size " << chunkSizes[i] << (keepData ? "" : ", data released");
+
+				VASSERT_EQ(oss.str(), expected, parse(data, chunkSizes[i], logBody, keepData != 0));
+			}
+		}
+	}
+
+
+	void testSinglePart()
+	{
+		checkEvents("From: a@b.c\r\nSubject: test\r\n\r\nbody\r\n--not-a-boundary\r\n", "H0(From,Subject)");
+
+		// No line break at the end of the header
+		checkEvents("From: a@b.c\r\nSubject: test", "H0(From,Subject)");
+	}
+
+	void testMultipart()
+	{
+		const vmime::string data =
+			"Subject: test\r\n"
+			"Content-Type: multipart/mixed; boundary=\"XYZ\"\r\n"
+			"\r\n"
+			"preamble\r\n"
+			"--XYZ\r\n"
+			"Content-Type: text/plain\r\n"
+			"\r\n"
+			"first part\r\n"
+			"--XYZX\r\n"
+			"--XYZ \r\n"
+			"\r\n"
+			"second part, empty header\r\n"
+			"--XYZ--\r\n"
+			"epilogue\r\n"
+			"--XYZ\r\n";
+
+		checkEvents(data, "H0(Subject,Content-Type)B1H1(Content-Type)E1B1H1()E1");
+	}
+
+	void testNestedMultipart()
+	{
+		const vmime::string data =
+			"Content-Type: multipart/mixed; boundary=outer\n"
+			"\n"
+			"--outer\n"
+			"Content-Type: multipart/alternative; boundary=inner\n"
+			"\n"
+			"--inner\n"
+			"Content-Type: text/plain\n"
+			"\n"
+			"text\n"
+			"--inner\n"
+			"Content-Type: text/html\n"
+			"\n"
+			"html\n"
+			"--outer\n"
+			"Content-Type: application/octet-stream\n"
+			"\n"
+			"data\n"
+			"--outer--\n";
+
+		// The inner entity has no last boundary: it ends with the outer part
+		checkEvents(data,
+			"H0(Content-Type)"
+			"B1H1(Content-Type)"
+			"B2H2(Content-Type)E2B2H2(Content-Type)E2"
+			"E1"
+			"B1H1(Content-Type)E1");
+	}
+
+	void testMissingLastBoundary()
+	{
+		const vmime::string data =
+			"Content-Type: multipart/mixed; boundary=XYZ\r\n"
+			"\r\n"
+			"--XYZ\r\n"
+			"Content-Type: text/plain\r\n"
+			"\r\n"
+			"truncated";
+
+		checkEvents(data, "H0(Content-Type)B1H1(Content-Type)E1");
+	}
+
+	void testHeaderBeforeBody()
+	{
+		testListener listener;
+		vmime::incrementalParser parser(&listener);
+
+		const vmime::string header = "From: a@b.c\r\nContent-Type: multipart/mixed; boundary=XYZ\r\n\r\n";
+		parser.feed(header.data(), header.length());
+
+		// The header is reported before any body data arrives
+		VASSERT_EQ("1", "H0(From,Content-Type)", listener.log);
+
+		const vmime::string part = "--XYZ\r\nSubject: part\r\n";
+		parser.feed(part.data(), part.length());
+
+		VASSERT_EQ("2", "H0(From,Content-Type)B1", listener.log);
+
+		parser.feed("\r\n", 2);
+
+		VASSERT_EQ("3", "H0(From,Content-Type)B1H1(Subject)", listener.log);
+	}
+
+	void testLongLine()
+	{
+		// A line received in many small chunks is not scanned again
+		// from its start each time (this would take quadratic time)
+		const vmime::string data =
+			"Subject: " + vmime::string(100000, 'x') + "\r\n"
+			"X-Other: y\r\n"
+			"\r\n"
+			"body\r\n";
+
+		checkEvents(data, "H0(Subject,X-Other)");
+	}
+
+	void testGetMessage()
+	{
+		const vmime::string data =
+			"Subject: test\r\n"
+			"Content-Type: multipart/mixed; boundary=XYZ\r\n"
+			"\r\n"
+			"--XYZ\r\n"
+			"\r\n"
+			"first\r\n"
+			"--XYZ\r\n"
+			"\r\n"
+			"second\r\n"
+			"--XYZ--\r\n";
+
+		testListener listener;
+		vmime::incrementalParser parser(&listener);
+
+		parser.feed(data.data(), 10);
+		parser.feed(data.data() + 10, data.length() - 10);
+		parser.finish();
+
+		VASSERT_EQ("1", data, parser.getBuffer());
+
+		vmime::ref <vmime::message> msg = parser.getMessage();
+
+		VASSERT_EQ("2", "test", msg->getHeader()->Subject()->getValue().dynamicCast <vmime::text>()->getWholeBuffer());
+		VASSERT_EQ("3", 2, msg->getBody()->getPartCount());
+	}
+
+	void testBody()
+	{
+		// Single part: all the data after the header
+		checkEvents("Subject: test\r\n\r\nline 1\r\n--line 2\r\n",
+			"H0(Subject)D0[line 1\r\n--line 2\r\n]", true);
+
+		const vmime::string data =
+			"Content-Type: multipart/mixed; boundary=XYZ\r\n"
+			"\r\n"
+			"preamble\r\n"
+			"--XYZ\r\n"
+			"Content-Type: text/plain\r\n"
+			"\r\n"
+			"first\r\n"
+			"\r\n"
+			"--XYZ\r\n"
+			"Content-Type: multipart/alternative; boundary=ABC\r\n"
+			"\r\n"
+			"--ABC\r\n"
+			"\r\n"
+			"inner\n"
+			"--ABC--\r\n"
+			"--XYZ--\r\n"
+			"epilogue\r\n";
+
+		// The line break before a boundary is not part of the contents,
+		// and the contents of multipart entities are not reported
+		checkEvents(data,
+			"H0(Content-Type)"
+			"B1H1(Content-Type)D1[first\r\n]E1"
+			"B1H1(Content-Type)B2H2()D2[inner]E2E1", true);
+
+		// Missing last boundary: the part goes to the end of the data
+		checkEvents("Content-Type: multipart/mixed; boundary=XYZ\r\n\r\n--XYZ\r\n\r\ntruncated\r\n",
+			"H0(Content-Type)B1H1()D1[truncated\r\n]E1", true);
+	}
+
+	void testReleaseData()
+	{
+		const vmime::string header =
+			"Subject: test\r\n"
+			"Content-Type: multipart/mixed; boundary=XYZ\r\n";
+
+		testListener listener(true);
+		vmime::incrementalParser parser(&listener, false);
+
+		// The header being received is kept
+		parser.feed(header.data(), header.length());
+
+		VASSERT_EQ("1", header, parser.getBuffer());
+
+		// Only the line being received is kept
+		const vmime::string data = "\r\n--XYZ\r\n\r\nfirst\r\nsec";
+		parser.feed(data.data(), data.length());
+
+		VASSERT_EQ("2", "sec", parser.getBuffer());
+
+		const vmime::string end = "ond\r\n--XYZ--\r\n";
+		parser.feed(end.data(), end.length());
+		parser.finish();
+
+		listener.flushBody();
+
+		VASSERT_EQ("3", "H0(Subject,Content-Type)B1H1()D1[first\r\nsecond]E1", listener.log);
+	}
+
+VMIME_TEST_SUITE_END
+
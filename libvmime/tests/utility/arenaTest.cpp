@@ -0,0 +1,211 @@
+//
+// VMime library (http://www.vmime.org)
+// Copyright (C) 2002-2009 Vincent Richard <vincent@vincent-richard.net>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// Linking this library statically or dynamically with other modules is making
+// a combined work based on this library.  Thus, the terms and conditions of
+// the GNU General Public License cover the whole combination.
+//
+
+#include "tests/testUtils.hpp"
+
+#include "vmime/utility/arena.hpp"
+
+
+#define VMIME_TEST_SUITE         arenaTest
+#define VMIME_TEST_SUITE_MODULE  "Utility"
+
+
+VMIME_TEST_SUITE_BEGIN
+
+	VMIME_TEST_LIST_BEGIN
+		VMIME_TEST(testScope)
+		VMIME_TEST(testNestedScope)
+		VMIME_TEST(testOutliveScope)
+		VMIME_TEST(testMessageParse)
+		VMIME_TEST(testCacheReuse)
+		VMIME_TEST(testCacheObjectsAlive)
+	VMIME_TEST_LIST_END
+
+
+	static bool isNear(const void* p1, const void* p2)
+	{
+		const char* c1 = static_cast <const char*>(p1);
+		const char* c2 = static_cast <const char*>(p2);
+
+		return (c1 < c2 ? c2 - c1 : c1 - c2) < 4096;
+	}
+
+	void testScope()
+	{
+		vmime::ref <vmime::mailbox> mb1;
+		vmime::ref <vmime::mailbox> mb2;
+
+		{
+			vmime::utility::arena::scope scope;
+
+			mb1 = vmime::create <vmime::mailbox>("a@b.c");
+			mb2 = vmime::create <vmime::mailbox>("d@e.f");
+		}
+
+		// Both objects come from the same region
+		VASSERT("1", isNear(mb1.get(), mb2.get()));
+
+		VASSERT_EQ("2", "a@b.c", mb1->getEmail());
+		VASSERT_EQ("3", "d@e.f", mb2->getEmail());
+	}
+
+	void testNestedScope()
+	{
+		vmime::utility::arena::scope scope1;
+
+		vmime::ref <vmime::mailbox> mb1 = vmime::create <vmime::mailbox>("a@b.c");
+
+		{
+			vmime::utility::arena::scope scope2;
+
+			vmime::ref <vmime::mailbox> mb2 = vmime::create <vmime::mailbox>("d@e.f");
+
+			VASSERT_EQ("1", "d@e.f", mb2->getEmail());
+		}
+
+		// Back to the first region
+		vmime::ref <vmime::mailbox> mb3 = vmime::create <vmime::mailbox>("g@h.i");
+
+		VASSERT("2", isNear(mb1.get(), mb3.get()));
+	}
+
+	void testOutliveScope()
+	{
+		vmime::weak_ref <vmime::mailbox> weak;
+		vmime::ref <vmime::mailbox> mb2;
+
+		{
+			vmime::utility::arena::scope scope;
+
+			vmime::ref <vmime::mailbox> mb1 = vmime::create <vmime::mailbox>("a@b.c");
+			mb2 = vmime::create <vmime::mailbox>("d@e.f");
+
+			weak = mb1;
+		}
+
+		// 'mb1' has been destroyed, but its manager is still alive
+		VASSERT("1", weak.acquire() == NULL);
+		VASSERT_EQ("2", "d@e.f", mb2->getEmail());
+
+		mb2 = NULL;
+	}
+
+	void testMessageParse()
+	{
+		const vmime::string buffer =
+			"From: a@b.c\r\nSubject: test\r\nContent-Type: multipart/mixed; boundary=\"XYZ\"\r\n\r\n"
+			"--XYZ\r\nContent-Type: text/plain\r\n\r\nFoo\r\n"
+			"--XYZ\r\nContent-Type: text/plain\r\n\r\nBar\r\n"
+			"--XYZ--\r\n";
+
+		bool& arenaAllocation = vmime::options::getInstance()->message.arenaAllocation();
+		const bool oldArenaAllocation = arenaAllocation;
+
+		vmime::ref <vmime::message> msg1 = vmime::create <vmime::message>();
+		msg1->parse(buffer);
+
+		arenaAllocation = true;
+
+		vmime::ref <vmime::message> msg2 = vmime::create <vmime::message>();
+		msg2->parse(buffer);
+
+		arenaAllocation = oldArenaAllocation;
+
+		VASSERT_EQ("1", msg1->generate(), msg2->generate());
+
+		// Objects still usable after the message has been destroyed
+		vmime::ref <vmime::bodyPart> part = msg2->getBody()->getPartAt(1);
+		msg2 = NULL;
+
+		VASSERT_EQ("2", "text/plain", part->getHeader()->ContentType()->getValue()->generate());
+	}
+
+	void testCacheReuse()
+	{
+		vmime::utility::arena::cache cache;
+		const void* p1;
+
+		{
+			vmime::utility::arena::scope scope(cache);
+			p1 = vmime::create <vmime::mailbox>("a@b.c").get();
+		}
+
+		// Everything has been destroyed: memory is reused
+		{
+			vmime::utility::arena::scope scope(cache);
+
+			vmime::ref <vmime::mailbox> mb = vmime::create <vmime::mailbox>("d@e.f");
+
+			VASSERT("1", mb.get() == p1);
+			VASSERT_EQ("2", "d@e.f", mb->getEmail());
+
+			// Fill more than one chunk
+			for (int i = 0 ; i < 1000 ; ++i)
+				vmime::create <vmime::mailbox>("g@h.i");
+		}
+
+		// Chunks are merged into one
+		vmime::utility::arena::scope scope(cache);
+
+		std::vector <vmime::ref <vmime::mailbox> > mbs;
+
+		for (int i = 0 ; i < 1000 ; ++i)
+			mbs.push_back(vmime::create <vmime::mailbox>("j@k.l"));
+
+		VASSERT_EQ("3", "j@k.l", mbs.back()->getEmail());
+	}
+
+	void testCacheObjectsAlive()
+	{
+		vmime::utility::arena::cache cache;
+		vmime::ref <vmime::mailbox> mb1;
+
+		{
+			vmime::utility::arena::scope scope(cache);
+			mb1 = vmime::create <vmime::mailbox>("a@b.c");
+		}
+
+		vmime::ref <vmime::mailbox> mb2;
+
+		{
+			vmime::utility::arena::scope scope(cache);
+			mb2 = vmime::create <vmime::mailbox>("d@e.f");
+		}
+
+		// 'mb1' is still alive: a new region has been used
+		VASSERT("1", mb1.get() != mb2.get());
+		VASSERT_EQ("2", "a@b.c", mb1->getEmail());
+		VASSERT_EQ("3", "d@e.f", mb2->getEmail());
+
+		mb1 = NULL;
+		mb2 = NULL;
+
+		// Both regions are released, the cache keeps the last one
+		vmime::utility::arena::scope scope(cache);
+
+		vmime::ref <vmime::mailbox> mb3 = vmime::create <vmime::mailbox>("g@h.i");
+		VASSERT_EQ("4", "g@h.i", mb3->getEmail());
+	}
+
+VMIME_TEST_SUITE_END
+
@@ -0,0 +1,197 @@
+//
+// VMime library (http://www.vmime.org)
+// Copyright (C) 2002-2009 Vincent Richard <vincent@vincent-richard.net>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// Linking this library statically or dynamically with other modules is making
+// a combined work based on this library.  Thus, the terms and conditions of
+// the GNU General Public License cover the whole combination.
+//
+
+#include "tests/testUtils.hpp"
+
+#include "vmime/utility/bufferScanner.hpp"
+
+
+#define VMIME_TEST_SUITE         bufferScannerTest
+#define VMIME_TEST_SUITE_MODULE  "Utility"
+
+
+VMIME_TEST_SUITE_BEGIN
+
+	VMIME_TEST_LIST_BEGIN
+		VMIME_TEST(testFindAll)
+		VMIME_TEST(testFindAllOverlapping)
+		VMIME_TEST(testFindAllRange)
+		VMIME_TEST(testFindAllShortNeedle)
+		VMIME_TEST(testFindAllLongBuffer)
+		VMIME_TEST(testFindNonASCII)
+		VMIME_TEST(testCopyUntil)
+	VMIME_TEST_LIST_END
+
+
+	typedef vmime::string::size_type size_type;
+
+
+	static const vmime::string findAll(const vmime::string& buffer, const vmime::string& needle,
+		const size_type start, const size_type end)
+	{
+		std::vector <size_type> positions;
+		vmime::utility::bufferScanner::findAll(buffer, needle, start, end, positions);
+
+		std::ostringstream oss;
+
+		for (unsigned int i = 0 ; i < positions.size() ; ++i)
+		{
+			if (i != 0) oss << ",";
+			oss << positions[i];
+		}
+
+		return oss.str();
+	}
+
+	static const vmime::string findAllNaive(const vmime::string& buffer, const vmime::string& needle,
+		const size_type start, const size_type end)
+	{
+		std::ostringstream oss;
+		bool first = true;
+
+		for (size_type pos = start ; pos + needle.length() <= end ; ++pos)
+		{
+			if (buffer.compare(pos, needle.length(), needle) == 0)
+			{
+				if (!first) oss << ",";
+				oss << pos;
+				first = false;
+			}
+		}
+
+		return oss.str();
+	}
+
+
+	void testFindAll()
+	{
+		const vmime::string buffer = "--abc\r\nfoo\r\n--abc\r\nbar\r\n--abc--\r\n";
+
+		VASSERT_EQ("1", "0,12,24", findAll(buffer, "--abc", 0, buffer.length()));
+		VASSERT_EQ("2", "", findAll(buffer, "--xyz", 0, buffer.length()));
+		VASSERT_EQ("3", "", findAll(buffer, "", 0, buffer.length()));
+		VASSERT_EQ("4", "", findAll("", "--abc", 0, 0));
+	}
+
+	void testFindAllOverlapping()
+	{
+		VASSERT_EQ("1", "0,1,2", findAll("aaaa", "aa", 0, 4));
+		VASSERT_EQ("2", "0,1,2", findAll("-----", "---", 0, 5));
+	}
+
+	void testFindAllRange()
+	{
+		const vmime::string buffer = "xx--abc--abc--abc";
+
+		VASSERT_EQ("1", "7,12", findAll(buffer, "--abc", 3, buffer.length()));
+		VASSERT_EQ("2", "2,7", findAll(buffer, "--abc", 0, 16));
+		VASSERT_EQ("3", "2,7,12", findAll(buffer, "--abc", 0, 1000));
+		VASSERT_EQ("4", "", findAll(buffer, "--abc", 20, 30));
+	}
+
+	void testFindAllShortNeedle()
+	{
+		VASSERT_EQ("1", "1,3", findAll("a-b-c", "-", 0, 5));
+		VASSERT_EQ("2", "0,3", findAll("abcab", "ab", 0, 5));
+	}
+
+	void testFindAllLongBuffer()
+	{
+		// Long enough to go through the vectorized code paths, with
+		// matches around the block boundaries and in the tail
+		vmime::string buffer;
+
+		for (unsigned int i = 0 ; i < 300 ; ++i)
+			buffer += static_cast <char>('a' + (i * 7) % 26);
+
+		const size_type insertPos[] = { 0, 14, 15, 16, 31, 32, 33, 63, 64, 100, 127, 128, 290 };
+
+		for (unsigned int i = 0 ; i < sizeof(insertPos) / sizeof(insertPos[0]) ; ++i)
+			buffer.replace(insertPos[i], 3, "-=_");
+
+		buffer.replace(buffer.length() - 10, 10, "-=_boundar");
+
+		const vmime::string needles[] = { "-", "-=", "-=_", "-=_boundar", "bcd", "zz" };
+
+		for (unsigned int i = 0 ; i < sizeof(needles) / sizeof(needles[0]) ; ++i)
+		{
+			for (size_type start = 0 ; start < 70 ; start += 13)
+			{
+				for (size_type end = buffer.length() ; end > buffer.length() - 40 ; end -= 7)
+				{
+					std::ostringstream oss;
+					oss << needles[i] << "/" << start << "/" << end;
+
+					VASSERT_EQ(oss.str(), findAllNaive(buffer, needles[i], start, end),
+						findAll(buffer, needles[i], start, end));
+				}
+			}
+		}
+	}
+
+	void testFindNonASCII()
+	{
+		VASSERT_EQ("1", static_cast <size_type>(0), vmime::utility::bufferScanner::findNonASCII("", 0));
+		VASSERT_EQ("2", static_cast <size_type>(3), vmime::utility::bufferScanner::findNonASCII("abc", 3));
+		VASSERT_EQ("3", static_cast <size_type>(1), vmime::utility::bufferScanner::findNonASCII("a\xe9", 2));
+
+		// Around the block boundaries of the vectorized versions
+		for (size_type pos = 0 ; pos < 100 ; ++pos)
+		{
+			vmime::string buffer(100, 'x');
+			buffer[pos] = '\x80';
+
+			VASSERT_EQ("4", pos, vmime::utility::bufferScanner::findNonASCII(buffer.data(), 100));
+			VASSERT_EQ("5", pos, vmime::utility::bufferScanner::findNonASCII(buffer.data(), pos));
+		}
+	}
+
+	void testCopyUntil()
+	{
+		char out[100];
+
+		VASSERT_EQ("1", static_cast <size_type>(0), vmime::utility::bufferScanner::copyUntil("", 0, '=', '_', out));
+		VASSERT_EQ("2", static_cast <size_type>(3), vmime::utility::bufferScanner::copyUntil("abc", 3, '=', '_', out));
+		VASSERT_EQ("3", vmime::string("abc"), vmime::string(out, 3));
+		VASSERT_EQ("4", static_cast <size_type>(1), vmime::utility::bufferScanner::copyUntil("a_b=", 4, '=', '_', out));
+		VASSERT_EQ("5", static_cast <size_type>(3), vmime::utility::bufferScanner::copyUntil("a_b=", 4, '=', '=', out));
+		VASSERT_EQ("6", vmime::string("a_b"), vmime::string(out, 3));
+
+		// Around the block boundaries of the vectorized versions
+		for (size_type pos = 0 ; pos < 100 ; ++pos)
+		{
+			vmime::string buffer;
+
+			for (size_type i = 0 ; i < 100 ; ++i)
+				buffer += static_cast <char>('a' + i % 26);
+
+			buffer[pos] = (pos % 2 ? '=' : '_');
+
+			VASSERT_EQ("7", pos, vmime::utility::bufferScanner::copyUntil(buffer.data(), 100, '=', '_', out));
+			VASSERT_EQ("8", buffer.substr(0, pos), vmime::string(out, pos));
+			VASSERT_EQ("9", pos, vmime::utility::bufferScanner::copyUntil(buffer.data(), pos, '=', '_', out));
+		}
+	}
+
+VMIME_TEST_SUITE_END
+
@@ -23,6 +23,9 @@
 
 #include "tests/testUtils.hpp"
 
+#include "vmime/utility/encoder/b64Encoder.hpp"
+#include "vmime/utility/encoder/qpEncoder.hpp"
+
 
 #define VMIME_TEST_SUITE         encoderTest
 #define VMIME_TEST_SUITE_MODULE  "Parser"
@@ -34,6 +37,9 @@ VMIME_TEST_SUITE_BEGIN
 		VMIME_TEST(testBase64)
 		VMIME_TEST(testQuotedPrintable)
 		VMIME_TEST(testQuotedPrintable_RFC2047)
+		VMIME_TEST(testDecodeBuffer)
+		VMIME_TEST(testBase64Buffer)
+		VMIME_TEST(testQuotedPrintableLong)
 	VMIME_TEST_LIST_END
 
 
@@ -319,6 +325,148 @@ VMIME_TEST_SUITE_BEGIN
 		VASSERT_EQ("especials.12", "=22", encode("quoted-printable", "\"", 10, encProps));
 	}
 
+	void testDecodeBuffer()
+	{
+		// Buffer decoding must give the same result as stream decoding
+		static const char* const inputs[] =
+		{
+			"", "QQ==", "QUI", "QUJD", "QU JD\r\nRA==", "QQ=x", "=QUJD", "Q", "!@#$",
+			"a=3Db", "soft=\r\nbreak", "soft=\nbreak", "=4", "=", "end=\r", "a_b=5F",
+			"=C3=A9=e9", "x=\r\n=\r\ny"
+		};
+
+		for (unsigned int i = 0 ; i < sizeof(inputs) / sizeof(inputs[0]) ; ++i)
+		{
+			const vmime::string in(inputs[i]);
+
+			std::ostringstream oss;
+			oss << "input " << i;
+
+			vmime::string b64Out;
+			vmime::utility::encoder::b64Encoder::decodeBuffer(in.data(), in.length(), b64Out);
+
+			VASSERT_EQ(oss.str() + " (b64)", decode("base64", in), b64Out);
+
+			vmime::string qpOut;
+			vmime::utility::encoder::qpEncoder::decodeBuffer(in.data(), in.length(), qpOut, false);
+
+			VASSERT_EQ(oss.str() + " (qp)", decode("quoted-printable", in), qpOut);
+
+			vmime::utility::encoder::qpEncoder qp;
+			qp.getProperties()["rfc2047"] = true;
+
+			vmime::utility::inputStreamStringAdapter vin(in);
+			vmime::string qpStreamOut;
+			vmime::utility::outputStreamStringAdapter vout(qpStreamOut);
+
+			qp.decode(vin, vout);
+
+			vmime::string qp2047Out("prefix");
+			vmime::utility::encoder::qpEncoder::decodeBuffer(in.data(), in.length(), qp2047Out, true);
+
+			VASSERT_EQ(oss.str() + " (qp, rfc2047)", "prefix" + qpStreamOut, qp2047Out);
+		}
+	}
+
+	void testBase64Buffer()
+	{
+		// Long inputs go through the vectorized code (if available)
+		static const unsigned int lengths[] = { 0, 1, 2, 3, 11, 12, 13, 24, 47, 48, 49, 57, 100, 255, 1000, 4099 };
+		static const int maxLineLengths[] = { 0, 1, 10, 20, 76, 100 };
+
+		unsigned int seed = 42;
+
+		for (unsigned int i = 0 ; i < sizeof(lengths) / sizeof(lengths[0]) ; ++i)
+		{
+			vmime::string data;
+
+			for (unsigned int j = 0 ; j < lengths[i] ; ++j)
+			{
+				seed = seed * 1103515245 + 12345;
+				data += static_cast <char>(seed >> 16);
+			}
+
+			for (unsigned int k = 0 ; k < sizeof(maxLineLengths) / sizeof(maxLineLengths[0]) ; ++k)
+			{
+				const int maxLineLength = maxLineLengths[k];
+
+				std::ostringstream oss;
+				oss << "length " << lengths[i] << ", maxlinelength " << maxLineLength;
+
+				vmime::string encoded;
+				vmime::utility::encoder::b64Encoder::encodeBuffer
+					(data.data(), data.length(), encoded, maxLineLength == 0 ? -1 : maxLineLength);
+
+				VASSERT_EQ(oss.str() + " (encoding)", encode("base64", data, maxLineLength), encoded);
+
+				vmime::string decoded;
+				vmime::utility::encoder::b64Encoder::decodeBuffer(encoded.data(), encoded.length(), decoded);
+
+				VASSERT(oss.str() + " (decoding)", data == decoded);
+				VASSERT(oss.str() + " (stream decoding)", data == decode("base64", encoded));
+			}
+
+			// Invalid characters and padding in the middle of the data
+			vmime::string encoded;
+			vmime::utility::encoder::b64Encoder::encodeBuffer(data.data(), data.length(), encoded);
+
+			for (vmime::string::size_type pos = 1 ; pos < encoded.length() ; pos += 37)
+			{
+				vmime::string modified(encoded);
+				modified[pos] = (pos % 2 ? '=' : '\x80');
+
+				std::ostringstream oss;
+				oss << "length " << lengths[i] << ", modified at " << pos;
+
+				vmime::string decoded;
+				vmime::utility::encoder::b64Encoder::decodeBuffer(modified.data(), modified.length(), decoded);
+
+				VASSERT_EQ(oss.str(), decode("base64", modified), decoded);
+			}
+		}
+	}
+
+	void testQuotedPrintableLong()
+	{
+		// Long literal runs go through the vectorized code (if available)
+		for (unsigned int i = 0 ; i < 100 ; ++i)
+		{
+			vmime::string encoded(i * 7, 'x');
+			vmime::string decoded(encoded);
+
+			encoded += "=3D" + vmime::string(i, 'y') + "_=\r\n" + vmime::string(100 - i, 'z') + "=\n=4";
+			decoded += "=" + vmime::string(i, 'y') + "_" + vmime::string(100 - i, 'z');
+
+			std::ostringstream oss;
+			oss << "test " << i;
+
+			vmime::string out;
+			vmime::utility::encoder::qpEncoder::decodeBuffer(encoded.data(), encoded.length(), out, false);
+
+			VASSERT_EQ(oss.str() + " (buffer)", decoded, out);
+			VASSERT_EQ(oss.str() + " (stream)", decoded, decode("quoted-printable", encoded));
+
+			vmime::string out2047;
+			vmime::utility::encoder::qpEncoder::decodeBuffer(encoded.data(), encoded.length(), out2047, true);
+
+			decoded[i * 7 + 1 + i] = ' ';
+
+			VASSERT_EQ(oss.str() + " (rfc2047)", decoded, out2047);
+		}
+
+		// Literal runs longer than the internal buffers
+		vmime::string big;
+
+		for (unsigned int i = 0 ; i < 5000 ; ++i)
+			big += "Lorem ipsum dolor sit amet, consectetur adipiscing elit=2E =C3=A9=\r\n";
+
+		vmime::string out;
+		vmime::utility::encoder::qpEncoder::decodeBuffer(big.data(), big.length(), out, false);
+
+		VASSERT_EQ("big", out, decode("quoted-printable", big));
+		VASSERT_EQ("big length", static_cast <vmime::string::size_type>(5000 * 59), out.length());
+	}
+
 	// TODO: UUEncode
 
 VMIME_TEST_SUITE_END
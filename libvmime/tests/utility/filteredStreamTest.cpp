@@ -36,6 +36,8 @@ VMIME_TEST_SUITE_BEGIN
 		VMIME_TEST(testDotFilteredInputStream)
 		VMIME_TEST(testDotFilteredOutputStream)
 		VMIME_TEST(testCRLFToLFFilteredOutputStream)
+		VMIME_TEST(testDotUnstuffingFilteredOutputStream)
+		VMIME_TEST(testDotUnstuffingFilteredOutputStreamSplit)
 		VMIME_TEST(testStopSequenceFilteredInputStream1)
 		VMIME_TEST(testStopSequenceFilteredInputStreamN_2)
 		VMIME_TEST(testStopSequenceFilteredInputStreamN_3)
@@ -178,6 +180,50 @@ VMIME_TEST_SUITE_BEGIN
 		testFilteredOutputStreamHelper<FILTER>("7", "foo\nba\nr", "foo\r", "\nba\r\nr");
 	}
 
+	void testDotUnstuffingFilteredOutputStream()
+	{
+		typedef vmime::utility::dotUnstuffingFilteredOutputStream FILTER;
+
+		testFilteredOutputStreamHelper<FILTER>("1", "foo\r\n.bar", "foo\r\n..bar\r\n.\r\n");
+		testFilteredOutputStreamHelper<FILTER>("2", "foo\r\n.bar", "foo\r\n.", ".bar\r\n.\r\n");
+		testFilteredOutputStreamHelper<FILTER>("3", "foo\r\n.bar", "foo\r", "\n", ".", ".bar\r\n.\r\n");
+		testFilteredOutputStreamHelper<FILTER>("4", "foo\n.bar", "foo\n..bar\n.\n");
+		testFilteredOutputStreamHelper<FILTER>("5", ".foo", "..foo\r\n.\r\n");
+		testFilteredOutputStreamHelper<FILTER>("6", "", ".\r\n");
+		testFilteredOutputStreamHelper<FILTER>("7", "foo\r\n", "foo\r\n\r\n.\r\n");
+		testFilteredOutputStreamHelper<FILTER>("8", "foo\r\n.x\r\n.\rbar", "foo\r\n.x\r\n.\rbar\r\n.\r\n");
+		testFilteredOutputStreamHelper<FILTER>("9", "foo", "foo\r\n.\r\n", "bar");
+		testFilteredOutputStreamHelper<FILTER>("10", "foo\r\n", "foo\r\n", "\r\n", ".", "\r");
+	}
+
+	void testDotUnstuffingFilteredOutputStreamSplit()
+	{
+		const std::string data = "a\r\n..\r\n...b\r\n.c\r\n\r\n..\r\nd\re\r\n.\r\nextra";
+		const std::string expected = "a\r\n.\r\n..b\r\n.c\r\n\r\n.\r\nd\re";
+
+		// Terminator and stuffed dots split at every position
+		for (std::string::size_type i = 0 ; i <= data.length() ; ++i)
+		{
+			for (std::string::size_type j = i ; j <= data.length() ; ++j)
+			{
+				std::ostringstream oss;
+				vmime::utility::outputStreamAdapter os(oss);
+
+				vmime::utility::dotUnstuffingFilteredOutputStream fos(os);
+
+				fos.write(data.data(), i);
+				fos.write(data.data() + i, j - i);
+				fos.write(data.data() + j, data.length() - j);
+
+				std::ostringstream number;
+				number << i << "/" << j;
+
+				VASSERT_EQ(number.str(), expected, oss.str());
+				VASSERT(number.str(), fos.isTerminated());
+			}
+		}
+	}
+
 	// stopSequenceFilteredInputStream
 
 	template <int N>
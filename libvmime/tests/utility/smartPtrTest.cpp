@@ -39,6 +39,7 @@ VMIME_TEST_SUITE_BEGIN
 		VMIME_TEST(testCast)
 		VMIME_TEST(testContainer)
 		VMIME_TEST(testCompare)
+		VMIME_TEST(testThisRef)
 	VMIME_TEST_LIST_END
 
 
@@ -46,6 +47,9 @@ VMIME_TEST_SUITE_BEGIN
 	{
 		int strongCount() const { return getRefManager()->getStrongRefCount(); }
 		int weakCount() const { return getRefManager()->getWeakRefCount(); }
+
+		vmime::ref <A> self() { return thisRef().dynamicCast <A>(); }
+		vmime::weak_ref <A> weakSelf() { return thisWeakRef().acquire().dynamicCast <A>(); }
 	};
 
 	struct B : public virtual A { };
@@ -241,5 +245,32 @@ VMIME_TEST_SUITE_BEGIN
 		VASSERT("10", std::find(v.begin(), v.end(), r3) == v.end());
 	}
 
+	void testThisRef()
+	{
+		bool o1_alive;
+		vmime::ref <R> r1 = vmime::create <R>(&o1_alive);
+
+		vmime::ref <A> r2 = r1->self();
+
+		VASSERT("1", r2.get() == r1.get());
+		VASSERT_EQ("2", 2, r1->strongCount());
+
+		vmime::weak_ref <A> w1 = r1->weakSelf();
+
+		VASSERT("3", w1.acquire().get() == r1.get());
+		VASSERT_EQ("4", 2, r1->strongCount());
+		VASSERT_EQ("5", 3, r1->weakCount());
+
+		r1 = NULL;
+
+		VASSERT("6", o1_alive);
+		VASSERT("7", w1.acquire().get() == r2.get());
+
+		r2 = NULL;
+
+		VASSERT("8", !o1_alive);
+		VASSERT("9", w1.acquire().get() == 0);
+	}
+
 VMIME_TEST_SUITE_END
 
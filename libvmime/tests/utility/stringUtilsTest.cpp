@@ -64,6 +64,7 @@ VMIME_TEST_SUITE_BEGIN
 		VASSERT_EQ("1", true, stringUtils::isStringEqualNoCase(vmime::string("foo"), vmime::string("foo")));
 		VASSERT_EQ("2", true, stringUtils::isStringEqualNoCase(vmime::string("FOo"), vmime::string("foo")));
 		VASSERT_EQ("3", true, stringUtils::isStringEqualNoCase(vmime::string("foO"), vmime::string("FOo")));
+		VASSERT_EQ("4", false, stringUtils::isStringEqualNoCase(vmime::string("bar"), vmime::string("foR")));
 	}
 
 	void testIsStringEqualNoCase3()
@@ -274,6 +274,22 @@ public:
 	  */
 	static bool isValidBoundary(const string& boundary);
 
+	/** Enable or disable lazy parsing of the sub-parts. When enabled,
+	  * parse() only records the bounds of each sub-part; a part is
+	  * parsed the first time it is accessed. The setting is inherited
+	  * by the bodies of the sub-parts.
+	  *
+	  * @param lazy true to parse the sub-parts on demand, false to
+	  * parse them all in parse() (the default)
+	  */
+	void setLazyParsing(const bool lazy);
+
+	/** Return whether the sub-parts are parsed on demand.
+	  *
+	  * @return true if lazy parsing is enabled, false otherwise
+	  */
+	bool isLazyParsing() const;
+
 	ref <component> clone() const;
 	void copyFrom(const component& other);
 	body& operator=(const body& other);
@@ -295,10 +311,44 @@ private:
 
 	std::vector <ref <bodyPart> > m_parts;
 
+	/** Parsed buffer, shared by the bodies of the parts which are
+	  * parsed lazily.
+	  */
+	class sharedBuffer : public object
+	{
+	public:
+
+		sharedBuffer(const string& data) : m_data(data) { }
+
+		const string& getData() const { return (m_data); }
+
+	private:
+
+		const string m_data;
+	};
+
+	// Lazy parsing: buffer and bounds of the parts which have not been
+	// parsed yet (NULL entries in m_parts)
+	ref <const sharedBuffer> m_lazyBuffer;
+	std::vector <std::pair <string::size_type, string::size_type> > m_lazyBounds;
+	std::vector <ref <bodyPart> >::size_type m_lazyCount;
+	bool m_lazyParsing;
+
+	ref <const sharedBuffer> shareBuffer(const string& buffer) const;
+
 	bool isRootPart() const;
 
 	void initNewPart(ref <bodyPart> part);
 
+	static string::size_type findNextBoundary(const string& buffer, const string& boundarySep,
+		const std::vector <string::size_type>& boundaries,
+		std::vector <string::size_type>::const_iterator& it,
+		const string::size_type from, const string::size_type end);
+
+	void addParsedPart(const string& buffer, const string::size_type partStart, const string::size_type partEnd);
+	void parsePartAt(const int pos);
+	void parseAllParts();
+
 public:
 
 	using component::parse;
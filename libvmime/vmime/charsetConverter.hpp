@@ -31,11 +31,20 @@
 #include "vmime/charset.hpp"
 #include "vmime/utility/filteredStream.hpp"
 
+#include <vector>
+#include <utility>
+
 
 namespace vmime
 {
 
 
+namespace utility
+{
+	class charsetFilteredOutputStream;
+}
+
+
 /** Convert between charsets.
   */
 
@@ -43,6 +52,66 @@ class charsetConverter : public object
 {
 public:
 
+	/** Keeps the conversion descriptors released by the current thread,
+	  * so that the next converters for the same charsets take them back
+	  * without going through the shared descriptor pool.
+	  *
+	  * Descriptors are kept only while a cache::scope is active; they
+	  * are given back to the shared pool when the cache is destroyed.
+	  * A cache must only be used by one thread at a time.
+	  */
+	class cache
+	{
+	public:
+
+		/** Use the specified cache for the converters created and
+		  * destroyed by the current thread, for the lifetime of this
+		  * object. Scopes can be nested.
+		  */
+		class scope
+		{
+		public:
+
+			/** @param c descriptor cache, which must outlive this object
+			  */
+			explicit scope(cache& c);
+			~scope();
+
+		private:
+
+			scope(const scope&);
+			scope& operator=(const scope&);
+
+			cache* m_previous;
+		};
+
+
+		cache();
+		~cache();
+
+	private:
+
+		cache(const cache&);
+		cache& operator=(const cache&);
+
+		void* take(const string& key);
+		bool keep(const string& key, void* desc);
+
+		// Get a descriptor for the specified conversion from the
+		// cache of the current thread or from the shared pool
+		static void* acquire(const charset& source, const charset& dest);
+
+		// Give back a descriptor obtained with acquire()
+		static void release(const charset& source, const charset& dest, void* desc);
+
+		// Idle descriptors, with the (source, dest) key of the pool
+		std::vector <std::pair <string, void*> > m_descriptors;
+
+		friend class charsetConverter;
+		friend class utility::charsetFilteredOutputStream;
+	};
+
+
 	/** Construct and initialize a charset converter.
 	  *
 	  * @param source input charset
@@ -77,6 +146,7 @@ public:
 
 private:
 
+	int m_fastPath;  // built-in conversion used instead of iconv, if any
 	void* m_desc;
 
 	charset m_source;
@@ -121,6 +191,7 @@ private:
 	enum { MAX_CHARACTER_WIDTH = 128 };
 
 
+	int m_fastPath;  // built-in conversion used instead of iconv, if any
 	void* m_desc;
 
 	const charset m_sourceCharset;
@@ -43,6 +43,8 @@ typedef unsigned int vmime_uint32;
 #define VMIME_HAVE_SASL_SUPPORT 0
 // -- TLS support
 #define VMIME_HAVE_TLS_SUPPORT 0
+// -- Intrusive reference counting
+#define VMIME_INTRUSIVE_REFCOUNT 0
 // -- Messaging support
 #define VMIME_HAVE_MESSAGING_FEATURES 1
 // -- Built-in messaging protocols
@@ -48,10 +48,12 @@ class header : public component
 	friend class bodyPart;
 	friend class body;
 	friend class message;
+	friend class headerField;
 
 public:
 
 	header();
+	header(const header& h);
 	~header();
 
 #define FIELD_ACCESS(methodName, fieldName) \
@@ -123,6 +125,8 @@ public:
 	/** Add a field at the end of the list.
 	  *
 	  * @param field field to append
+	  * @throw exceptions::invalid_argument if the field already belongs
+	  * to a header
 	  */
 	void appendField(ref <headerField> field);
 
@@ -131,6 +135,8 @@ public:
 	  * @param beforeField field before which the new field will be inserted
 	  * @param field field to insert
 	  * @throw exceptions::no_such_field if the field is not in the list
+	  * @throw exceptions::invalid_argument if the field already belongs
+	  * to a header
 	  */
 	void insertFieldBefore(ref <headerField> beforeField, ref <headerField> field);
 
@@ -139,6 +145,8 @@ public:
 	  * @param pos position at which to insert the new field (0 to insert at
 	  * the beginning of the list)
 	  * @param field field to insert
+	  * @throw exceptions::invalid_argument if the field already belongs
+	  * to a header
 	  */
 	void insertFieldBefore(const int pos, ref <headerField> field);
 
@@ -147,6 +155,8 @@ public:
 	  * @param afterField field after which the new field will be inserted
 	  * @param field field to insert
 	  * @throw exceptions::no_such_field if the field is not in the list
+	  * @throw exceptions::invalid_argument if the field already belongs
+	  * to a header
 	  */
 	void insertFieldAfter(ref <headerField> afterField, ref <headerField> field);
 
@@ -154,6 +164,8 @@ public:
 	  *
 	  * @param pos position of the field before the new field
 	  * @param field field to insert
+	  * @throw exceptions::invalid_argument if the field already belongs
+	  * to a header
 	  */
 	void insertFieldAfter(const int pos, ref <headerField> field);
 
@@ -227,29 +239,24 @@ private:
 	std::vector <ref <headerField> > m_fields;
 
 
-	class fieldHasName
-	{
-	public:
+	// Index of the fields by name: open-addressing table keyed by the
+	// hash of the field name, pointing to the first field with this
+	// hash; the next ones are chained in ascending order. It is updated
+	// each time the fields are modified or renamed, so that lookups
+	// never modify the header.
+	std::vector <int> m_indexTable;
+	std::vector <vmime_uint32> m_indexHash;
+	std::vector <int> m_indexNext;
 
-		fieldHasName(const string& name);
-		bool operator() (const ref <const headerField>& field);
+	void buildIndex();
+	bool addToIndex(const int pos);
 
-	private:
+	void attachField(ref <headerField> field);
+	void detachField(ref <headerField> field);
+	std::vector <int>::size_type findIndexSlot(const vmime_uint32 hash) const;
 
-		string m_name;
-	};
-
-	class fieldHasNotName
-	{
-	public:
-
-		fieldHasNotName(const string& name);
-		bool operator() (const ref <const headerField>& field);
-
-	private:
-
-		string m_name;
-	};
+	int findFirstField(const string& fieldName) const;
+	int findNextField(const string& fieldName, const int pos) const;
 
 public:
 
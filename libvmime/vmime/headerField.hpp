@@ -28,12 +28,16 @@
 #include "vmime/base.hpp"
 #include "vmime/component.hpp"
 #include "vmime/headerFieldValue.hpp"
+#include "vmime/headerTokenizer.hpp"
 
 
 namespace vmime
 {
 
 
+class header;
+
+
 /** Base class for header fields.
   */
 
@@ -127,10 +131,16 @@ public:
 protected:
 
 	static ref <headerField> parseNext(const string& buffer, const string::size_type position, const string::size_type end, string::size_type* newPosition = NULL);
+	static ref <headerField> parseToken(const string& buffer, const headerTokenizer::token& tok);
 
 
 	string m_name;
 	ref <headerFieldValue> m_value;
+
+	// Header which contains this field (a field belongs to one header
+	// at most), notified when the field is renamed so that it can update
+	// its field index
+	header* m_header;
 };
 
 
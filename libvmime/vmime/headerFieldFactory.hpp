@@ -53,6 +53,24 @@ protected:
 
 	ValueMap m_valueMap;
 
+	// Standard fields (see vmime::fields) are found with a perfect
+	// hash on the field name, without building a lowercase copy of
+	// it; only the other names are stored in the maps above
+	struct standardField
+	{
+		string name;   // in lowercase
+		AllocFunc alloc;
+		ValueAllocFunc valueAlloc;
+	};
+
+	static const int STANDARD_FIELD_TABLE_SIZE = 128;
+
+	std::vector <standardField> m_standardFields;
+	int m_standardFieldTable[STANDARD_FIELD_TABLE_SIZE];
+
+	int findStandardField(const string& name) const;
+	void findAllocFuncs(const string& name, AllocFunc* alloc, ValueAllocFunc* valueAlloc) const;
+
 public:
 
 	static headerFieldFactory* getInstance();
@@ -81,9 +99,19 @@ public:
 	template <class T>
 	void registerField(const string& name)
 	{
-		m_nameMap.insert(NameMap::value_type
-			(utility::stringUtils::toLower(name),
-			 &registerer <headerField, T>::creator));
+		const int index = findStandardField(name);
+
+		if (index >= 0)
+		{
+			if (m_standardFields[index].alloc == NULL)
+				m_standardFields[index].alloc = &registerer <headerField, T>::creator;
+		}
+		else
+		{
+			m_nameMap.insert(NameMap::value_type
+				(utility::stringUtils::toLower(name),
+				 &registerer <headerField, T>::creator));
+		}
 	}
 
 	/** Register a field value type.
@@ -94,9 +122,19 @@ public:
 	template <class T>
 	void registerFieldValue(const string& name)
 	{
-		m_valueMap.insert(ValueMap::value_type
-			(utility::stringUtils::toLower(name),
-			 &registerer <headerFieldValue, T>::creator));
+		const int index = findStandardField(name);
+
+		if (index >= 0)
+		{
+			if (m_standardFields[index].valueAlloc == NULL)
+				m_standardFields[index].valueAlloc = &registerer <headerFieldValue, T>::creator;
+		}
+		else
+		{
+			m_valueMap.insert(ValueMap::value_type
+				(utility::stringUtils::toLower(name),
+				 &registerer <headerFieldValue, T>::creator));
+		}
 	}
 
 	/** Create a new field object for the specified field name.
@@ -116,6 +154,14 @@ public:
 	  * @return a new value object for the field
 	  */
 	ref <headerFieldValue> createValue(const string& fieldName);
+
+	/** Compute a hash value for the specified field name. Names
+	  * which only differ by case have the same hash value.
+	  *
+	  * @param name field name
+	  * @return hash value
+	  */
+	static vmime_uint32 hashFieldName(const string& name);
 };
 
 
@@ -0,0 +1,103 @@
+//
+// VMime library (http://www.vmime.org)
+// Copyright (C) 2002-2009 Vincent Richard <vincent@vincent-richard.net>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// Linking this library statically or dynamically with other modules is making
+// a combined work based on this library.  Thus, the terms and conditions of
+// the GNU General Public License cover the whole combination.
+//
+
+#ifndef VMIME_HEADERTOKENIZER_HPP_INCLUDED
+#define VMIME_HEADERTOKENIZER_HPP_INCLUDED
+
+
+#include "vmime/types.hpp"
+
+#include <vector>
+
+
+namespace vmime
+{
+
+
+/** Splits a header block into fields, without copying any data.
+  *
+  * Line ends are located block by block with the vectorized
+  * utility::bufferScanner, so that the tokenizer does not need to
+  * examine each character of the field values.
+  */
+
+class headerTokenizer
+{
+public:
+
+	/** Bounds of a field in the buffer. */
+	struct token
+	{
+		string::size_type nameStart;   /**< start of the field name */
+		string::size_type nameEnd;     /**< end of the field name */
+		string::size_type valueStart;  /**< start of the field value */
+		string::size_type valueEnd;    /**< end of the field value (line end not included) */
+		string::size_type end;         /**< end of the field, including line end and folded lines */
+	};
+
+
+	headerTokenizer(const string& buffer, const string::size_type position, const string::size_type end);
+
+	/** Find the next field in the header block.
+	  *
+	  * @param tok will receive the bounds of the field
+	  * @return true if a field has been found, or false if the end of
+	  * the header block has been reached
+	  */
+	bool getNextToken(token& tok);
+
+	/** Find all the remaining fields in the header block.
+	  *
+	  * @param tokens will receive the bounds of the fields (the vector
+	  * is not cleared)
+	  */
+	void getAllTokens(std::vector <token>& tokens);
+
+	/** Return the current position in the buffer. After the last
+	  * field has been read, this is the position just after the
+	  * header block (ie. after the empty line, if any).
+	  *
+	  * @return current position
+	  */
+	string::size_type getPosition() const;
+
+private:
+
+	string::size_type findLineEnd(const string::size_type from);
+
+	const string& m_buffer;
+	const string::size_type m_end;
+
+	string::size_type m_pos;
+
+	std::vector <string::size_type> m_lineEnds;
+	std::vector <string::size_type>::size_type m_lineEndIndex;
+	string::size_type m_scannedEnd;
+	string::size_type m_scanLength;
+};
+
+
+} // vmime
+
+
+#endif // VMIME_HEADERTOKENIZER_HPP_INCLUDED
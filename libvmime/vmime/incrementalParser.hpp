@@ -0,0 +1,177 @@
+//
+// VMime library (http://www.vmime.org)
+// Copyright (C) 2002-2009 Vincent Richard <vincent@vincent-richard.net>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// Linking this library statically or dynamically with other modules is making
+// a combined work based on this library.  Thus, the terms and conditions of
+// the GNU General Public License cover the whole combination.
+//
+
+#ifndef VMIME_INCREMENTALPARSER_HPP_INCLUDED
+#define VMIME_INCREMENTALPARSER_HPP_INCLUDED
+
+
+#include "vmime/base.hpp"
+
+#include "vmime/header.hpp"
+#include "vmime/message.hpp"
+
+
+namespace vmime
+{
+
+
+/** Receives the events of an incrementalParser. The default
+  * implementation of each method does nothing.
+  */
+
+class incrementalParserListener
+{
+public:
+
+	virtual ~incrementalParserListener() { }
+
+	/** Called as soon as the header of an entity has been received.
+	  *
+	  * @param hdr header of the entity
+	  * @param depth 0 for the header of the message, 1 for the header
+	  * of a part of the message, 2 for a part of this part, etc.
+	  */
+	virtual void onHeader(ref <const header> hdr, const int depth);
+
+	/** Called when a boundary starting a new part has been received.
+	  * The header of the part follows.
+	  *
+	  * @param depth depth of the part (1 for a part of the message)
+	  */
+	virtual void onPartBegin(const int depth);
+
+	/** Called when the end of a part is known, that is when the next
+	  * boundary has been received (or at the end of the data).
+	  *
+	  * @param depth depth of the part (1 for a part of the message)
+	  */
+	virtual void onPartEnd(const int depth);
+
+	/** Called with the contents of an entity which is not a multipart
+	  * entity, as they are received. The contents are given as they
+	  * appear in the message (not decoded), without the line break which
+	  * precedes the next boundary, and may be split in any number of calls.
+	  *
+	  * @param data pointer to the data
+	  * @param length length of the data
+	  * @param depth depth of the entity (0 for the message)
+	  */
+	virtual void onBody(const char* data, const string::size_type length, const int depth);
+};
+
+
+/** Parse a message which is received in chunks: the header of
+  * the message and of its parts are reported to a listener as soon
+  * as they are complete, without waiting for the whole message.
+  *
+  * By default, the data is kept, so that the complete message can be
+  * obtained with getMessage() once all of it has been received.
+  */
+
+class incrementalParser
+{
+public:
+
+	/** @param listener object which receives the parsing events
+	  * @param keepData if false, the data is released as soon as it has
+	  * been processed, and getMessage() and getBuffer() cannot be used
+	  */
+	incrementalParser(incrementalParserListener* listener, const bool keepData = true);
+
+	/** Add data to the message. Events are reported for the
+	  * complete lines received so far.
+	  *
+	  * @param data pointer to the data
+	  * @param length length of the data
+	  */
+	void feed(const char* data, const string::size_type length);
+
+	/** Signal the end of the data: the last (incomplete) line is
+	  * processed, and the parts which are still open are ended.
+	  * No more data can be fed after this.
+	  */
+	void finish();
+
+	/** Parse the complete message received. The data must have
+	  * been kept (see the constructor).
+	  *
+	  * @return parsed message
+	  */
+	ref <message> getMessage() const;
+
+	/** Return the data received so far or, if it is not kept, the
+	  * data which has not been processed yet.
+	  *
+	  * @return raw message data
+	  */
+	const string& getBuffer() const;
+
+private:
+
+	incrementalParser(const incrementalParser&);
+	incrementalParser& operator=(const incrementalParser&);
+
+	void processLine(const string::size_type start, const string::size_type end);
+	void endHeader(const string::size_type end);
+	bool processBoundary(const string::size_type start, const string::size_type end);
+	void reportContents(const string::size_type start, const string::size_type end);
+	void releaseData();
+
+
+	enum State
+	{
+		STATE_HEADER,    /**< Reading the header of an entity. */
+		STATE_BODY       /**< Reading the body of an entity. */
+	};
+
+	/** An open multipart entity. */
+	struct level
+	{
+		string boundary;
+		bool inPart;     /**< Whether a part of this entity is open. */
+	};
+
+
+	incrementalParserListener* m_listener;
+
+	string m_data;
+	bool m_keepData;
+
+	State m_state;
+	string::size_type m_lineStart;    /**< Start of the first unprocessed line. */
+	string::size_type m_scanPos;      /**< Where to resume looking for the end of this line. */
+	string::size_type m_headerStart;  /**< Start of the header being received. */
+
+	std::vector <level> m_levels;
+
+	bool m_inContents;                /**< Whether the body being received is reported. */
+	string m_heldLineBreak;           /**< Line break which may precede a boundary. */
+
+	bool m_finished;
+};
+
+
+} // vmime
+
+
+#endif // VMIME_INCREMENTALPARSER_HPP_INCLUDED
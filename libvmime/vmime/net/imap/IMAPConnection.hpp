@@ -78,7 +78,24 @@ public:
 	void send(bool tag, const string& what, bool end);
 	void sendRaw(const char* buffer, const int count);
 
-	IMAPParser::response* readResponse(IMAPParser::literalHandler* lh = NULL);
+	IMAPParser::response* readResponse(IMAPParser::literalHandler* lh = NULL, IMAPParser::responseHandler* rh = NULL);
+
+	/** Send several commands without waiting for each response before
+	  * sending the next one. At most maxInFlight commands are sent ahead
+	  * of the responses read so far; completions are matched to their
+	  * command by tag.
+	  *
+	  * Only commands which do not depend on the result of one another
+	  * must be sent this way.
+	  *
+	  * @param commands commands to send (without tag)
+	  * @param responses receives the response to each command, in the
+	  * same order as the commands; the caller is responsible for
+	  * deleting them
+	  * @param maxInFlight maximum number of commands awaiting completion
+	  */
+	void sendPipelined(const std::vector <string>& commands,
+		std::vector <IMAPParser::response*>& responses, const int maxInFlight = 16);
 
 
 	ref <const IMAPTag> getTag() const;
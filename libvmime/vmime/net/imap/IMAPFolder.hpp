@@ -32,6 +32,8 @@
 
 #include "vmime/net/folder.hpp"
 
+#include "vmime/net/imap/IMAPParser.hpp"
+
 
 namespace vmime {
 namespace net {
@@ -62,6 +64,41 @@ private:
 
 public:
 
+	/** Receives the messages fetched by fetchMessages(from, to, ...).
+	  */
+	class fetchListener
+	{
+	public:
+
+		virtual ~fetchListener() { }
+
+		/** Called for each message as soon as its data has been received.
+		  *
+		  * @param msg fetched message, which is released after this call
+		  * unless the listener keeps a reference to it
+		  */
+		virtual void messageFetched(ref <message> msg) = 0;
+	};
+
+	/** Receives the text parts fetched by prefetchTextParts().
+	  */
+	class textPartListener
+	{
+	public:
+
+		virtual ~textPartListener() { }
+
+		/** Called for each text part of the messages.
+		  *
+		  * @param msg message to which the part belongs
+		  * @param p text part
+		  * @param data beginning of the part contents, not decoded
+		  * (see the Content-Transfer-Encoding of the part)
+		  */
+		virtual void textPartFetched(ref <message> msg, ref <const part> p, const string& data) = 0;
+	};
+
+
 	int getMode() const;
 
 	int getType();
@@ -107,8 +144,35 @@ public:
 
 	void status(int& count, int& unseen);
 
+	/** Get the status of several folders at once. The STATUS commands
+	  * are pipelined, so that the whole batch costs about one round trip
+	  * instead of one per folder.
+	  *
+	  * @param folders folders whose status is requested; they must all
+	  * use the same connection (ie. none of them is open, or the same
+	  * folder is given several times)
+	  * @param count receives the number of messages in each folder
+	  * @param unseen receives the number of unseen messages in each folder
+	  * @throw exceptions::invalid_argument if the folders do not share
+	  * their connection
+	  */
+	static void status(const std::vector <ref <IMAPFolder> >& folders,
+		std::vector <int>& count, std::vector <int>& unseen);
+
 	void expunge();
 
+	/** Copy messages to another folder, then remove them from this
+	  * folder. Marking the messages as deleted and expunging them are
+	  * pipelined; they are only sent once the copy has succeeded.
+	  *
+	  * Note that, as for expunge(), any other message already marked
+	  * as deleted in this folder is also removed.
+	  *
+	  * @param dest destination folder path
+	  * @param nums sequence numbers of the messages to move
+	  */
+	void moveMessages(const folder::path& dest, const std::vector <int>& nums);
+
 	ref <folder> getParent();
 
 	ref <const store> getStore() const;
@@ -118,10 +182,51 @@ public:
 	void fetchMessages(std::vector <ref <message> >& msg, const int options, utility::progressListener* progress = NULL);
 	void fetchMessage(ref <message> msg, const int options);
 
+	/** Fetch information about a range of messages and pass each message
+	  * to the listener as soon as its data has been received. Messages
+	  * are created on the fly, so that memory usage does not depend on
+	  * the number of messages.
+	  *
+	  * @param from sequence number of the first message to fetch
+	  * @param to sequence number of the last message to fetch (or -1
+	  * to fetch up to the last message of the folder)
+	  * @param options objects to fetch (combination of folder::FetchOptions flags)
+	  * @param listener receives the fetched messages
+	  * @param progress progress listener, or NULL if not used
+	  */
+	void fetchMessages(const int from, const int to, const int options,
+		fetchListener* listener, utility::progressListener* progress = NULL);
+
+	/** Fetch the structure of the messages, then the beginning of all
+	  * their text parts. Text parts are found in the structure, so this
+	  * takes two steps: the structure of all the messages is fetched
+	  * with one command; then the messages whose text parts have the
+	  * same sections are fetched together, and these commands are
+	  * pipelined.
+	  *
+	  * Parts are fetched with BODY.PEEK, so that the messages are not
+	  * marked as seen.
+	  *
+	  * @param msg messages to fetch
+	  * @param options other objects to fetch with the structure
+	  * (combination of folder::FetchOptions flags)
+	  * @param maxLength maximum number of bytes fetched for each part
+	  * @param listener receives the text parts
+	  */
+	void prefetchTextParts(std::vector <ref <message> >& msg, const int options,
+		const int maxLength, textPartListener* listener);
+
 	int getFetchCapabilities() const;
 
 private:
 
+	class fetchResponseHandler;
+
+	void fetchMessages(const string& set, const int options, fetchResponseHandler& handler);
+
+	static void findTextParts(ref <const structure> str, std::vector <ref <const part> >& parts);
+	static ref <const part> findPart(ref <const structure> str, const IMAPParser::section* section);
+
 	void registerMessage(IMAPMessage* msg);
 	void unregisterMessage(IMAPMessage* msg);
 
@@ -135,6 +240,12 @@ private:
 
 	void copyMessages(const string& set, const folder::path& dest);
 
+	const string statusCommand() const;
+	void processStatusResponse(const IMAPParser::response* resp,
+		const std::vector <IMAPParser::response*>& dataResponses, int& count, int& unseen);
+
+	void processExpungeResponse(const IMAPParser::response* resp);
+
 
 	weak_ref <IMAPStore> m_store;
 	ref <IMAPConnection> m_connection;
@@ -102,6 +102,14 @@ private:
 
 	void extract(ref <const part> p, utility::outputStream& os, utility::progressListener* progress, const int start, const int length, const bool headerOnly, const bool peek) const;
 
+	/** Return the section identifier of a part, as used in FETCH
+	  * commands (eg. "2.1"), or an empty string for the root part.
+	  *
+	  * @param p part of the structure of a message
+	  * @return section identifier
+	  */
+	static const string getSection(ref <const part> p);
+
 
 	ref <header> getOrCreateHeader();
 
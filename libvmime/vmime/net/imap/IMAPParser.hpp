@@ -45,6 +45,7 @@
 #include "vmime/net/imap/IMAPTag.hpp"
 
 #include <vector>
+#include <algorithm>
 #include <stdexcept>
 
 
@@ -135,7 +136,8 @@ public:
 
 	IMAPParser(weak_ref <IMAPTag> tag, weak_ref <socket> sok, weak_ref <timeoutHandler> _timeoutHandler)
 		: m_tag(tag), m_socket(sok), m_progress(NULL), m_strict(false),
-		  m_literalHandler(NULL), m_timeoutHandler(_timeoutHandler)
+		  m_literalHandler(NULL), m_responseHandler(NULL), m_acceptAnyTag(false),
+		  m_timeoutHandler(_timeoutHandler), m_bufferPos(0), m_scanPos(0)
 	{
 	}
 
@@ -171,6 +173,18 @@ public:
 		return m_strict;
 	}
 
+	/** Set whether the completion of any command is accepted, or
+	  * only the completion of the last command sent (default). The
+	  * former is needed when several commands are in flight.
+	  *
+	  * @param accept true to accept any tag, or false to accept only
+	  * the current tag
+	  */
+	void setAcceptAnyTag(const bool accept)
+	{
+		m_acceptAnyTag = accept;
+	}
+
 
 	const string lastLine() const
 	{
@@ -228,6 +242,11 @@ public:
 
 			virtual void putData(const string& chunk) = 0;
 
+			virtual void putData(const char* data, const string::size_type count)
+			{
+				putData(string(data, count));
+			}
+
 		private:
 
 			utility::progressListener* m_progress;
@@ -251,6 +270,11 @@ public:
 				m_string += chunk;
 			}
 
+			void putData(const char* data, const vmime::string::size_type count)
+			{
+				m_string.append(data, count);
+			}
+
 		private:
 
 			vmime::string& m_string;
@@ -274,6 +298,11 @@ public:
 				m_stream.write(chunk.data(), chunk.length());
 			}
 
+			void putData(const char* data, const string::size_type count)
+			{
+				m_stream.write(data, count);
+			}
+
 		private:
 
 			utility::outputStream& m_stream;
@@ -292,6 +321,26 @@ public:
 	};
 
 
+	//
+	// responseHandler : untagged response data handler
+	//
+
+	class response_data;
+
+	class responseHandler
+	{
+	public:
+
+		virtual ~responseHandler() { }
+
+		// Called for each untagged response as soon as it has been
+		// parsed, instead of adding it to the response. The data is
+		// deleted when this function returns.
+
+		virtual void handleResponseData(const response_data& resp) = 0;
+	};
+
+
 	//
 	// Base class for a terminal or a non-terminal
 	//
@@ -474,8 +523,9 @@ public:
 				}
 			}
 
-			if (tagString == string(*parser.getTag()))
+			if (parser.m_acceptAnyTag ? !tagString.empty() : tagString == string(*parser.getTag()))
 			{
+				m_tag = tagString;
 				*currentPos = pos;
 			}
 			else
@@ -484,6 +534,14 @@ public:
 				throw exceptions::invalid_response("", makeResponseLine("tag", line, pos));
 			}
 		}
+
+	private:
+
+		string m_tag;
+
+	public:
+
+		const string& tag() const { return (m_tag); }
 	};
 
 
@@ -961,12 +1019,16 @@ public:
 						}
 						else
 						{
+							m_value.reserve(length);
+
 							literalHandler::targetString target(NULL, m_value);
 							parser.readLiteral(target, length);
 						}
 					}
 					else
 					{
+						m_value.reserve(length);
+
 						literalHandler::targetString target(NULL, m_value);
 						parser.readLiteral(target, length);
 					}
@@ -4693,7 +4755,9 @@ public:
 
 			string::size_type pos = *currentPos;
 
-			parser.check <IMAPParser::xtag>(line, &pos);
+			utility::auto_ptr <IMAPParser::xtag> tag(parser.get <IMAPParser::xtag>(line, &pos));
+			m_tag = tag->tag();
+
 			parser.check <SPACE>(line, &pos);
 			m_resp_cond_state = parser.get <IMAPParser::resp_cond_state>(line, &pos);
 			parser.check <CRLF>(line, &pos);
@@ -4703,10 +4767,12 @@ public:
 
 	private:
 
+		string m_tag;
 		IMAPParser::resp_cond_state* m_resp_cond_state;
 
 	public:
 
+		const string& tag() const { return (m_tag); }
 		const IMAPParser::resp_cond_state* resp_cond_state() const { return (m_resp_cond_state); }
 	};
 
@@ -4791,15 +4857,25 @@ public:
 
 			while ((resp = parser.get <IMAPParser::continue_req_or_response_data>(curLine, &pos, true)) != NULL)
 			{
-				m_continue_req_or_response_data.push_back(resp);
-
 				// Partial response (continue_req)
 				if (resp->continue_req())
 				{
+					m_continue_req_or_response_data.push_back(resp);
+
 					partial = true;
 					break;
 				}
 
+				if (parser.m_responseHandler != NULL)
+				{
+					utility::auto_ptr <IMAPParser::continue_req_or_response_data> data(resp);
+					parser.m_responseHandler->handleResponseData(*resp->response_data());
+				}
+				else
+				{
+					m_continue_req_or_response_data.push_back(resp);
+				}
+
 				// We have read a CRLF, read another line
 				curLine = parser.readLine();
 				pos = 0;
@@ -4894,14 +4970,24 @@ public:
 	// The main functions used to parse a response
 	//
 
-	response* readResponse(literalHandler* lh = NULL)
+	/** Read a response.
+	  *
+	  * @param lh handler for literals, or NULL to put them into the response
+	  * @param rh handler for untagged responses, or NULL to put them
+	  * into the response; with a handler, only the last one is held in
+	  * memory at a time
+	  * @return response
+	  */
+	response* readResponse(literalHandler* lh = NULL, responseHandler* rh = NULL)
 	{
 		string::size_type pos = 0;
 		string line = readLine();
 
 		m_literalHandler = lh;
+		m_responseHandler = rh;
 		response* resp = get <response>(line, &pos);
 		m_literalHandler = NULL;
+		m_responseHandler = NULL;
 
 		return (resp);
 	}
@@ -5024,12 +5110,21 @@ private:
 	bool m_strict;
 
 	literalHandler* m_literalHandler;
+	responseHandler* m_responseHandler;
+
+	bool m_acceptAnyTag;
 
 	weak_ref <timeoutHandler> m_timeoutHandler;
 
 
+	// Received data; data before m_bufferPos has been consumed, and
+	// there is no line break between m_bufferPos and m_scanPos
 	string m_buffer;
-	int m_pos;
+	string::size_type m_bufferPos;
+	string::size_type m_scanPos;
+
+	// Block-sized buffer through which literals are received
+	std::vector <char> m_literalBuffer;
 
 	string m_lastLine;
 
@@ -5043,16 +5138,15 @@ public:
 	{
 		string::size_type pos;
 
-		while ((pos = m_buffer.find('\n')) == string::npos)
+		while ((pos = m_buffer.find('\n', m_scanPos)) == string::npos)
 		{
+			m_scanPos = m_buffer.length();
 			read();
 		}
 
-		string line;
-		line.resize(pos + 1);
-		std::copy(m_buffer.begin(), m_buffer.begin() + pos + 1, line.begin());
+		string line(m_buffer, m_bufferPos, pos + 1 - m_bufferPos);
 
-		m_buffer.erase(m_buffer.begin(), m_buffer.begin() + pos + 1);
+		m_bufferPos = m_scanPos = pos + 1;
 
 		m_lastLine = line;
 
@@ -5070,121 +5164,110 @@ public:
 
 	void read()
 	{
-		string receiveBuffer;
-
-		ref <timeoutHandler> toh = m_timeoutHandler.acquire();
-		ref <socket> sok = m_socket.acquire();
-
-		if (toh)
-			toh->resetTimeOut();
-
-		while (receiveBuffer.empty())
+		// Drop consumed data once it takes at least half of the buffer,
+		// so that each byte is moved at most once on average
+		if (m_bufferPos != 0 && m_bufferPos >= m_buffer.length() - m_bufferPos)
 		{
-			// Check whether the time-out delay is elapsed
-			if (toh && toh->isTimeOut())
-			{
-				if (!toh->handleTimeOut())
-					throw exceptions::operation_timed_out();
-			}
+			m_buffer.erase(0, m_bufferPos);
 
-			// We have received data: reset the time-out counter
-			sok->receive(receiveBuffer);
+			m_scanPos -= m_bufferPos;
+			m_bufferPos = 0;
+		}
 
-			if (receiveBuffer.empty())   // buffer is empty
-			{
-				platform::getHandler()->wait();
-				continue;
-			}
+		// Receive directly at the end of the buffer
+		const socket::size_type blockSize = m_socket.acquire()->getBlockSize();
+		const string::size_type length = m_buffer.length();
 
-			// We have received data ...
-			if (toh)
-				toh->resetTimeOut();
-		}
+		m_buffer.resize(length + static_cast <string::size_type>(blockSize));
 
-		m_buffer += receiveBuffer;
+		try
+		{
+			m_buffer.resize(length + static_cast <string::size_type>
+				(receive(&m_buffer[length], blockSize)));
+		}
+		catch (...)
+		{
+			m_buffer.resize(length);
+			throw;
+		}
 	}
 
 
 	void readLiteral(literalHandler::target& buffer, string::size_type count)
 	{
 		string::size_type len = 0;
-		string receiveBuffer;
-
-		ref <timeoutHandler> toh = m_timeoutHandler.acquire();
-		ref <socket> sok = m_socket.acquire();
 
 		if (m_progress)
 			m_progress->start(count);
 
-		if (toh)
-			toh->resetTimeOut();
-
-		if (!m_buffer.empty())
+		// Data already received
+		if (m_bufferPos < m_buffer.length())
 		{
-			if (m_buffer.length() > count)
-			{
-				buffer.putData(string(m_buffer.begin(), m_buffer.begin() + count));
-				m_buffer.erase(m_buffer.begin(), m_buffer.begin() + count);
-				len = count;
-			}
-			else
-			{
-				len += m_buffer.length();
-				buffer.putData(m_buffer);
-				m_buffer.clear();
-			}
+			len = std::min(count, m_buffer.length() - m_bufferPos);
+
+			buffer.putData(m_buffer.data() + m_bufferPos, len);
+
+			m_bufferPos += len;
+			m_scanPos = std::max(m_scanPos, m_bufferPos);
 		}
 
+		// The rest goes from the socket to the target, without being
+		// stored in the response buffer
+		if (len < count && m_literalBuffer.empty())
+			m_literalBuffer.resize(static_cast <std::vector <char>::size_type>(m_socket.acquire()->getBlockSize()));
+
 		while (len < count)
 		{
-			// Check whether the time-out delay is elapsed
-			if (toh && toh->isTimeOut())
-			{
-				if (!toh->handleTimeOut())
-					throw exceptions::operation_timed_out();
+			const socket::size_type size = static_cast <socket::size_type>
+				(std::min(count - len, static_cast <string::size_type>(m_literalBuffer.size())));
 
-				toh->resetTimeOut();
-			}
+			const socket::size_type n = receive(&m_literalBuffer[0], size);
 
-			// Receive data from the socket
-			sok->receive(receiveBuffer);
+			buffer.putData(&m_literalBuffer[0], static_cast <string::size_type>(n));
+			len += static_cast <string::size_type>(n);
 
-			if (receiveBuffer.empty())   // buffer is empty
-			{
-				platform::getHandler()->wait();
-				continue;
-			}
+			// Notify progress
+			if (m_progress)
+				m_progress->progress(len, count);
+		}
 
-			// We have received data: reset the time-out counter
-			if (toh)
-				toh->resetTimeOut();
+		if (m_progress)
+			m_progress->stop(count);
+	}
 
-			if (len + receiveBuffer.length() > count)
-			{
-				const string::size_type remaining = count - len;
 
-				// Get the needed amount of data
-				buffer.putData(string(receiveBuffer.begin(), receiveBuffer.begin() + remaining));
+	//
+	// Wait for data from socket stream, and store at most 'count'
+	// bytes of it into 'buffer'; return the number of bytes stored
+	//
 
-				// Put the remaining data into the internal response buffer
-				receiveBuffer.erase(receiveBuffer.begin(), receiveBuffer.begin() + remaining);
-				m_buffer += receiveBuffer;
+	socket::size_type receive(char* buffer, const socket::size_type count)
+	{
+		ref <timeoutHandler> toh = m_timeoutHandler.acquire();
+		ref <socket> sok = m_socket.acquire();
 
-				len = count;
-			}
-			else
+		if (toh)
+			toh->resetTimeOut();
+
+		while (true)
+		{
+			// Check whether the time-out delay is elapsed
+			if (toh && toh->isTimeOut())
 			{
-				buffer.putData(receiveBuffer);
-				len += receiveBuffer.length();
+				if (!toh->handleTimeOut())
+					throw exceptions::operation_timed_out();
+
+				toh->resetTimeOut();
 			}
 
-			// Notify progress
-			if (m_progress)
-				m_progress->progress(len, count);
-		}
+			const socket::size_type n = sok->receiveRaw(buffer, count);
 
-		if (m_progress)
-			m_progress->stop(count);
+			if (n > 0)
+				return (n);
+
+			// No data available yet
+			platform::getHandler()->wait();
+		}
 	}
 };
 
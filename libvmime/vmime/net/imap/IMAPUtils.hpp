@@ -96,6 +96,14 @@ public:
 	  */
 	static const string buildFetchRequest(const std::vector <int>& list, const int options);
 
+	/** Construct a fetch request for the specified set of messages.
+	  *
+	  * @param set IMAP set of message numbers (eg. "1:5,7,9:*")
+	  * @param options fetch options
+	  * @return fetch request
+	  */
+	static const string buildFetchRequest(const string& set, const int options);
+
 	/** Convert a parser-style address list to a mailbox list.
 	  *
 	  * @param src input address list
@@ -109,6 +109,8 @@ private:
 	void readResponse(string& buffer, const bool multiLine, utility::progressListener* progress = NULL);
 	void readResponse(utility::outputStream& os, utility::progressListener* progress = NULL, const int predictedSize = 0);
 
+	int receive(char* buffer, const int count);
+
 	static bool checkTerminator(string& buffer, const bool multiLine);
 	static bool checkOneTerminator(string& buffer, const string& term);
 
@@ -27,7 +27,12 @@
 
 #include "vmime/types.hpp"
 
+#if VMIME_INTRUSIVE_REFCOUNT
+#	include "vmime/utility/smartPtrInt.hpp"
+#endif
 
+
+#include <cstddef>
 #include <vector>
 
 
@@ -45,6 +50,20 @@ class object
 	template <class T> friend class utility::weak_ref;
 
 	friend class utility::refManager;
+#if VMIME_INTRUSIVE_REFCOUNT
+	friend class utility::weakRefManagerImpl;
+#endif
+
+public:
+
+#ifndef VMIME_BUILDING_DOC
+
+	// Objects are allocated in the current arena, if any
+	// (see utility::arena)
+	static void* operator new(std::size_t size);
+	static void operator delete(void* ptr);
+
+#endif // VMIME_BUILDING_DOC
 
 protected:
 
@@ -89,10 +108,60 @@ protected:
 
 private:
 
+#ifndef VMIME_BUILDING_DOC
+
+	/** Add a strong reference to this object.
+	  */
+	void addStrongRef() const;
+
+	/** Release a strong reference to this object. If it is
+	  * the last reference, the object is destroyed.
+	  */
+	void releaseStrongRef() const;
+
+#endif // VMIME_BUILDING_DOC
+
+#if VMIME_INTRUSIVE_REFCOUNT
+
+	// The strong reference count is stored in the object itself;
+	// the manager is only created when a weak reference is taken
+	mutable utility::refCounter m_strongCount;
+	mutable utility::refManager* volatile m_refMgr;
+
+#else
+
 	mutable utility::refManager* m_refMgr;
+
+#endif // VMIME_INTRUSIVE_REFCOUNT
 };
 
 
+#ifndef VMIME_BUILDING_DOC
+
+#if VMIME_INTRUSIVE_REFCOUNT
+
+inline void object::addStrongRef() const
+{
+	m_strongCount.increment();
+}
+
+#else
+
+inline void object::addStrongRef() const
+{
+	m_refMgr->addStrong();
+}
+
+inline void object::releaseStrongRef() const
+{
+	m_refMgr->releaseStrong();
+}
+
+#endif // VMIME_INTRUSIVE_REFCOUNT
+
+#endif // VMIME_BUILDING_DOC
+
+
 } // vmime
 
 
@@ -48,16 +48,25 @@ protected:
 		friend class options;
 
 		messageOptions()
-			: m_maxLineLength(lineLengthLimits::convenient)
+			: m_maxLineLength(lineLengthLimits::convenient),
+			  m_arenaAllocation(false)
 		{
 		}
 
 		string::size_type m_maxLineLength;
+		bool m_arenaAllocation;
 
 	public:
 
 		const string::size_type& maxLineLength() const { return (m_maxLineLength); }
 		string::size_type& maxLineLength() { return (m_maxLineLength); }
+
+		/** If true, message::parse() allocates the components of the
+		  * message in a single utility::arena, which is released when
+		  * the last of them is destroyed.
+		  */
+		const bool& arenaAllocation() const { return (m_arenaAllocation); }
+		bool& arenaAllocation() { return (m_arenaAllocation); }
 	};
 
 	/** Multipart-related options.
@@ -82,6 +82,51 @@ private:
 
 
 
+/** Input stream over a read-only memory mapping of a whole file.
+  * The mapped contents can also be accessed directly with getData(),
+  * without going through read().
+  */
+
+class posixFileMappedReaderInputStream : public vmime::utility::inputStream
+{
+public:
+
+	posixFileMappedReaderInputStream(const vmime::utility::file::path& path, const int fd);
+	~posixFileMappedReaderInputStream();
+
+	bool eof() const;
+
+	void reset();
+
+	size_type read(value_type* const data, const size_type count);
+
+	size_type skip(const size_type count);
+
+	/** Return a pointer to the mapped file contents.
+	  *
+	  * @return mapped data, valid as long as this stream exists
+	  */
+	const value_type* getData() const;
+
+	/** Return the length of the mapped file contents.
+	  *
+	  * @return length of the file, in bytes
+	  */
+	size_type getLength() const;
+
+private:
+
+	const vmime::utility::file::path m_path;
+	const int m_fd;
+
+	value_type* m_data;
+	size_type m_length;
+
+	size_type m_pos;
+};
+
+
+
 class posixFileWriter : public vmime::utility::fileWriter
 {
 public:
@@ -114,6 +159,22 @@ private:
 
 
 
+class posixFileMappedReader : public vmime::utility::fileReader
+{
+public:
+
+	posixFileMappedReader(const vmime::utility::file::path& path, const vmime::string& nativePath);
+
+	ref <vmime::utility::inputStream> getInputStream();
+
+private:
+
+	vmime::utility::file::path m_path;
+	vmime::string m_nativePath;
+};
+
+
+
 class posixFileIterator : public vmime::utility::fileIterator
 {
 public:
@@ -167,6 +228,13 @@ public:
 	ref <vmime::utility::fileWriter> getFileWriter();
 	ref <vmime::utility::fileReader> getFileReader();
 
+	/** Return a reader whose input stream maps the whole file
+	  * in memory instead of issuing read() calls.
+	  *
+	  * @return mapped file reader
+	  */
+	ref <vmime::utility::fileReader> getMappedFileReader();
+
 	ref <vmime::utility::fileIterator> getFiles() const;
 
 private:
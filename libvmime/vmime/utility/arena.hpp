@@ -0,0 +1,155 @@
+//
+// VMime library (http://www.vmime.org)
+// Copyright (C) 2002-2009 Vincent Richard <vincent@vincent-richard.net>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// Linking this library statically or dynamically with other modules is making
+// a combined work based on this library.  Thus, the terms and conditions of
+// the GNU General Public License cover the whole combination.
+//
+
+#ifndef VMIME_UTILITY_ARENA_HPP_INCLUDED
+#define VMIME_UTILITY_ARENA_HPP_INCLUDED
+
+
+#include "vmime/utility/smartPtrInt.hpp"
+
+#include <cstddef>
+#include <vector>
+
+
+namespace vmime {
+namespace utility {
+
+
+/** Monotonic memory region for objects which are created together
+  * and released together, such as the components of a parsed message.
+  *
+  * While an arena::scope exists, every vmime::object (and its reference
+  * manager) created by the current thread is allocated in the scope's
+  * arena. Memory is not reused when an object is destroyed: the whole
+  * region is released when the last object allocated in it has been
+  * destroyed. Thus, holding a reference to any of these objects keeps
+  * the whole region alive.
+  */
+
+class arena
+{
+public:
+
+	class scope;
+
+	/** Keeps the memory of an arena from one scope to the next, for
+	  * code which repeatedly creates and drops the same kind of objects
+	  * (eg. parses one message after another).
+	  *
+	  * A scope created with a cache reuses the arena of the previous
+	  * one if all the objects allocated in it have been destroyed, or
+	  * starts a new arena otherwise. A cache must only be used by one
+	  * thread at a time.
+	  */
+	class cache
+	{
+	public:
+
+		cache();
+		~cache();
+
+	private:
+
+		cache(const cache&);
+		cache& operator=(const cache&);
+
+		arena* m_arena;
+
+		friend class scope;
+	};
+
+	/** Allocate objects created by the current thread in a new arena,
+	  * for the lifetime of this object. Scopes can be nested.
+	  */
+	class scope
+	{
+	public:
+
+		scope();
+
+		/** Allocate objects in the arena held by the specified cache.
+		  *
+		  * @param c arena cache, which must outlive this object
+		  */
+		explicit scope(cache& c);
+
+		~scope();
+
+	private:
+
+		scope(const scope&);
+		scope& operator=(const scope&);
+
+		arena* m_arena;
+		arena* m_previous;
+	};
+
+
+	/** Allocate memory in the current arena, or on the heap if
+	  * there is no current arena.
+	  *
+	  * @param size number of bytes to allocate
+	  * @return pointer to allocated memory
+	  */
+	static void* allocate(const std::size_t size);
+
+	/** Release memory obtained by allocate().
+	  *
+	  * @param ptr pointer returned by allocate(), or NULL
+	  */
+	static void deallocate(void* ptr);
+
+private:
+
+	arena();
+	~arena();
+
+	arena(const arena&);
+	arena& operator=(const arena&);
+
+	void* allocateBlock(const std::size_t size);
+	void release();
+
+	/** Make all the memory of the arena available again; must only be
+	  * called when no allocation is alive.
+	  */
+	void reset();
+
+
+	std::vector <char*> m_chunks;
+	char* m_pos;
+	std::size_t m_left;
+	std::size_t m_nextChunkSize;
+	std::size_t m_capacity;
+
+	// One reference for each allocation, plus one for the scope
+	// and one for the cache, if any
+	refCounter m_refs;
+};
+
+
+} // utility
+} // vmime
+
+
+#endif // VMIME_UTILITY_ARENA_HPP_INCLUDED
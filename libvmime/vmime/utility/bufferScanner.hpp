@@ -0,0 +1,93 @@
+//
+// VMime library (http://www.vmime.org)
+// Copyright (C) 2002-2009 Vincent Richard <vincent@vincent-richard.net>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// Linking this library statically or dynamically with other modules is making
+// a combined work based on this library.  Thus, the terms and conditions of
+// the GNU General Public License cover the whole combination.
+//
+
+#ifndef VMIME_UTILITY_BUFFERSCANNER_HPP_INCLUDED
+#define VMIME_UTILITY_BUFFERSCANNER_HPP_INCLUDED
+
+
+#include "vmime/types.hpp"
+
+#include <vector>
+
+
+namespace vmime {
+namespace utility {
+
+
+/** Fast search functions over a raw buffer. Vectorized versions
+  * (SSE2, AVX2) are selected at run-time when the processor supports
+  * them; the results are the same as with the scalar version.
+  */
+
+class bufferScanner
+{
+public:
+
+	/** Find all the occurrences of a string in a buffer, in a single
+	  * pass. Overlapping occurrences are all reported.
+	  *
+	  * @param buffer buffer to search
+	  * @param needle string to search for
+	  * @param start position in the buffer at which to start the search
+	  * @param end end position in the buffer; only occurrences which
+	  * fit entirely before this position are reported
+	  * @param positions will receive the positions of the occurrences,
+	  * in increasing order (the vector is not cleared)
+	  */
+	static void findAll(const string& buffer, const string& needle,
+		const string::size_type start, const string::size_type end,
+		std::vector <string::size_type>& positions);
+
+	/** Find the first non-ASCII byte (ie. with the high bit set)
+	  * in a buffer.
+	  *
+	  * @param data pointer to the data
+	  * @param length number of bytes to scan
+	  * @return position of the first non-ASCII byte, or 'length'
+	  * if all the bytes are ASCII
+	  */
+	static string::size_type findNonASCII(const char* data, const string::size_type length);
+
+	/** Copy bytes from a buffer until either of two characters
+	  * is found. Pass the same character twice to stop on only one
+	  * character.
+	  *
+	  * @param data pointer to the data
+	  * @param length number of bytes to scan
+	  * @param c1 first character to stop on
+	  * @param c2 second character to stop on
+	  * @param out output buffer, which must have room for 'length'
+	  * bytes; the bytes after the copied ones may be overwritten
+	  * @return number of bytes copied, ie. the position of the first
+	  * byte equal to 'c1' or 'c2', or 'length' if there is none
+	  */
+	static string::size_type copyUntil(const char* data, const string::size_type length,
+		const char c1, const char c2, char* out);
+};
+
+
+} // utility
+} // vmime
+
+
+#endif // VMIME_UTILITY_BUFFERSCANNER_HPP_INCLUDED
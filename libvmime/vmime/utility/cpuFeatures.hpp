@@ -0,0 +1,101 @@
+//
+// VMime library (http://www.vmime.org)
+// Copyright (C) 2002-2009 Vincent Richard <vincent@vincent-richard.net>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// Linking this library statically or dynamically with other modules is making
+// a combined work based on this library.  Thus, the terms and conditions of
+// the GNU General Public License cover the whole combination.
+//
+
+#ifndef VMIME_UTILITY_CPUFEATURES_HPP_INCLUDED
+#define VMIME_UTILITY_CPUFEATURES_HPP_INCLUDED
+
+
+#include "vmime/types.hpp"
+
+
+// SSE2 is part of the x86-64 base instruction set: it can be used
+// without run-time detection whenever the compiler targets it.
+#if defined(__GNUC__) && defined(__SSE2__)
+	#define VMIME_HAVE_SSE2_INTRINSICS 1
+#else
+	#define VMIME_HAVE_SSE2_INTRINSICS 0
+#endif
+
+// SSSE3 and AVX2 code is compiled per-function with the 'target'
+// attribute and only called after run-time detection. It falls back
+// on the SSE2 code for the end of the buffers, so it requires it.
+#if VMIME_HAVE_SSE2_INTRINSICS && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+	#define VMIME_HAVE_SSSE3_INTRINSICS 1
+	#define VMIME_HAVE_AVX2_INTRINSICS 1
+#else
+	#define VMIME_HAVE_SSSE3_INTRINSICS 0
+	#define VMIME_HAVE_AVX2_INTRINSICS 0
+#endif
+
+
+namespace vmime {
+namespace utility {
+
+
+/** Run-time detection of the SIMD instruction sets supported by
+  * the processor (and enabled by the operating system).
+  */
+
+class cpuFeatures
+{
+public:
+
+	/** Test whether SSE2 instructions are available.
+	  *
+	  * @return true if SSE2 can be used, false otherwise
+	  */
+	static bool hasSSE2();
+
+	/** Test whether SSSE3 instructions are available.
+	  *
+	  * @return true if SSSE3 can be used, false otherwise
+	  */
+	static bool hasSSSE3();
+
+	/** Test whether AVX2 instructions are available.
+	  *
+	  * @return true if AVX2 can be used, false otherwise
+	  */
+	static bool hasAVX2();
+
+private:
+
+	struct features
+	{
+		features();
+
+		bool sse2;
+		bool ssse3;
+		bool avx2;
+	};
+
+	static const features& getFeatures();
+};
+
+
+} // utility
+} // vmime
+
+
+#endif // VMIME_UTILITY_CPUFEATURES_HPP_INCLUDED
@@ -33,7 +33,8 @@ namespace utility {
 namespace encoder {
 
 
-/** Base64 encoder.
+/** Base64 encoder. Vectorized versions of the codec (SSSE3, AVX2)
+  * are selected at run-time when the processor supports them.
   */
 
 class b64Encoder : public encoder
@@ -47,6 +48,27 @@ public:
 
 	const std::vector <string> getAvailableProperties() const;
 
+	/** Encode a buffer in memory, without going through streams.
+	  * The result is the same as with encode().
+	  *
+	  * @param data pointer to the data to encode
+	  * @param length length of the data
+	  * @param out string to which the encoded data is appended
+	  * @param maxLineLength value of the "maxlinelength" property,
+	  * or -1 to not cut lines
+	  */
+	static void encodeBuffer(const char* data, const string::size_type length,
+		string& out, const int maxLineLength = -1);
+
+	/** Decode a buffer in memory, without going through streams.
+	  * The result is the same as with decode().
+	  *
+	  * @param data pointer to the encoded data
+	  * @param length length of the encoded data
+	  * @param out string to which the decoded bytes are appended
+	  */
+	static void decodeBuffer(const char* data, const string::size_type length, string& out);
+
 protected:
 
 	static const unsigned char sm_alphabet[];
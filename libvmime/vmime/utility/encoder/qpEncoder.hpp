@@ -50,6 +50,18 @@ public:
 	static bool RFC2047_isEncodingNeededForChar(const unsigned char c);
 	static int RFC2047_getEncodedLength(const unsigned char c);
 
+	/** Decode a buffer in memory, without going through streams.
+	  * The result is the same as with decode().
+	  *
+	  * @param data pointer to the encoded data
+	  * @param length length of the encoded data
+	  * @param out string to which the decoded bytes are appended
+	  * @param rfc2047 value of the "rfc2047" property: if true, '_'
+	  * is decoded as a space
+	  */
+	static void decodeBuffer(const char* data, const string::size_type length,
+		string& out, const bool rfc2047);
+
 protected:
 
 	static const unsigned char sm_hexDigits[17];
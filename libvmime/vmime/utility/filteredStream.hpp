@@ -127,6 +127,61 @@ private:
 };
 
 
+/** A filtered output stream which decodes dot-stuffed multi-line
+  * data (RFC 1939): lines starting with ".." are written without their
+  * first dot, and data stops at the terminating "." line. The line
+  * break which precedes the terminator is not written.
+  *
+  * Data is written to the next stream in contiguous spans, in a single
+  * pass; only the few bytes which may belong to the terminator are
+  * kept from one call to write() to the next.
+  */
+
+class dotUnstuffingFilteredOutputStream : public filteredOutputStream
+{
+public:
+
+	/** Construct a new filter for the specified output stream.
+	  *
+	  * @param os stream into which write filtered data
+	  */
+	dotUnstuffingFilteredOutputStream(outputStream& os);
+
+	outputStream& getNextOutputStream();
+
+	/** Write data to the filter. Data following the terminator
+	  * is ignored.
+	  */
+	void write(const value_type* const data, const size_type count);
+	void flush();
+
+	/** Return whether the terminating "." line has been written.
+	  *
+	  * @return true if the end of data has been reached, or false otherwise
+	  */
+	bool isTerminated() const;
+
+private:
+
+	enum States
+	{
+		STATE_LINE,            // inside a line
+		STATE_CR,              // inside a line, after a CR
+		STATE_LINE_START,      // at the beginning of a line
+		STATE_DOT,             // after a dot at the beginning of a line
+		STATE_DOT_CR,          // after a dot and a CR at the beginning of a line
+		STATE_TERMINATED       // after the terminator
+	};
+
+	outputStream& m_stream;
+	States m_state;
+
+	// Bytes from previous calls which are not written yet, because
+	// they may be part of the terminator or a stuffed dot
+	string m_held;
+};
+
+
 /** A filtered output stream which replaces CRLF sequences
   * with single LF characters.
   */
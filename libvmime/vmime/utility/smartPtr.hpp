@@ -25,6 +25,7 @@
 #define VMIME_UTILITY_SMARTPTR_HPP_INCLUDED
 
 
+#include <cstddef>
 #include <map>
 
 
@@ -71,6 +72,15 @@ public:
 
 	virtual ~refManager() {}
 
+#ifndef VMIME_BUILDING_DOC
+
+	// Managers are allocated in the same arena as their
+	// object (see utility::arena)
+	static void* operator new(std::size_t size);
+	static void operator delete(void* ptr);
+
+#endif // VMIME_BUILDING_DOC
+
 	/** Create a ref manager for the specified object.
 	  *
 	  * @return a new manager
@@ -180,7 +190,7 @@ public:
 		if (!p) return ref <U>();
 
 		if (m_ptr)
-			m_ptr->getRefManager()->addStrong();
+			m_ptr->addStrongRef();
 
 		return ref <U>::fromPtrImpl(p);
 	}
@@ -193,7 +203,7 @@ public:
 		if (!p) return ref <U>();
 
 		if (m_ptr)
-			m_ptr->getRefManager()->addStrong();
+			m_ptr->addStrongRef();
 
 		return ref <U>::fromPtrImpl(p);
 	}
@@ -206,7 +216,7 @@ public:
 		if (!p) return ref <U>();
 
 		if (m_ptr)
-			m_ptr->getRefManager()->addStrong();
+			m_ptr->addStrongRef();
 
 		return ref <U>::fromPtrImpl(p);
 	}
@@ -216,7 +226,7 @@ public:
 	operator ref <const U>() const
 	{
 		if (m_ptr)
-			m_ptr->getRefManager()->addStrong();
+			m_ptr->addStrongRef();
 
 		ref <const U> r;
 		r.m_ptr = m_ptr; // will type check at compile-time (prevent from implicit upcast)
@@ -228,7 +238,7 @@ public:
 	operator ref <U>()
 	{
 		if (m_ptr)
-			m_ptr->getRefManager()->addStrong();
+			m_ptr->addStrongRef();
 
 		ref <U> r;
 		r.m_ptr = m_ptr; // will type check at compile-time (prevent from implicit upcast)
@@ -242,7 +252,7 @@ public:
 		U* ptr = other.m_ptr;   // will type check at compile-time (prevent from implicit upcast)
 
 		if (ptr)
-			ptr->getRefManager()->addStrong();
+			ptr->addStrongRef();
 
 		detach();
 
@@ -255,7 +265,7 @@ public:
 	operator ref <const T>() const
 	{
 		if (m_ptr)
-			m_ptr->getRefManager()->addStrong();
+			m_ptr->addStrongRef();
 
 #if defined(_MSC_VER) // VC++ compiler bug (stack overflow)
 		ref <const T> r;
@@ -338,7 +348,7 @@ protected:
 	{
 		if (m_ptr)
 		{
-			m_ptr->getRefManager()->releaseStrong();
+			m_ptr->releaseStrongRef();
 			m_ptr = 0;
 		}
 	}
@@ -347,7 +357,7 @@ protected:
 	void attach(U* const ptr)
 	{
 		if (ptr)
-			ptr->getRefManager()->addStrong();
+			ptr->addStrongRef();
 
 		detach();
 
@@ -358,7 +368,7 @@ protected:
 	void attach(const ref <U>& r)
 	{
 		if (r.m_ptr)
-			r.m_ptr->getRefManager()->addStrong();
+			r.m_ptr->addStrongRef();
 
 		detach();
 
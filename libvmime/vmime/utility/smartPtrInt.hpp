@@ -99,6 +99,57 @@ private:
 };
 
 
+#if VMIME_INTRUSIVE_REFCOUNT
+
+
+/** Weak reference manager used with intrusive reference counting:
+  * the strong count is stored in the object itself, and this manager
+  * only exists once a weak reference to the object has been taken.
+  */
+
+class weakRefManagerImpl : public refManager
+{
+public:
+
+	weakRefManagerImpl(object* obj);
+	~weakRefManagerImpl();
+
+	/** Return the manager attached to the specified object,
+	  * creating it if needed.
+	  *
+	  * @param obj object
+	  * @param mgr manager slot in the object
+	  * @return manager for the object
+	  */
+	static refManager* getOrCreate(object* obj, refManager* volatile* mgr);
+
+	/** Called when the managed object is destroyed: weak
+	  * references to it will then point to NULL.
+	  */
+	void detachObject();
+
+	bool addStrong();
+	void releaseStrong();
+
+	void addWeak();
+	void releaseWeak();
+
+	object* getObject();
+
+	long getStrongRefCount() const;
+	long getWeakRefCount() const;
+
+private:
+
+	object* volatile m_object;
+
+	refCounter m_weakCount;
+};
+
+
+#endif // VMIME_INTRUSIVE_REFCOUNT
+
+
 } // utility
 } // vmime
 
@@ -71,6 +71,7 @@
 // Message builder/parser
 #include "vmime/messageBuilder.hpp"
 #include "vmime/messageParser.hpp"
+#include "vmime/incrementalParser.hpp"
 
 #include "vmime/fileAttachment.hpp"
 #include "vmime/defaultAttachment.hpp"
@@ -1,37 +1,176 @@
 #include <string>
+#include <vector>
 #include <iostream>
 #include <fstream>
 
 #include <vmime/vmime.hpp>
 #include <vmime/platforms/posix/posixHandler.hpp>
+#include <vmime/utility/arena.hpp>
+#include <vmime/contentTypeField.hpp>
 
 #include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "mailparse.h"
 
 using namespace std;
 
 
-vmime::ref <vmime::message> init_mimeparse(char *email_file)
+// Length of the data the parser needs to see: the whole message, or only
+// the header block (up to and including the empty separator line) when no
+// body data was requested.
+size_t get_parse_length(const char *data, size_t len, int parse_mask)
+{
+	if (parse_mask & MAILPARSE_TEXT_PARTS) {
+		return len;
+	}
+
+	size_t pos = 0;
+	while (pos < len) {
+		if (data[pos] == '\n') {
+			return pos + 1;
+		} else if (data[pos] == '\r' && pos + 1 < len && data[pos + 1] == '\n') {
+			return pos + 2;
+		}
+
+		const char *eol = (const char *)memchr(data + pos, '\n', len - pos);
+		if (eol == NULL) {
+			break;
+		}
+
+		pos = eol - data + 1;
+	}
+
+	return len;
+}
+
+
+void parse_message(vmime::ref <vmime::message> msg, const vmime::string &data, int parse_mask)
+{
+	if (parse_mask & MAILPARSE_TEXT_PARTS) {
+		msg->parse(data);
+	} else {
+		// headers only: the body is never parsed
+		msg->getHeader()->parse(data);
+	}
+}
+
+
+vmime::ref <vmime::message> parse_mime_data(const vmime::string &data, int parse_mask)
+{
+	// all the objects of the message come from one memory region,
+	// released at once when the message is dropped
+	vmime::utility::arena::scope arena_scope;
+
+	vmime::ref <vmime::message> msg = vmime::create <vmime::message>();
+	parse_message(msg, data, parse_mask);
+
+	return msg;
+}
+
+
+// Read the part of a message file the parser needs into 'data', which
+// keeps its storage from one message to the next.
+//
+// The parser works on a vmime::string, so the file is read straight into
+// it instead of being mapped and copied: there is a single copy of the
+// message in memory, and pipes or character devices work too.
+bool read_mime_file(const char *email_file, int parse_mask, vmime::string &data)
+{
+	int fd = open(email_file, O_RDONLY);
+	if (fd == -1) {
+		return false;
+	}
+
+	const size_t chunk_size = 65536;
+
+	// whole regular file wanted: size the buffer once, so that the
+	// first read gets everything and the next one sees end-of-file
+	size_t want = chunk_size;
+	struct stat st;
+	if ((parse_mask & MAILPARSE_TEXT_PARTS) && fstat(fd, &st) == 0
+			&& S_ISREG(st.st_mode) && st.st_size > 0) {
+		want = (size_t)st.st_size + 1;
+	}
+
+	data.clear();
+
+	size_t len = 0;
+	for (;;) {
+		data.resize(len + want);
+
+		ssize_t n = read(fd, &data[len], want);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			close(fd);
+			data.clear();
+			return false;
+		}
+
+		if (n == 0) {
+			break;
+		}
+
+		len += n;
+		want = chunk_size;
+
+		// headers only: stop as soon as the header block is complete
+		if (!(parse_mask & MAILPARSE_TEXT_PARTS)
+				&& get_parse_length(data.data(), len, parse_mask) < len) {
+			break;
+		}
+	}
+
+	close(fd);
+
+	data.resize(get_parse_length(data.data(), len, parse_mask));
+
+	return true;
+}
+
+
+vmime::ref <vmime::message> init_mimeparse(char *email_file, int parse_mask)
 {
 	try {
 		// set platform
 		vmime::platform::setHandler<vmime::platforms::posix::posixHandler>();
 
-		std::ifstream file;
-		file.open(email_file, std::ios::in | std::ios::binary);
+		vmime::string data;
+		if (!read_mime_file(email_file, parse_mask, data)) {
+			return NULL;
+		}
 
-		vmime::utility::inputStreamAdapter is(file);
+		// Actually parse the message
+		return parse_mime_data(data, parse_mask);
+	} catch (vmime::exception &e) {
+		// std::cerr << e;
+	} catch (std::exception &e) {
+		// std::cerr << e.what();
+	}
 
-		vmime::string data;
-		vmime::utility::outputStreamStringAdapter os(data);
+	return NULL;
+}
 
-		vmime::utility::bufferedStreamCopy(is, os);
 
-		// Actually parse the message
-		vmime::ref <vmime::message> msg = vmime::create <vmime::message>();
-		msg->parse(data);
-	
-		return msg;
+vmime::ref <vmime::message> init_mimeparse_for_buffer(const char *data, size_t len, int parse_mask)
+{
+	try {
+		// set platform
+		vmime::platform::setHandler<vmime::platforms::posix::posixHandler>();
+
+		// The parser works on a vmime::string: fill it with a single
+		// copy of the caller's memory, sized up front
+		vmime::string buffer(data, get_parse_length(data, len, parse_mask));
+
+		return parse_mime_data(buffer, parse_mask);
 	} catch (vmime::exception &e) {
 		// std::cerr << e;
 	} catch (std::exception &e) {
@@ -116,56 +255,271 @@ string get_header_for_name(vmime::ref <vmime::header> hdr, string name)
 }
 
 
-string get_parsed_body(vmime::ref <vmime::message> msg)
+// Thrown to stop parsing when a caller's callback asks for it
+class sink_stopped : public std::exception
 {
-	try {
-		vmime::messageParser mp(msg);
+};
+
+
+// Passes the body straight to the caller's sink
+class body_sink_output_stream : public vmime::utility::outputStream
+{
+public:
+	body_sink_output_stream(mailparse_body_sink sink, void *arg)
+		: m_sink(sink), m_arg(arg)
+	{
+	}
+
+	void write(const value_type* const data, const size_type count)
+	{
+		if (count != 0 && m_sink(data, count, m_arg) != 0) {
+			throw sink_stopped();
+		}
+	}
+
+	void flush()
+	{
+	}
+
+private:
+	mailparse_body_sink m_sink;
+	void *m_arg;
+};
 
-		string parsed_body;
-
-		for (int i=0; i< mp.getTextPartCount(); ++i) {
-			vmime::ref<const vmime::textPart> tp = mp.getTextPartAt(i);
-
-			// text/html
-			if (tp->getType().getSubType() == vmime::mediaTypes::TEXT_HTML) {
-				vmime::ref<const vmime::htmlTextPart> htp = 
-					tp.dynamicCast<const vmime::htmlTextPart>();
-
-				//std::cout << "Length: " << htp->getText()->getLength() << std::endl;
-
-				// HTML text is in tp->getText()
-				// Plain text is in tp->getPlainText()
-		   
-				vmime::string htmlContents;
-				vmime::utility::outputStreamStringAdapter htmlOut(htmlContents);
-				vmime::utility::charsetFilteredOutputStream utf8Out(htp->getCharset(), vmime::charset("utf-8"), htmlOut); // 强制转换正文为utf8编码
-				htp->getText()->extract(utf8Out);
-				utf8Out.flush();
-
-				// append parsed_body
-				parsed_body += htmlContents;
-			} else if (tp->getType().getSubType() == vmime::mediaTypes::TEXT_PLAIN) {
-				vmime::ref<const vmime::plainTextPart> ptp =
-					tp.dynamicCast<const vmime::plainTextPart>();
-
-				vmime::string plainTextContent;
-				vmime::utility::outputStreamStringAdapter plainOut(plainTextContent);
-				vmime::utility::charsetFilteredOutputStream utf8Out(ptp->getCharset(), vmime::charset("utf-8"), plainOut);
-				ptp->getText()->extract(utf8Out);
-				utf8Out.flush();
-
-				parsed_body += plainTextContent;
-			} else {
-				// nothing to do
+
+// Collects the body directly into the buffer handed to the caller (released
+// with free() by clean_parse)
+class body_buffer_output_stream : public vmime::utility::outputStream
+{
+public:
+	body_buffer_output_stream(struct parsed_string_t *body)
+		: m_body(body), m_capacity(0)
+	{
+	}
+
+	void write(const value_type* const data, const size_type count)
+	{
+		if (count == 0) {
+			return;
+		}
+
+		// keep room for the terminating NUL
+		size_t needed = m_body->len + count + 1;
+		if (needed > m_capacity) {
+			size_t capacity = (m_capacity == 0 ? 4096 : m_capacity);
+			while (capacity < needed) {
+				capacity *= 2;
+			}
+
+			char *pdata = (char *)realloc(m_body->pdata, capacity);
+			if (pdata == NULL) {
+				throw std::bad_alloc();
 			}
+
+			m_body->pdata = pdata;
+			m_capacity = capacity;
 		}
 
-		return parsed_body;
-	} catch (vmime::exception &e) {
-	} catch (std::exception &e) {
-	} 
+		memcpy(m_body->pdata + m_body->len, data, count);
+		m_body->len += count;
+		m_body->pdata[m_body->len] = '\0';
+	}
 
-	return "";
+	void flush()
+	{
+	}
+
+private:
+	struct parsed_string_t *m_body;
+	size_t m_capacity;
+};
+
+
+// Write the text/plain and text/html parts to 'out': each part is transfer
+// decoded and converted to UTF-8 on the way, without intermediate copies.
+void write_parsed_body(vmime::ref <vmime::message> msg, vmime::utility::outputStream &out)
+{
+	vmime::messageParser mp(msg);
+
+	for (int i=0; i< mp.getTextPartCount(); ++i) {
+		vmime::ref<const vmime::textPart> tp = mp.getTextPartAt(i);
+
+		// HTML text is in tp->getText()
+		// Plain text is in tp->getPlainText()
+		if (tp->getType().getSubType() == vmime::mediaTypes::TEXT_HTML
+			|| tp->getType().getSubType() == vmime::mediaTypes::TEXT_PLAIN) {
+
+			vmime::utility::charsetFilteredOutputStream utf8Out(tp->getCharset(), vmime::charset("utf-8"), out); // 强制转换正文为utf8编码
+
+			tp->getText()->extract(utf8Out);
+			utf8Out.flush();
+		} else {
+			// nothing to do
+		}
+	}
+}
+
+
+// Passes a text part to the caller's on_text_part callback
+class text_part_output_stream : public vmime::utility::outputStream
+{
+public:
+	text_part_output_stream(const struct mailparse_callbacks_s *callbacks,
+		const string &mime_type, const string &charset)
+		: m_callbacks(callbacks), m_mime_type(mime_type), m_charset(charset)
+	{
+	}
+
+	void write(const value_type* const data, const size_type count)
+	{
+		if (count != 0 && m_callbacks->on_text_part(m_mime_type.c_str(),
+				m_charset.c_str(), data, count, m_callbacks->arg) != 0) {
+			throw sink_stopped();
+		}
+	}
+
+	void flush()
+	{
+	}
+
+private:
+	const struct mailparse_callbacks_s *m_callbacks;
+	const string &m_mime_type;
+	const string &m_charset;
+};
+
+
+void emit_header_events(vmime::ref <const vmime::header> hdr, const struct mailparse_callbacks_s *callbacks)
+{
+	vmime::charset ch(vmime::charsets::UTF_8);
+
+	for (int i = 0; i < hdr->getFieldCount(); ++i) {
+		vmime::ref <const vmime::headerField> field = hdr->getFieldAt(i);
+		vmime::ref <const vmime::text> text = field->getValue().dynamicCast <const vmime::text>();
+		const string name = field->getName();
+
+		// unstructured fields are decoded, the others are given as they
+		// would be written (with their parameters), on one line
+		const string value = (text != NULL ? text->getConvertedText(ch)
+			: field->generate().substr(name.length() + 2));
+
+		if (callbacks->on_header(name.c_str(), value.c_str(), value.length(), callbacks->arg) != 0) {
+			throw sink_stopped();
+		}
+	}
+}
+
+
+// Media type and charset declared by the header of a part; without any
+// Content-Type field, the part is text/plain
+void get_part_type(vmime::ref <const vmime::header> hdr, vmime::mediaType &type, vmime::charset &charset)
+{
+	type = vmime::mediaType(vmime::mediaTypes::TEXT, vmime::mediaTypes::TEXT_PLAIN);
+
+	if (hdr->hasField(vmime::fields::CONTENT_TYPE)) {
+		vmime::ref <const vmime::contentTypeField> ctf =
+			hdr->findField(vmime::fields::CONTENT_TYPE).dynamicCast <const vmime::contentTypeField>();
+
+		type = *ctf->getValue().dynamicCast <const vmime::mediaType>();
+
+		if (ctf->hasParameter("charset")) {
+			charset = ctf->getCharset();
+		}
+	}
+}
+
+
+bool is_text_part_type(const vmime::mediaType &type)
+{
+	return type.getType() == vmime::mediaTypes::TEXT
+		&& (type.getSubType() == vmime::mediaTypes::TEXT_PLAIN
+			|| type.getSubType() == vmime::mediaTypes::TEXT_HTML);
+}
+
+
+void emit_part_events(vmime::ref <const vmime::bodyPart> part, const struct mailparse_callbacks_s *callbacks)
+{
+	if (vmime::attachmentHelper::isBodyPartAnAttachment(part)) {
+		if (callbacks->on_attachment_begin == NULL
+			&& callbacks->on_attachment_chunk == NULL
+			&& callbacks->on_attachment_end == NULL) {
+			return;
+		}
+
+		vmime::ref <const vmime::attachment> att = vmime::attachmentHelper::getBodyPartAttachment(part);
+
+		if (callbacks->on_attachment_begin != NULL) {
+			const string mime_type = att->getType().generate();
+			const string filename = att->getName().getConvertedText(vmime::charset(vmime::charsets::UTF_8));
+
+			if (callbacks->on_attachment_begin(mime_type.c_str(), filename.c_str(), callbacks->arg) != 0) {
+				throw sink_stopped();
+			}
+		}
+
+		if (callbacks->on_attachment_chunk != NULL) {
+			body_sink_output_stream out(callbacks->on_attachment_chunk, callbacks->arg);
+			att->getData()->extract(out);
+		}
+
+		if (callbacks->on_attachment_end != NULL && callbacks->on_attachment_end(callbacks->arg) != 0) {
+			throw sink_stopped();
+		}
+
+		return;
+	}
+
+	vmime::ref <const vmime::body> body = part->getBody();
+
+	if (body->getPartCount() != 0) {
+		for (int i = 0; i < body->getPartCount(); ++i) {
+			emit_part_events(body->getPartAt(i), callbacks);
+		}
+
+		return;
+	}
+
+	if (callbacks->on_text_part == NULL) {
+		return;
+	}
+
+	vmime::mediaType type;
+	vmime::charset charset;
+	get_part_type(part->getHeader(), type, charset);
+
+	if (!is_text_part_type(type)) {
+		return;
+	}
+
+	const string mime_type = type.generate();
+	const string &charset_name = charset.getName();
+
+	text_part_output_stream out(callbacks, mime_type, charset_name);
+	vmime::utility::charsetFilteredOutputStream utf8Out(charset, vmime::charset("utf-8"), out);
+
+	body->getContents()->extract(utf8Out);
+	utf8Out.flush();
+
+	// end of the part
+	if (callbacks->on_text_part(mime_type.c_str(), charset_name.c_str(), "", 0, callbacks->arg) != 0) {
+		throw sink_stopped();
+	}
+}
+
+
+// Without any body callback, only the header block has to be parsed
+int get_callbacks_parse_mask(const struct mailparse_callbacks_s *callbacks)
+{
+	if (callbacks->on_text_part == NULL
+		&& callbacks->on_attachment_begin == NULL
+		&& callbacks->on_attachment_chunk == NULL
+		&& callbacks->on_attachment_end == NULL
+		&& callbacks->on_part_begin == NULL
+		&& callbacks->on_part_end == NULL) {
+		return MAILPARSE_HEADERS;
+	}
+
+	return MAILPARSE_ALL;
 }
 
 
@@ -186,8 +540,29 @@ void init_parse(struct parsed_message_info_s *parsed_mail_info)
 	parsed_mail_info->header_subject.len = 0;	
 	parsed_mail_info->header_subject.pdata = NULL;	
 
+	parsed_mail_info->header_spf.len = 0;
+	parsed_mail_info->header_spf.pdata = NULL;
+
 	parsed_mail_info->body.len = 0;	
 	parsed_mail_info->body.pdata = NULL;	
+
+	parsed_mail_info->parse_mask = MAILPARSE_ALL;
+
+	parsed_mail_info->body_sink = NULL;
+	parsed_mail_info->body_sink_arg = NULL;
+}
+
+
+void init_parse_callbacks(struct mailparse_callbacks_s *callbacks)
+{
+	callbacks->on_header = NULL;
+	callbacks->on_text_part = NULL;
+	callbacks->on_attachment_begin = NULL;
+	callbacks->on_attachment_chunk = NULL;
+	callbacks->on_attachment_end = NULL;
+	callbacks->on_part_begin = NULL;
+	callbacks->on_part_end = NULL;
+	callbacks->arg = NULL;
 }
 
 
@@ -228,6 +603,13 @@ void clean_parse(struct parsed_message_info_s *parsed_mail_info)
         parsed_mail_info->header_subject.len = 0;
     }  
 
+    if (parsed_mail_info->header_spf.pdata != NULL) {
+        free(parsed_mail_info->header_spf.pdata);
+        parsed_mail_info->header_spf.pdata = NULL;
+
+        parsed_mail_info->header_spf.len = 0;
+    }
+
     if (parsed_mail_info->body.pdata != NULL) {
         free(parsed_mail_info->body.pdata);
         parsed_mail_info->body.pdata = NULL;
@@ -236,15 +618,8 @@ void clean_parse(struct parsed_message_info_s *parsed_mail_info)
     }  
 }
 
-int parse_mail_for_file(char *email, struct parsed_message_info_s *parsed_mail_info)
+void fill_parsed_header_info(vmime::ref <vmime::header> hdr, struct parsed_message_info_s *parsed_mail_info)
 {
-	vmime::ref <vmime::message> msg = init_mimeparse(email);	
-	if (msg == NULL) {
-		return 1;
-	}
-
-	vmime::ref <vmime::header> hdr = msg->getHeader();
-
 	// get header from, to, cc, bcc ------------------------
 	string from = get_header_for_name(hdr, "from");
 	if (from.length() > 0) {
@@ -312,18 +687,731 @@ int parse_mail_for_file(char *email, struct parsed_message_info_s *parsed_mail_i
 		}
 	}
 
-	// get body ----------------------
-	string body = get_parsed_body(msg);
-	if (body.length() > 0) {
-		parsed_mail_info->body.pdata = (char *)calloc(1, body.length() + 1);
-		if (parsed_mail_info->body.pdata != NULL) {
-			parsed_mail_info->body.len = body.length();
+}
+
 
-			memcpy(parsed_mail_info->body.pdata, body.c_str(), parsed_mail_info->body.len);
-			parsed_mail_info->body.pdata[parsed_mail_info->body.len] = '\0';
+int fill_parsed_message_info(vmime::ref <vmime::message> msg, struct parsed_message_info_s *parsed_mail_info)
+{
+	if (parsed_mail_info->parse_mask & MAILPARSE_HEADERS) {
+		fill_parsed_header_info(msg->getHeader(), parsed_mail_info);
+	}
+
+	if (!(parsed_mail_info->parse_mask & MAILPARSE_TEXT_PARTS)) {
+		return 0;
+	}
+
+	// get body ----------------------
+	if (parsed_mail_info->body_sink != NULL) {
+		try {
+			body_sink_output_stream out(parsed_mail_info->body_sink, parsed_mail_info->body_sink_arg);
+			write_parsed_body(msg, out);
+		} catch (vmime::exception &e) {
+		} catch (std::exception &e) {
+			// includes sink_stopped
 		}
+
+		return 0;
+	}
+
+	try {
+		body_buffer_output_stream out(&parsed_mail_info->body);
+		write_parsed_body(msg, out);
+	} catch (vmime::exception &e) {
+		// no partial body
+		free(parsed_mail_info->body.pdata);
+		parsed_mail_info->body.pdata = NULL;
+		parsed_mail_info->body.len = 0;
+	} catch (std::exception &e) {
+		free(parsed_mail_info->body.pdata);
+		parsed_mail_info->body.pdata = NULL;
+		parsed_mail_info->body.len = 0;
 	}
 
 	return 0;
 }
 
+
+int parse_mail_for_file(char *email, struct parsed_message_info_s *parsed_mail_info)
+{
+	vmime::ref <vmime::message> msg = init_mimeparse(email, parsed_mail_info->parse_mask);	
+	if (msg == NULL) {
+		return 1;
+	}
+
+	return fill_parsed_message_info(msg, parsed_mail_info);
+}
+
+
+int parse_mail_for_buffer(const char *data, size_t len, struct parsed_message_info_s *parsed_mail_info)
+{
+	vmime::ref <vmime::message> msg = init_mimeparse_for_buffer(data, len, parsed_mail_info->parse_mask);
+	if (msg == NULL) {
+		return 1;
+	}
+
+	return fill_parsed_message_info(msg, parsed_mail_info);
+}
+
+
+int parse_mail_for_fd(int fd, struct parsed_message_info_s *parsed_mail_info)
+{
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		return 1;
+	}
+
+	// empty file: nothing to map
+	if (st.st_size == 0) {
+		return parse_mail_for_buffer("", 0, parsed_mail_info);
+	}
+
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		return 1;
+	}
+
+	// the whole mapping is read once, front to back
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	int ret = parse_mail_for_buffer((const char *)map, st.st_size, parsed_mail_info);
+
+	munmap(map, st.st_size);
+
+	return ret;
+}
+
+
+// State kept from one message to the next by parse_mail_for_file_ctx()
+struct mailparse_ctx_s
+{
+	// file contents
+	vmime::string data;
+
+	// memory region of the parsed message and of the objects built from
+	// it, reused once they have all been released
+	vmime::utility::arena::cache arena;
+
+	// charset conversion descriptors, taken back by the next message
+	// without locking the shared pool
+	vmime::charsetConverter::cache converters;
+};
+
+
+mailparse_ctx *mailparse_ctx_create(void)
+{
+	try {
+		// set platform, once for all the messages
+		vmime::platform::setHandler<vmime::platforms::posix::posixHandler>();
+
+		return new mailparse_ctx;
+	} catch (std::exception &e) {
+	}
+
+	return NULL;
+}
+
+
+void mailparse_ctx_reset(mailparse_ctx *ctx)
+{
+	if (ctx == NULL) {
+		return;
+	}
+
+	// drop the contents, keep the storage
+	ctx->data.erase();
+}
+
+
+void mailparse_ctx_destroy(mailparse_ctx *ctx)
+{
+	delete ctx;
+}
+
+
+int parse_mail_for_file_ctx(mailparse_ctx *ctx, char *email, struct parsed_message_info_s *parsed_mail_info)
+{
+	if (ctx == NULL) {
+		return parse_mail_for_file(email, parsed_mail_info);
+	}
+
+	try {
+		if (!read_mime_file(email, parsed_mail_info->parse_mask, ctx->data)) {
+			return 1;
+		}
+
+		// the message and the text parts extracted from it are released
+		// when returning, so the next message reuses their memory
+		vmime::utility::arena::scope arena_scope(ctx->arena);
+		vmime::charsetConverter::cache::scope converter_scope(ctx->converters);
+
+		vmime::ref <vmime::message> msg = vmime::create <vmime::message>();
+		parse_message(msg, ctx->data, parsed_mail_info->parse_mask);
+
+		return fill_parsed_message_info(msg, parsed_mail_info);
+	} catch (vmime::exception &e) {
+	} catch (std::exception &e) {
+	}
+
+	return 1;
+}
+
+
+// Delivers the events of a message while it is received: the header of
+// the message as soon as it is complete, and each part once its end is
+// known. Only the contents of the part being received are kept, and only
+// when a callback needs them.
+class stream_listener : public vmime::incrementalParserListener
+{
+public:
+	stream_listener(const struct mailparse_callbacks_s *callbacks, bool parse_parts)
+		: header_done(false), m_callbacks(callbacks), m_parse_parts(parse_parts), m_skip_depth(-1)
+	{
+		stream_entity root;
+		root.part = vmime::create <vmime::message>();
+		m_entities.push_back(root);
+	}
+
+	void onHeader(vmime::ref <const vmime::header> hdr, const int depth)
+	{
+		if (depth == 0) {
+			header_done = true;
+
+			if (m_callbacks->on_header != NULL) {
+				emit_header_events(hdr, m_callbacks);
+			}
+		}
+
+		// the parts of an attachment belong to it
+		if (!m_parse_parts || (m_skip_depth >= 0 && depth > m_skip_depth)) {
+			return;
+		}
+
+		stream_entity &entity = m_entities[depth];
+		entity.part->getHeader()->copyFrom(*hdr);
+
+		if (vmime::attachmentHelper::isBodyPartAnAttachment(entity.part)) {
+			entity.emit = (m_callbacks->on_attachment_begin != NULL
+				|| m_callbacks->on_attachment_chunk != NULL
+				|| m_callbacks->on_attachment_end != NULL);
+			entity.collect = (m_callbacks->on_attachment_chunk != NULL);
+
+			m_skip_depth = depth;
+		} else if (m_callbacks->on_text_part != NULL) {
+			vmime::mediaType type;
+			vmime::charset charset;
+			get_part_type(entity.part->getHeader(), type, charset);
+
+			// a multipart entity without boundary: vmime guesses it
+			entity.emit = entity.collect = (is_text_part_type(type)
+				|| type.getType() == vmime::mediaTypes::MULTIPART);
+		}
+
+		m_contents.clear();
+	}
+
+	void onPartBegin(const int depth)
+	{
+		if (m_callbacks->on_part_begin != NULL && m_callbacks->on_part_begin(depth, m_callbacks->arg) != 0) {
+			throw sink_stopped();
+		}
+
+		stream_entity &parent = m_entities[depth - 1];
+		parent.split = true;
+
+		stream_entity entity;
+		entity.part = vmime::create <vmime::bodyPart>();
+
+		// the parent is needed to tell attachments from the other parts
+		parent.part->getBody()->appendPart(entity.part);
+
+		m_entities.resize(depth);
+		m_entities.push_back(entity);
+	}
+
+	void onPartEnd(const int depth)
+	{
+		end_entity(depth);
+
+		// the part is not needed any more
+		m_entities[depth - 1].part->getBody()->removePart(m_entities[depth].part);
+		m_entities.resize(depth);
+
+		if (m_callbacks->on_part_end != NULL && m_callbacks->on_part_end(depth, m_callbacks->arg) != 0) {
+			throw sink_stopped();
+		}
+	}
+
+	void onBody(const char *data, const vmime::string::size_type length, const int depth)
+	{
+		if (m_entities[depth].collect) {
+			m_contents.append(data, length);
+		}
+	}
+
+	// all the data has been received
+	void finish()
+	{
+		end_entity(0);
+	}
+
+	bool header_done;
+
+private:
+	struct stream_entity
+	{
+		stream_entity() : emit(false), collect(false), split(false)
+		{
+		}
+
+		vmime::ref <vmime::bodyPart> part;
+
+		bool emit;		// events are delivered for this entity
+		bool collect;	// its contents are needed for this
+		bool split;		// parts were found in it
+	};
+
+	void end_entity(const int depth)
+	{
+		stream_entity &entity = m_entities[depth];
+
+		// the parts of a multipart entity have been delivered already,
+		// unless it is an attachment
+		if (entity.emit && (!entity.split || depth == m_skip_depth)) {
+			if (entity.collect && !entity.split) {
+				entity.part->getBody()->parse(m_contents);
+			}
+
+			m_contents.clear();
+
+			emit_part_events(entity.part, m_callbacks);
+		}
+
+		if (depth == m_skip_depth) {
+			m_skip_depth = -1;
+		}
+	}
+
+	const struct mailparse_callbacks_s *m_callbacks;
+	bool m_parse_parts;
+
+	// entities being received: the message, then its part being
+	// received, the sub-part of that part, etc.
+	std::vector <stream_entity> m_entities;
+
+	// contents of the part being received
+	vmime::string m_contents;
+
+	// depth of the attachment being received, or -1
+	int m_skip_depth;
+};
+
+
+struct mailparse_stream_s
+{
+	mailparse_stream_s(const struct mailparse_callbacks_s *cb)
+		: callbacks(*cb), parse_mask(get_callbacks_parse_mask(cb)),
+		  listener(&callbacks, (parse_mask & MAILPARSE_TEXT_PARTS) != 0),
+		  parser(&listener, false), state(MAILPARSE_OK)
+	{
+	}
+
+	struct mailparse_callbacks_s callbacks;
+	int parse_mask;
+
+	stream_listener listener;
+
+	// the data is released as soon as it has been processed
+	vmime::incrementalParser parser;
+
+	// MAILPARSE_STOPPED once a callback asked to stop, MAILPARSE_ERROR
+	// once the data could not be parsed
+	int state;
+};
+
+
+struct mailparse_stream_s *parse_mail_stream_begin(const struct mailparse_callbacks_s *callbacks)
+{
+	try {
+		// set platform
+		vmime::platform::setHandler<vmime::platforms::posix::posixHandler>();
+
+		return new mailparse_stream_s(callbacks);
+	} catch (std::exception &e) {
+	}
+
+	return NULL;
+}
+
+
+// Whether the rest of the message has to be fed to the stream
+bool stream_needs_data(const struct mailparse_stream_s *stream)
+{
+	return (stream->parse_mask & MAILPARSE_TEXT_PARTS) || !stream->listener.header_done;
+}
+
+
+int parse_mail_stream_feed(struct mailparse_stream_s *stream, const char *data, size_t len)
+{
+	if (stream == NULL) {
+		return MAILPARSE_ERROR;
+	}
+
+	if (stream->state != MAILPARSE_OK) {
+		return stream->state;
+	}
+
+	// headers only: the rest of the message is not even kept
+	if (!stream_needs_data(stream)) {
+		return MAILPARSE_OK;
+	}
+
+	try {
+		stream->parser.feed(data, len);
+	} catch (sink_stopped &e) {
+		stream->state = MAILPARSE_STOPPED;
+	} catch (vmime::exception &e) {
+		stream->state = MAILPARSE_ERROR;
+	} catch (std::exception &e) {
+		stream->state = MAILPARSE_ERROR;
+	}
+
+	return stream->state;
+}
+
+
+int parse_mail_stream_finish(struct mailparse_stream_s *stream)
+{
+	if (stream == NULL) {
+		return MAILPARSE_ERROR;
+	}
+
+	if (stream->state == MAILPARSE_OK) {
+		try {
+			stream->parser.finish();
+
+			if (stream->parse_mask & MAILPARSE_TEXT_PARTS) {
+				stream->listener.finish();
+			}
+		} catch (sink_stopped &e) {
+			stream->state = MAILPARSE_STOPPED;
+		} catch (vmime::exception &e) {
+			stream->state = MAILPARSE_ERROR;
+		} catch (std::exception &e) {
+			stream->state = MAILPARSE_ERROR;
+		}
+	}
+
+	const int ret = stream->state;
+
+	delete stream;
+
+	return ret;
+}
+
+
+// The event functions go through a stream, fed by pieces so that the
+// parser never holds more than one piece besides the data it still needs
+const size_t event_chunk_size = 65536;
+
+
+int parse_mail_events_for_buffer(const char *data, size_t len, const struct mailparse_callbacks_s *callbacks)
+{
+	struct mailparse_stream_s *stream = parse_mail_stream_begin(callbacks);
+	if (stream == NULL) {
+		return MAILPARSE_ERROR;
+	}
+
+	for (size_t pos = 0; pos < len && stream->state == MAILPARSE_OK && stream_needs_data(stream);
+			pos += event_chunk_size) {
+		parse_mail_stream_feed(stream, data + pos, min(event_chunk_size, len - pos));
+	}
+
+	return parse_mail_stream_finish(stream);
+}
+
+
+int parse_mail_events_for_file(char *email, const struct mailparse_callbacks_s *callbacks)
+{
+	int fd = open(email, O_RDONLY);
+	if (fd == -1) {
+		return MAILPARSE_ERROR;
+	}
+
+	struct mailparse_stream_s *stream = parse_mail_stream_begin(callbacks);
+	if (stream == NULL) {
+		close(fd);
+		return MAILPARSE_ERROR;
+	}
+
+	try {
+		vector <char> buf(event_chunk_size);
+
+		while (stream->state == MAILPARSE_OK && stream_needs_data(stream)) {
+			ssize_t n = read(fd, &buf[0], buf.size());
+			if (n < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+
+				// no events for a partly read message
+				stream->state = MAILPARSE_ERROR;
+				break;
+			}
+
+			if (n == 0) {
+				break;
+			}
+
+			parse_mail_stream_feed(stream, &buf[0], n);
+		}
+	} catch (std::exception &e) {
+		stream->state = MAILPARSE_ERROR;
+	}
+
+	close(fd);
+
+	return parse_mail_stream_finish(stream);
+}
+
+
+int parse_mail_events_for_fd(int fd, const struct mailparse_callbacks_s *callbacks)
+{
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		return MAILPARSE_ERROR;
+	}
+
+	// empty file: nothing to map
+	if (st.st_size == 0) {
+		return parse_mail_events_for_buffer("", 0, callbacks);
+	}
+
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		return MAILPARSE_ERROR;
+	}
+
+	// the whole mapping is read once, front to back
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	int ret = parse_mail_events_for_buffer((const char *)map, st.st_size, callbacks);
+
+	munmap(map, st.st_size);
+
+	return ret;
+}
+
+
+// Messages still to be parsed by one worker of a batch: the worker takes
+// them from the front, idle workers steal from the back
+struct batch_queue
+{
+	pthread_mutex_t lock;
+	size_t next;
+	size_t end;
+};
+
+
+struct batch_job
+{
+	char **paths;
+	int parse_mask;
+
+	// results in input order, or NULL to use 'done'
+	struct parsed_message_info_s *results;
+	mailparse_batch_done done;
+	void *arg;
+
+	std::vector <batch_queue> queues;
+
+	pthread_mutex_t failed_lock;
+	int failed;
+};
+
+
+struct batch_worker
+{
+	batch_job *job;
+	size_t self;
+};
+
+
+bool batch_take(batch_queue &queue, size_t &index)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&queue.lock);
+	if (queue.next < queue.end) {
+		index = queue.next++;
+		found = true;
+	}
+	pthread_mutex_unlock(&queue.lock);
+
+	return found;
+}
+
+
+// Move the second half of another worker's remaining messages to our queue
+bool batch_steal(batch_job *job, size_t self, size_t &index)
+{
+	const size_t count = job->queues.size();
+
+	for (size_t k = 1; k < count; ++k) {
+		batch_queue &victim = job->queues[(self + k) % count];
+
+		size_t begin = 0, end = 0;
+
+		pthread_mutex_lock(&victim.lock);
+		if (victim.next < victim.end) {
+			end = victim.end;
+			begin = victim.end - (victim.end - victim.next + 1) / 2;
+			victim.end = begin;
+		}
+		pthread_mutex_unlock(&victim.lock);
+
+		if (begin < end) {
+			batch_queue &queue = job->queues[self];
+
+			pthread_mutex_lock(&queue.lock);
+			queue.next = begin + 1;
+			queue.end = end;
+			pthread_mutex_unlock(&queue.lock);
+
+			index = begin;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void *batch_worker_main(void *param)
+{
+	batch_worker *worker = (batch_worker *)param;
+	batch_job *job = worker->job;
+
+	// buffers and memory reused from one message to the next
+	mailparse_ctx ctx;
+
+	int failed = 0;
+	size_t index;
+
+	while (batch_take(job->queues[worker->self], index) || batch_steal(job, worker->self, index)) {
+		if (job->results != NULL) {
+			if (parse_mail_for_file_ctx(&ctx, job->paths[index], &job->results[index]) != 0) {
+				++failed;
+			}
+		} else {
+			struct parsed_message_info_s info;
+			init_parse(&info);
+			info.parse_mask = job->parse_mask;
+
+			int ret = parse_mail_for_file_ctx(&ctx, job->paths[index], &info);
+			if (ret != 0) {
+				++failed;
+			}
+
+			job->done(index, ret, &info, job->arg);
+
+			clean_parse(&info);
+		}
+	}
+
+	pthread_mutex_lock(&job->failed_lock);
+	job->failed += failed;
+	pthread_mutex_unlock(&job->failed_lock);
+
+	return NULL;
+}
+
+
+int run_batch(batch_job *job, size_t n, int threads)
+{
+	if (n == 0) {
+		return 0;
+	}
+
+	// set platform, once for all the workers
+	vmime::platform::setHandler<vmime::platforms::posix::posixHandler>();
+
+	if (threads <= 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (cpus > 0 ? (int)cpus : 1);
+	}
+	if ((size_t)threads > n) {
+		threads = (int)n;
+	}
+
+	// each worker starts with an even share of the messages
+	job->queues.resize(threads);
+	for (int i = 0; i < threads; ++i) {
+		pthread_mutex_init(&job->queues[i].lock, NULL);
+		job->queues[i].next = n * i / threads;
+		job->queues[i].end = n * (i + 1) / threads;
+	}
+
+	pthread_mutex_init(&job->failed_lock, NULL);
+	job->failed = 0;
+
+	std::vector <batch_worker> workers(threads);
+	std::vector <pthread_t> tids(threads);
+	std::vector <bool> started(threads, false);
+
+	for (int i = 0; i < threads; ++i) {
+		workers[i].job = job;
+		workers[i].self = i;
+	}
+
+	// the calling thread is the first worker
+	for (int i = 1; i < threads; ++i) {
+		started[i] = (pthread_create(&tids[i], NULL, batch_worker_main, &workers[i]) == 0);
+	}
+
+	// messages of workers which could not be started are stolen
+	batch_worker_main(&workers[0]);
+
+	for (int i = 1; i < threads; ++i) {
+		if (started[i]) {
+			pthread_join(tids[i], NULL);
+		}
+	}
+
+	for (int i = 0; i < threads; ++i) {
+		pthread_mutex_destroy(&job->queues[i].lock);
+	}
+	pthread_mutex_destroy(&job->failed_lock);
+
+	return job->failed;
+}
+
+
+int parse_mail_batch(char **paths, size_t n, struct parsed_message_info_s *results, int threads)
+{
+	batch_job job;
+	job.paths = paths;
+	job.parse_mask = MAILPARSE_ALL;
+	job.results = results;
+	job.done = NULL;
+	job.arg = NULL;
+
+	return run_batch(&job, n, threads);
+}
+
+
+int parse_mail_batch_with_callback(char **paths, size_t n, int parse_mask, int threads,
+	mailparse_batch_done done, void *arg)
+{
+	if (done == NULL) {
+		return (int)n;
+	}
+
+	batch_job job;
+	job.paths = paths;
+	job.parse_mask = parse_mask;
+	job.results = NULL;
+	job.done = done;
+	job.arg = arg;
+
+	return run_batch(&job, n, threads);
+}
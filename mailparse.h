@@ -1,10 +1,26 @@
 #ifndef _MAIL_PARSED_V2_H_
 #define _MAIL_PARSED_V2_H_
 
+#include <stddef.h>
+
+/* parse_mask bits: which parts of the message to extract */
+#define MAILPARSE_HEADERS		0x01	/* from, to, cc, bcc, subject, received-spf */
+#define MAILPARSE_TEXT_PARTS	0x02	/* text/plain and text/html body parts */
+#define MAILPARSE_ALL			(MAILPARSE_HEADERS | MAILPARSE_TEXT_PARTS)
+
+/* return values of the event-driven parsing functions */
+#define MAILPARSE_OK			0	/* the whole message has been delivered */
+#define MAILPARSE_ERROR			1	/* the message could not be read or parsed */
+#define MAILPARSE_STOPPED		2	/* a callback asked to stop */
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+	/* receives the body of the text parts, decoded and converted to UTF-8,
+	 * one chunk at a time; return 0 to go on, anything else to stop */
+	typedef int (*mailparse_body_sink)(const char *data, size_t len, void *arg);
+
 	typedef struct parsed_string_t {
 		int len;
 		char *pdata;
@@ -18,11 +34,102 @@ extern "C" {
 		struct parsed_string_t header_subject;
 		struct parsed_string_t header_spf;
 		struct parsed_string_t body;
+
+		/* set by init_parse() to MAILPARSE_ALL; without MAILPARSE_TEXT_PARTS
+		 * only the header block is read and the body is never parsed */
+		int parse_mask;
+
+		/* set to NULL by init_parse(); when set, the body is passed to
+		 * body_sink (with body_sink_arg) as it is decoded and 'body'
+		 * stays empty */
+		mailparse_body_sink body_sink;
+		void *body_sink_arg;
+	};
+
+	/* event-driven parsing: the callbacks are called while the message is
+	 * read, so nothing is copied into per-field buffers. The header of the
+	 * message is delivered as soon as it has been read, and each part once
+	 * its end has been read; only the contents of the part being read are
+	 * kept, so memory use grows with the size of the largest part, not of
+	 * the message. Any callback may be NULL; a callback returning anything
+	 * but 0 stops parsing. */
+	struct mailparse_callbacks_s {
+		/* each field of the message header; 'value' is NUL-terminated,
+		 * decoded and converted to UTF-8 for unstructured fields */
+		int (*on_header)(const char *name, const char *value, size_t value_len, void *arg);
+
+		/* text/plain and text/html parts, transfer decoded and converted to
+		 * UTF-8 ('charset' is the one declared by the part); called with
+		 * len == 0 once at the end of each part */
+		int (*on_text_part)(const char *mime_type, const char *charset,
+			const char *data, size_t len, void *arg);
+
+		/* attachments, transfer decoded; 'filename' may be empty */
+		int (*on_attachment_begin)(const char *mime_type, const char *filename, void *arg);
+		int (*on_attachment_chunk)(const char *data, size_t len, void *arg);
+		int (*on_attachment_end)(void *arg);
+
+		/* boundaries of the MIME parts, reported as soon as they are read;
+		 * 'depth' is 1 for a part of the message, 2 for a part of that
+		 * part, etc. on_part_end is called after the events of the
+		 * contents of the part */
+		int (*on_part_begin)(int depth, void *arg);
+		int (*on_part_end)(int depth, void *arg);
+
+		void *arg;
 	};
 
 	void init_parse(struct parsed_message_info_s *parsed_mail_info);
 	void clean_parse(struct parsed_message_info_s *parsed_mail_info);
 	int parse_mail_for_file(char *email, struct parsed_message_info_s *parsed_mail_info);
+	/* parse a message already held in memory (data[0..len-1]) */
+	int parse_mail_for_buffer(const char *data, size_t len, struct parsed_message_info_s *parsed_mail_info);
+	/* parse a message from an open regular file, mmap'd read-only */
+	int parse_mail_for_fd(int fd, struct parsed_message_info_s *parsed_mail_info);
+
+	/* reusable parsing context, for processes parsing many messages: the
+	 * file buffer, the memory of the parsed message and the charset
+	 * conversion descriptors are kept from one call to the next. A context
+	 * must only be used by one thread at a time; mailparse_ctx_reset()
+	 * drops the contents but keeps the memory. */
+	typedef struct mailparse_ctx_s mailparse_ctx;
+	mailparse_ctx *mailparse_ctx_create(void);
+	void mailparse_ctx_reset(mailparse_ctx *ctx);
+	void mailparse_ctx_destroy(mailparse_ctx *ctx);
+	int parse_mail_for_file_ctx(mailparse_ctx *ctx, char *email, struct parsed_message_info_s *parsed_mail_info);
+
+	/* same as above, delivering the message through callbacks; when only
+	 * on_header is set, the body is never parsed. Return MAILPARSE_OK,
+	 * MAILPARSE_ERROR or MAILPARSE_STOPPED */
+	void init_parse_callbacks(struct mailparse_callbacks_s *callbacks);
+	int parse_mail_events_for_file(char *email, const struct mailparse_callbacks_s *callbacks);
+	int parse_mail_events_for_buffer(const char *data, size_t len, const struct mailparse_callbacks_s *callbacks);
+	int parse_mail_events_for_fd(int fd, const struct mailparse_callbacks_s *callbacks);
+
+	/* batch parsing of message files on a pool of 'threads' worker threads
+	 * (0: one per processor). results[i] must have been set up with
+	 * init_parse(); failed messages are left empty. Return the number of
+	 * messages which could not be parsed. */
+	int parse_mail_batch(char **paths, size_t n, struct parsed_message_info_s *results, int threads);
+
+	/* same, handing each result to 'done' as soon as it is ready, from the
+	 * worker thread (so calls may be concurrent); 'info' is released when
+	 * the callback returns */
+	typedef void (*mailparse_batch_done)(size_t index, int ret, struct parsed_message_info_s *info, void *arg);
+	int parse_mail_batch_with_callback(char **paths, size_t n, int parse_mask, int threads,
+		mailparse_batch_done done, void *arg);
+
+	/* incremental parsing, for a message received in chunks: the events
+	 * are delivered as described above, as soon as the data has been fed.
+	 * parse_mail_stream_finish() delivers the remaining events and
+	 * releases the stream.
+	 * parse_mail_stream_feed() returns MAILPARSE_ERROR or MAILPARSE_STOPPED
+	 * once parsing cannot go on (further data is then ignored), and
+	 * parse_mail_stream_finish() returns the final state */
+	struct mailparse_stream_s;
+	struct mailparse_stream_s *parse_mail_stream_begin(const struct mailparse_callbacks_s *callbacks);
+	int parse_mail_stream_feed(struct mailparse_stream_s *stream, const char *data, size_t len);
+	int parse_mail_stream_finish(struct mailparse_stream_s *stream);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "mailparse.h"
+
+/* sample/1.eml has a Received-SPF field, sample/11.eml has none */
+static char *paths[] = { "sample/1.eml", "sample/11.eml" };
+
+static int failed = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failed = 1; \
+		} \
+	} while (0)
+
+static void check_spf(size_t index, const struct parsed_message_info_s *info)
+{
+	if (index == 0) {
+		CHECK(info->header_spf.pdata != NULL);
+		CHECK(info->header_spf.len > 0);
+		CHECK(info->header_spf.pdata != NULL && (int)strlen(info->header_spf.pdata) == info->header_spf.len);
+	} else {
+		CHECK(info->header_spf.pdata == NULL);
+		CHECK(info->header_spf.len == 0);
+	}
+}
+
+static void batch_done(size_t index, int ret, struct parsed_message_info_s *info, void *arg)
+{
+	(void)arg;
+
+	CHECK(ret == 0);
+	check_spf(index, info);
+}
+
+int main(void)
+{
+	struct parsed_message_info_s results[2];
+	size_t i;
+
+	/* results of the batch */
+	for (i = 0; i < 2; ++i) {
+		memset(&results[i], 0xff, sizeof(results[i]));
+		init_parse(&results[i]);
+	}
+
+	CHECK(parse_mail_batch(paths, 2, results, 2) == 0);
+
+	for (i = 0; i < 2; ++i) {
+		check_spf(i, &results[i]);
+		clean_parse(&results[i]);
+
+		CHECK(results[i].header_spf.pdata == NULL);
+		CHECK(results[i].header_spf.len == 0);
+	}
+
+	/* results handed to a callback */
+	CHECK(parse_mail_batch_with_callback(paths, 2, MAILPARSE_HEADERS, 2, batch_done, NULL) == 0);
+
+	printf(failed ? "batch test FAILED\n" : "batch test OK\n");
+
+	return failed;
+}